@@ -0,0 +1,154 @@
+/**
+ * @file UringVfsBenchmark.cpp
+ *
+ * This module compares the performance of the io_uring-backed virtual
+ * file system with that of the default virtual file system, for
+ * typical write, scan, and snapshot workloads.
+ */
+
+#include <chrono>
+#include <SQLiteAbstractions/SQLiteDatabase.hpp>
+#include <stdio.h>
+#include <string>
+#include <SystemAbstractions/File.hpp>
+
+using namespace DatabaseAbstractions;
+
+namespace {
+
+    /**
+     * This is the number of transactions committed by the write workload.
+     */
+    constexpr int NUM_TRANSACTIONS = 200;
+
+    /**
+     * This is the number of rows inserted by each transaction.
+     */
+    constexpr int ROWS_PER_TRANSACTION = 100;
+
+    /**
+     * This is the number of times the scan workload reads the whole table.
+     */
+    constexpr int NUM_SCANS = 10;
+
+    /**
+     * This holds the time taken by each workload.
+     */
+    struct Timings {
+        double writeSeconds = 0.0;
+        double scanSeconds = 0.0;
+        double snapshotSeconds = 0.0;
+        bool usedIoUring = false;
+    };
+
+    /**
+     * Return the number of seconds elapsed since the given time.
+     *
+     * @param[in] start
+     *     This is the time from which to measure.
+     *
+     * @return
+     *     The number of seconds elapsed since the given time is returned.
+     */
+    double SecondsSince(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration< double >(
+            std::chrono::steady_clock::now() - start
+        ).count();
+    }
+
+    /**
+     * Run all workloads against a new database opened with
+     * the given options.
+     *
+     * @param[in] filePath
+     *     This is the path of the database to create.
+     *
+     * @param[in] options
+     *     These control how the database is opened.
+     *
+     * @return
+     *     The time taken by each workload is returned.
+     */
+    Timings RunWorkloads(
+        const std::string& filePath,
+        const SQLiteDatabase::OpenOptions& options
+    ) {
+        Timings timings;
+        SystemAbstractions::File(filePath).Destroy();
+        SQLiteDatabase db;
+        if (!db.Open(filePath, options)) {
+            fprintf(stderr, "Unable to open database '%s'\n", filePath.c_str());
+            return timings;
+        }
+        timings.usedIoUring = db.IsUsingIoUring();
+        (void)db.ExecuteStatement("PRAGMA synchronous = FULL");
+        (void)db.ExecuteStatement("CREATE TABLE t (id INTEGER PRIMARY KEY, payload TEXT)");
+        auto insert = db.BuildStatement("INSERT INTO t (payload) VALUES (printf('%.1000c', 'x'))").statement;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < NUM_TRANSACTIONS; ++i) {
+            (void)db.ExecuteStatement("BEGIN");
+            for (int j = 0; j < ROWS_PER_TRANSACTION; ++j) {
+                (void)insert->Step();
+                insert->Reset();
+            }
+            (void)db.ExecuteStatement("COMMIT");
+        }
+        timings.writeSeconds = SecondsSince(start);
+        auto scan = db.BuildStatement("SELECT SUM(LENGTH(payload)) FROM t").statement;
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < NUM_SCANS; ++i) {
+            (void)scan->Step();
+            scan->Reset();
+        }
+        timings.scanSeconds = SecondsSince(start);
+        start = std::chrono::steady_clock::now();
+        const auto snapshot = db.CreateSnapshot();
+        timings.snapshotSeconds = SecondsSince(start);
+        return timings;
+    }
+
+    /**
+     * Print the given timings.
+     *
+     * @param[in] name
+     *     This is the name of the virtual file system measured.
+     *
+     * @param[in] timings
+     *     This holds the time taken by each workload.
+     */
+    void PrintTimings(
+        const char* name,
+        const Timings& timings
+    ) {
+        printf(
+            "%-10s write: %8.3f s   scan: %8.3f s   snapshot: %8.3f s\n",
+            name,
+            timings.writeSeconds,
+            timings.scanSeconds,
+            timings.snapshotSeconds
+        );
+    }
+
+}
+
+int main(int argc, char* argv[]) {
+    const std::string directory = (
+        (argc > 1)
+        ? argv[1]
+        : SystemAbstractions::File::GetExeParentDirectory()
+    );
+    const auto filePath = directory + "/benchmark.db";
+    SQLiteDatabase::OpenOptions defaultOptions;
+    SQLiteDatabase::OpenOptions uringOptions;
+    uringOptions.useIoUring = true;
+    const auto defaultTimings = RunWorkloads(filePath, defaultOptions);
+    const auto uringTimings = RunWorkloads(filePath, uringOptions);
+    SystemAbstractions::File(filePath).Destroy();
+    PrintTimings("default", defaultTimings);
+    if (uringTimings.usedIoUring) {
+        PrintTimings("io_uring", uringTimings);
+    } else {
+        printf("io_uring not available; only the default VFS was measured\n");
+    }
+    return 0;
+}
@@ -0,0 +1,218 @@
+#pragma once
+
+/**
+ * @file ContainerTable.hpp
+ *
+ * This module declares the DatabaseAbstractions::ContainerTable class
+ * template.
+ */
+
+#include <functional>
+#include <memory>
+#include <SQLiteAbstractions/SQLiteDatabase.hpp>
+#include <stddef.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace DatabaseAbstractions {
+
+    /**
+     * This makes a C++ container available to SQL as a read-only virtual
+     * table, with one row per element of the container, and columns whose
+     * values are taken from each element by functions given for them.
+     * The container is referenced, not copied, so it must outlive the
+     * table, and must not be modified while a statement reading the table
+     * is being stepped.
+     *
+     * @tparam Container
+     *     This is the type of container to make available to SQL.
+     */
+    template< typename Container > class ContainerTable
+        : public SQLiteDatabase::VirtualTable
+    {
+        // Types
+    public:
+        /**
+         * This is the type of each element of the container.
+         */
+        using Row = typename Container::value_type;
+
+        /**
+         * This is the type used to iterate through the container.
+         */
+        using Iterator = typename Container::const_iterator;
+
+        /**
+         * This describes one column of the table.
+         */
+        struct Column {
+            /**
+             * This is the name of the column in SQL.
+             */
+            std::string name;
+
+            /**
+             * This is the type of values in the column.
+             */
+            Value::Type type;
+
+            /**
+             * This is called to provide the value of the column
+             * for an element of the container.
+             */
+            std::function<
+                void(
+                    const Row& row,
+                    SQLiteDatabase::FunctionResult& result
+                )
+            > get;
+
+            /**
+             * If set, this is called to find the range of elements of the
+             * container having the given value in the column, such as by
+             * calling the equal_range method of a map.  Queries comparing
+             * the column to a value for equality then use it, rather than
+             * scanning every element.
+             */
+            std::function<
+                std::pair< Iterator, Iterator >(
+                    const Container& container,
+                    const Value& value
+                )
+            > find;
+        };
+
+        // Lifecycle
+    public:
+        /**
+         * This is the instance constructor.
+         *
+         * @param[in] container
+         *     This is the container to make available to SQL.
+         *
+         * @param[in] columns
+         *     These describe the columns of the table.
+         */
+        ContainerTable(
+            const Container& container,
+            std::vector< Column > columns
+        )
+            : container_(container)
+            , columns_(std::move(columns))
+        {
+        }
+
+        // SQLiteDatabase::VirtualTable
+    public:
+        virtual std::vector< SQLiteDatabase::VirtualTableColumn > GetColumns() const override {
+            std::vector< SQLiteDatabase::VirtualTableColumn > columns;
+            for (const auto& column: columns_) {
+                SQLiteDatabase::VirtualTableColumn definition;
+                definition.name = column.name;
+                definition.type = column.type;
+                definition.key = (bool)column.find;
+                columns.push_back(std::move(definition));
+            }
+            return columns;
+        }
+
+        virtual size_t EstimateRowCount() const override {
+            return (size_t)container_.size();
+        }
+
+        virtual std::unique_ptr< SQLiteDatabase::VirtualTableCursor > Scan() override {
+            return std::unique_ptr< SQLiteDatabase::VirtualTableCursor >(
+                new Cursor(container_.begin(), container_.end(), columns_)
+            );
+        }
+
+        virtual std::unique_ptr< SQLiteDatabase::VirtualTableCursor > Find(
+            size_t column,
+            const Value& value
+        ) override {
+            const auto range = columns_[column].find(container_, value);
+            return std::unique_ptr< SQLiteDatabase::VirtualTableCursor >(
+                new Cursor(range.first, range.second, columns_)
+            );
+        }
+
+        // Private Types
+    private:
+        /**
+         * This iterates through a range of elements of the container.
+         */
+        class Cursor
+            : public SQLiteDatabase::VirtualTableCursor
+        {
+        public:
+            /**
+             * This is the instance constructor.
+             *
+             * @param[in] begin
+             *     This refers to the first element in the range.
+             *
+             * @param[in] end
+             *     This refers to the element after the last one
+             *     in the range.
+             *
+             * @param[in] columns
+             *     These describe the columns of the table.
+             */
+            Cursor(
+                Iterator begin,
+                Iterator end,
+                const std::vector< Column >& columns
+            )
+                : current_(begin)
+                , end_(end)
+                , columns_(columns)
+            {
+            }
+
+            virtual bool IsAtEnd() const override {
+                return current_ == end_;
+            }
+
+            virtual void Next() override {
+                ++current_;
+            }
+
+            virtual void GetColumn(
+                size_t column,
+                SQLiteDatabase::FunctionResult& result
+            ) override {
+                columns_[column].get(*current_, result);
+            }
+
+        private:
+            /**
+             * This refers to the current element.
+             */
+            Iterator current_;
+
+            /**
+             * This refers to the element after the last one in the range.
+             */
+            Iterator end_;
+
+            /**
+             * These describe the columns of the table.
+             */
+            const std::vector< Column >& columns_;
+        };
+
+        // Properties
+    private:
+        /**
+         * This is the container made available to SQL.
+         */
+        const Container& container_;
+
+        /**
+         * These describe the columns of the table.
+         */
+        std::vector< Column > columns_;
+    };
+
+}
@@ -11,7 +11,9 @@
  * cluster leader installs a new snapshot.
  */
 
+#include <chrono>
 #include <DatabaseAbstractions/Database.hpp>
+#include <functional>
 #include <memory>
 #include <stddef.h>
 #include <stdint.h>
@@ -19,6 +21,9 @@
 #include <SystemAbstractions/IFileSystemEntry.hpp>
 #include <vector>
 
+struct sqlite3_context;
+struct sqlite3_value;
+
 namespace DatabaseAbstractions {
 
     /**
@@ -26,6 +31,999 @@ namespace DatabaseAbstractions {
      * general-purpose access to some kind of relational database.
      */
     class SQLiteDatabase : public Database {
+        // Types
+    public:
+        /**
+         * This holds information about a conflict encountered while
+         * applying a changeset to the database.
+         */
+        struct ChangesetConflict {
+            /**
+             * These are the different kinds of conflicts that can occur
+             * when applying a changeset.
+             */
+            enum class Type {
+                /**
+                 * The row to update or delete was found, but its
+                 * current values don't match the original values
+                 * recorded in the changeset.
+                 */
+                Data,
+
+                /**
+                 * The row to update or delete was not found.
+                 */
+                NotFound,
+
+                /**
+                 * The row to insert has the same primary key as a row
+                 * already in the database.
+                 */
+                Conflict,
+
+                /**
+                 * Applying the change would violate a constraint.
+                 */
+                Constraint,
+
+                /**
+                 * Applying the changeset would leave foreign key
+                 * constraint violations in the database.
+                 */
+                ForeignKey,
+            };
+
+            /**
+             * These are the kinds of changes recorded in a changeset.
+             */
+            enum class Operation {
+                Insert,
+                Update,
+                Delete,
+            };
+
+            /**
+             * This indicates the kind of conflict that occurred.
+             */
+            Type type = Type::Data;
+
+            /**
+             * This indicates the kind of change which caused the conflict.
+             */
+            Operation operation = Operation::Insert;
+
+            /**
+             * This is the name of the table affected by the change.
+             */
+            std::string table;
+        };
+
+        /**
+         * These are the ways in which a conflict can be resolved
+         * while applying a changeset.
+         */
+        enum class ChangesetConflictResolution {
+            /**
+             * Skip the conflicting change and continue applying the
+             * rest of the changeset.
+             */
+            Omit,
+
+            /**
+             * Overwrite the conflicting row with the change.  This is
+             * only possible for `Data` and `Conflict` conflicts; for any
+             * other type of conflict it is treated as `Omit`.
+             */
+            Replace,
+
+            /**
+             * Stop applying the changeset, and roll back any changes
+             * already applied from it.
+             */
+            Abort,
+        };
+
+        /**
+         * This is the type of function called to report a conflict
+         * encountered while applying a changeset, and to decide how
+         * the conflict should be resolved.
+         *
+         * @param[in] conflict
+         *     This holds information about the conflict.
+         *
+         * @return
+         *     The way in which the conflict should be resolved
+         *     is returned.
+         */
+        using ChangesetConflictDelegate = std::function<
+            ChangesetConflictResolution(
+                const ChangesetConflict& conflict
+            )
+        >;
+
+        /**
+         * This holds statistics about the use of the query result cache.
+         */
+        struct QueryCacheStatistics {
+            /**
+             * This is the number of queries answered from the cache.
+             */
+            size_t hits = 0;
+
+            /**
+             * This is the number of cacheable queries whose results
+             * were not found in the cache.
+             */
+            size_t misses = 0;
+
+            /**
+             * This is the number of query results added to the cache.
+             */
+            size_t insertions = 0;
+
+            /**
+             * This is the number of query results discarded from the
+             * cache in order to stay within its memory budget.
+             */
+            size_t evictions = 0;
+
+            /**
+             * This is the number of times cached query results were
+             * discarded because the tables they were read from changed.
+             */
+            size_t invalidations = 0;
+
+            /**
+             * This is the number of query results currently cached.
+             */
+            size_t entries = 0;
+
+            /**
+             * This is the estimated number of bytes of memory
+             * currently used by the cache.
+             */
+            size_t bytes = 0;
+        };
+
+        /**
+         * This holds options which control how a database is opened.
+         */
+        struct OpenOptions {
+            /**
+             * If true, and the database is being created, set it up
+             * so that free pages can be returned to the file system
+             * a few at a time by calling ReclaimFreePages.
+             */
+            bool incrementalVacuum = false;
+
+            /**
+             * If true, and io_uring is available, open the database
+             * through a virtual file system which batches writes and
+             * prefetches sequential reads using io_uring.  Otherwise,
+             * the default virtual file system is used.
+             */
+            bool useIoUring = false;
+        };
+
+        /**
+         * This holds statistics about reclaiming unused space
+         * in the database.
+         */
+        struct CompactionStatistics {
+            /**
+             * This is the number of bytes currently held in
+             * free pages in the database.
+             */
+            size_t freeBytes = 0;
+
+            /**
+             * This is the total number of bytes returned to the file system
+             * by calls to ReclaimFreePages.
+             */
+            size_t bytesReclaimed = 0;
+
+            /**
+             * This is the total number of bytes left out of snapshots
+             * by compacting them.
+             */
+            size_t snapshotBytesOmitted = 0;
+        };
+
+        /**
+         * These are the ways in which a checkpoint can be done,
+         * copying changes from the write-ahead log into the database.
+         */
+        enum class CheckpointMode {
+            /**
+             * Copy as many changes as possible without waiting
+             * for readers or writers to finish.
+             */
+            Passive,
+
+            /**
+             * Wait for writers to finish, and then copy all changes
+             * not still needed by readers.
+             */
+            Full,
+
+            /**
+             * Like Full, but also wait for readers to finish, so
+             * that the next writer can start over at the beginning
+             * of the write-ahead log.
+             */
+            Restart,
+
+            /**
+             * Like Restart, but also truncate the write-ahead log file.
+             */
+            Truncate,
+        };
+
+        /**
+         * This holds options which control how the checkpoint
+         * scheduler operates.
+         */
+        struct CheckpointOptions {
+            /**
+             * This is the way in which checkpoints are done.
+             */
+            CheckpointMode mode = CheckpointMode::Passive;
+
+            /**
+             * This is the longest time to go without doing a checkpoint,
+             * if there are any changes to copy.
+             */
+            std::chrono::milliseconds interval = std::chrono::milliseconds(1000);
+
+            /**
+             * A checkpoint is done as soon as a commit leaves at least this
+             * many frames in the write-ahead log.
+             */
+            size_t frameThreshold = 1000;
+
+            /**
+             * If not zero, a commit which leaves the write-ahead log
+             * larger than this many bytes waits for a checkpoint to
+             * be done before returning.
+             */
+            size_t walSizeLimit = 0;
+
+            /**
+             * This is the longest time a commit will wait because the
+             * write-ahead log is larger than the walSizeLimit.
+             */
+            std::chrono::milliseconds maxBackPressureWait = std::chrono::milliseconds(1000);
+        };
+
+        /**
+         * This holds statistics about checkpoints done by the
+         * checkpoint scheduler.
+         */
+        struct CheckpointStatistics {
+            /**
+             * This is the number of checkpoints completed.
+             */
+            size_t checkpoints = 0;
+
+            /**
+             * This is the number of checkpoints which could not be
+             * completed because the database was busy.
+             */
+            size_t busyCheckpoints = 0;
+
+            /**
+             * This is the total number of frames copied from the
+             * write-ahead log into the database.
+             */
+            size_t framesCheckpointed = 0;
+
+            /**
+             * This is the number of frames in the write-ahead log as of
+             * the last checkpoint.
+             */
+            size_t walFrames = 0;
+
+            /**
+             * This is the time taken by the last checkpoint.
+             */
+            std::chrono::microseconds lastDuration = std::chrono::microseconds(0);
+
+            /**
+             * This is the time taken by the slowest checkpoint.
+             */
+            std::chrono::microseconds maxDuration = std::chrono::microseconds(0);
+
+            /**
+             * This is the total time taken by all checkpoints.
+             */
+            std::chrono::microseconds totalDuration = std::chrono::microseconds(0);
+
+            /**
+             * This is the number of commits which had to wait because the
+             * write-ahead log was larger than the walSizeLimit.
+             */
+            size_t backPressureWaits = 0;
+
+            /**
+             * This is the total time commits spent waiting because the
+             * write-ahead log was larger than the walSizeLimit.
+             */
+            std::chrono::microseconds backPressureDuration = std::chrono::microseconds(0);
+        };
+
+        /**
+         * This holds options which control how the cache is warmed up
+         * after the database is opened.
+         */
+        struct WarmUpOptions {
+            /**
+             * This is the maximum number of bytes to read from the
+             * database while warming up the cache.  If zero, the
+             * cache is not warmed up.
+             */
+            size_t byteBudget = 0;
+
+            /**
+             * If true, keep track of which tables are used the most,
+             * so that they're warmed up first the next time the
+             * database is opened, such as after a snapshot is installed.
+             */
+            bool trackHotTables = true;
+        };
+
+        /**
+         * This holds statistics about the last warm-up of the cache.
+         */
+        struct WarmUpStatistics {
+            /**
+             * This indicates whether or not the warm-up has finished.
+             */
+            bool finished = false;
+
+            /**
+             * This is the number of tables and indexes read.
+             */
+            size_t objectsWarmed = 0;
+
+            /**
+             * This is the number of bytes read from the database.
+             */
+            size_t bytesWarmed = 0;
+
+            /**
+             * This is the time taken by the warm-up.
+             */
+            std::chrono::microseconds duration = std::chrono::microseconds(0);
+        };
+
+        /**
+         * This holds options which control how the statistics used by
+         * SQLite's query planner are kept up to date.
+         */
+        struct OptimizeOptions {
+            /**
+             * This is the most rows of each index examined when gathering
+             * statistics, so that refreshing them takes a bounded time.
+             * If zero, all rows are examined.
+             */
+            size_t analysisLimit = 1000;
+
+            /**
+             * If nonzero, a table is due to be analyzed by the next call
+             * to Optimize once this many of its rows have been inserted,
+             * updated or deleted, by transactions which were committed,
+             * since it was last analyzed.  Otherwise, only SQLite decides
+             * which tables Optimize analyzes.
+             */
+            size_t rowChangeThreshold = 10000;
+        };
+
+        /**
+         * This holds statistics about refreshing the statistics used by
+         * SQLite's query planner.
+         */
+        struct OptimizeStatistics {
+            /**
+             * This is the number of times the statistics were refreshed.
+             */
+            size_t runs = 0;
+
+            /**
+             * This is the total time taken to refresh the statistics.
+             */
+            std::chrono::microseconds duration = std::chrono::microseconds(0);
+        };
+
+        /**
+         * This holds the values of one column for a batch of rows of
+         * query results, in contiguous arrays laid out as Apache Arrow
+         * lays out arrays, so that they can be processed without
+         * conversion, such as by vectorized loops.
+         */
+        struct BatchColumn {
+            /**
+             * This is the type of the column's values, which determines
+             * which of the arrays below hold them.
+             */
+            Value::Type type = Value::Type::Invalid;
+
+            /**
+             * This is a bitmap with one bit per row, least significant
+             * bit first, which is set if the row's value is not NULL.
+             */
+            std::vector< uint8_t > validity;
+
+            /**
+             * This is the number of rows whose value is NULL.
+             */
+            size_t nullCount = 0;
+
+            /**
+             * If the column holds integers, these are the values,
+             * with zero in place of NULL.
+             */
+            std::vector< int64_t > integers;
+
+            /**
+             * If the column holds real numbers, these are the values,
+             * with zero in place of NULL.
+             */
+            std::vector< double > reals;
+
+            /**
+             * If the column holds booleans, this is a bitmap with one bit
+             * per row, least significant bit first, which is set if the
+             * row's value is true.
+             */
+            std::vector< uint8_t > booleans;
+
+            /**
+             * If the column holds text, these are the offsets into the
+             * bytes array of the start of each row's value, plus one more
+             * for the end of the last value.  NULL values are empty.
+             */
+            std::vector< int32_t > offsets;
+
+            /**
+             * If the column holds text, these are the UTF-8 encoded
+             * values of all rows, one after another.
+             */
+            std::vector< char > bytes;
+        };
+
+        /**
+         * This holds a batch of rows of query results, stored column
+         * by column.
+         */
+        struct ColumnBatch {
+            /**
+             * This is the number of rows in the batch.
+             */
+            size_t rowCount = 0;
+
+            /**
+             * These are the columns of the batch.
+             */
+            std::vector< BatchColumn > columns;
+        };
+
+        /**
+         * These are the levels of memory pressure reported when the
+         * memory used by SQLite approaches the limits set for it.
+         */
+        enum class MemoryPressure {
+            /**
+             * Memory use is below the soft limit.
+             */
+            None,
+
+            /**
+             * Memory use has reached the soft limit, so SQLite is
+             * shrinking its caches, which may slow things down.
+             */
+            Soft,
+
+            /**
+             * Memory use is close to the hard limit, beyond which
+             * SQLite fails to allocate memory.
+             */
+            Hard,
+        };
+
+        /**
+         * This holds measurements of the memory used by SQLite and
+         * by the database.
+         */
+        struct MemoryUsage {
+            /**
+             * This is the number of bytes of heap memory currently
+             * allocated by SQLite, for all databases in the process.
+             */
+            size_t heapUsed = 0;
+
+            /**
+             * This is the most bytes of heap memory allocated by SQLite
+             * at any one time, for all databases in the process.
+             */
+            size_t heapPeak = 0;
+
+            /**
+             * This is the number of bytes of heap memory used by the
+             * page cache of the database connection.
+             */
+            size_t cacheUsed = 0;
+
+            /**
+             * This is the number of bytes of heap memory used by the
+             * prepared statements of the database connection.
+             */
+            size_t statementsUsed = 0;
+
+            /**
+             * This is the number of bytes of heap memory used to hold
+             * the schema of the database.
+             */
+            size_t schemaUsed = 0;
+
+            /**
+             * This is the estimated number of bytes of memory used by
+             * the query result cache, if enabled.  The values it holds
+             * are copies made by SQLite, so most of this is also part
+             * of heapUsed, and it isn't counted again towards the
+             * memory pressure.
+             */
+            size_t queryCacheUsed = 0;
+
+            /**
+             * This is the number of bytes of snapshots, held outside
+             * SQLite's heap, which calls to CreateSnapshot or
+             * InstallSnapshot are working with right now.  A snapshot
+             * is counted only until the call returns; once CreateSnapshot
+             * returns one, it belongs to the application and is no longer
+             * counted.  This is counted towards the memory pressure.
+             */
+            size_t snapshotBytes = 0;
+
+            /**
+             * This is the most bytes ever counted in snapshotBytes
+             * at one time.
+             */
+            size_t snapshotPeak = 0;
+
+            /**
+             * This is the level of memory pressure, given the limits set
+             * and the memory used, which is heapUsed plus snapshotBytes.
+             */
+            MemoryPressure pressure = MemoryPressure::None;
+        };
+
+        /**
+         * This holds limits on the heap memory used by SQLite.  SQLite
+         * applies them to all databases in the process, so the limits
+         * set most recently, by any database, are the ones in effect.
+         */
+        struct MemoryLimits {
+            /**
+             * If nonzero, this is the number of bytes of heap memory
+             * SQLite tries to stay under, by shrinking its caches.
+             */
+            size_t softHeapLimit = 0;
+
+            /**
+             * If nonzero, this is the number of bytes of heap memory
+             * beyond which SQLite fails to allocate memory, causing the
+             * statement needing it to fail rather than the process to be
+             * killed.  This requires SQLite 3.31.0 or later.
+             */
+            size_t hardHeapLimit = 0;
+        };
+
+        /**
+         * This is the type of function called when memory
+         * pressure rises.
+         *
+         * @param[in] pressure
+         *     This is the new level of memory pressure.
+         *
+         * @param[in] usage
+         *     These are the measurements of memory used which
+         *     led to the new level of memory pressure.
+         */
+        using MemoryPressureDelegate = std::function<
+            void(
+                MemoryPressure pressure,
+                const MemoryUsage& usage
+            )
+        >;
+
+        /**
+         * This provides access to the arguments passed to an SQL function
+         * implemented in C++.  Blobs are accessed in place, without
+         * being copied.
+         */
+        class FunctionArguments {
+        public:
+            /**
+             * This is the instance constructor.
+             *
+             * @param[in] count
+             *     This is the number of arguments passed to the function.
+             *
+             * @param[in] values
+             *     These are the arguments passed to the function.
+             */
+            FunctionArguments(int count, sqlite3_value** values);
+
+            /**
+             * Return the number of arguments passed to the function.
+             *
+             * @return
+             *     The number of arguments passed to the function is returned.
+             */
+            size_t GetCount() const;
+
+            /**
+             * Return whether or not the given argument is NULL.
+             *
+             * @param[in] index
+             *     This is the zero-based index of the argument to check.
+             *
+             * @return
+             *     An indication of whether or not the argument is NULL
+             *     is returned.
+             */
+            bool IsNull(size_t index) const;
+
+            /**
+             * Return the given argument, converted to the given type.
+             *
+             * @param[in] index
+             *     This is the zero-based index of the argument to return.
+             *
+             * @param[in] type
+             *     This is the type to which to convert the argument.
+             *
+             * @return
+             *     The argument, converted to the given type, is returned.
+             *     A NULL argument is returned as a null value.
+             */
+            Value Get(size_t index, Value::Type type) const;
+
+            /**
+             * Return the size, in bytes, of the given argument as a blob.
+             *
+             * @param[in] index
+             *     This is the zero-based index of the argument to measure.
+             *
+             * @return
+             *     The size, in bytes, of the argument as a blob is returned.
+             */
+            size_t GetBlobSize(size_t index) const;
+
+            /**
+             * Return a pointer to the bytes of the given argument as
+             * a blob.  The pointer remains valid only until the function
+             * returns.
+             *
+             * @param[in] index
+             *     This is the zero-based index of the argument to access.
+             *
+             * @return
+             *     A pointer to the bytes of the argument as a blob is
+             *     returned, or nullptr if the blob is empty.
+             */
+            const uint8_t* GetBlob(size_t index) const;
+
+        private:
+            /**
+             * This is the number of arguments passed to the function.
+             */
+            int count_;
+
+            /**
+             * These are the arguments passed to the function.
+             */
+            sqlite3_value** values_;
+        };
+
+        /**
+         * This is used to set the result of an SQL function implemented
+         * in C++.
+         */
+        class FunctionResult {
+        public:
+            /**
+             * This is the instance constructor.
+             *
+             * @param[in] context
+             *     This is the SQLite context of the function call.
+             */
+            explicit FunctionResult(sqlite3_context* context);
+
+            /**
+             * Set the result of the function to the given value.
+             *
+             * @param[in] value
+             *     This is the value to which to set the result.
+             */
+            void Set(const Value& value);
+
+            /**
+             * Set the result of the function to a copy of the given blob.
+             *
+             * @param[in] data
+             *     This points to the bytes of the blob.
+             *
+             * @param[in] size
+             *     This is the size of the blob, in bytes.
+             */
+            void SetBlob(const uint8_t* data, size_t size);
+
+            /**
+             * Set the result of the function to a blob of the given size,
+             * and return a pointer to its bytes, so that the function can
+             * fill them in place, rather than having them copied.
+             * The pointer remains valid only until the function returns.
+             *
+             * @param[in] size
+             *     This is the size of the blob, in bytes.
+             *
+             * @return
+             *     A pointer to the bytes of the blob is returned.
+             *
+             * @retval nullptr
+             *     This is returned if the blob could not be allocated,
+             *     in which case the result is set to an error.
+             */
+            uint8_t* AllocateBlob(size_t size);
+
+            /**
+             * Make the function fail with the given error message.
+             *
+             * @param[in] message
+             *     This is the error message to report.
+             */
+            void SetError(const std::string& message);
+
+        private:
+            /**
+             * This is the SQLite context of the function call.
+             */
+            sqlite3_context* context_;
+        };
+
+        /**
+         * This is the type of function called to compute the result of
+         * a scalar SQL function implemented in C++.
+         *
+         * @param[in] arguments
+         *     These are the arguments passed to the function.
+         *
+         * @param[in] result
+         *     This is used to set the result of the function.
+         */
+        using ScalarFunction = std::function<
+            void(
+                const FunctionArguments& arguments,
+                FunctionResult& result
+            )
+        >;
+
+        /**
+         * This is the base class for the state of one group (or window)
+         * of rows being aggregated by an aggregate or window SQL
+         * function implemented in C++.
+         */
+        class Aggregate {
+        public:
+            virtual ~Aggregate() noexcept = default;
+
+            /**
+             * Add a row to the group or window.
+             *
+             * @param[in] arguments
+             *     These are the arguments passed to the function
+             *     for the row.
+             */
+            virtual void Step(const FunctionArguments& arguments) = 0;
+
+            /**
+             * Remove from the window the oldest row added to it.
+             * This is only called for window functions, which must
+             * override it.
+             *
+             * @param[in] arguments
+             *     These are the arguments passed to the function
+             *     for the row.
+             */
+            virtual void Inverse(const FunctionArguments& arguments) {
+                (void)arguments;
+            }
+
+            /**
+             * Set the result of the function for the rows currently in
+             * the group or window.
+             *
+             * @param[in] result
+             *     This is used to set the result of the function.
+             */
+            virtual void GetResult(FunctionResult& result) = 0;
+        };
+
+        /**
+         * This is the type of function called to make the state for
+         * a new group (or window) of rows being aggregated by an
+         * aggregate or window SQL function implemented in C++.
+         *
+         * @return
+         *     The state for a new group of rows is returned.
+         */
+        using AggregateFactory = std::function< std::unique_ptr< Aggregate >() >;
+
+        /**
+         * This describes one column of a virtual table.
+         */
+        struct VirtualTableColumn {
+            /**
+             * This is the name of the column in SQL.
+             */
+            std::string name;
+
+            /**
+             * This is the type of values in the column.
+             */
+            Value::Type type = Value::Type::Text;
+
+            /**
+             * If true, the table can look up rows by the value in this
+             * column, so queries which compare the column to a value
+             * for equality call the Find method of the table rather
+             * than scanning every row.
+             */
+            bool key = false;
+        };
+
+        /**
+         * This is the base class for iterating through the rows of
+         * a virtual table.
+         */
+        class VirtualTableCursor {
+        public:
+            virtual ~VirtualTableCursor() noexcept = default;
+
+            /**
+             * Return whether or not the cursor has moved past the last row.
+             *
+             * @return
+             *     An indication of whether or not the cursor has moved
+             *     past the last row is returned.
+             */
+            virtual bool IsAtEnd() const = 0;
+
+            /**
+             * Move the cursor to the next row.
+             */
+            virtual void Next() = 0;
+
+            /**
+             * Provide the value of the given column in the current row.
+             *
+             * @param[in] column
+             *     This is the zero-based index of the column.
+             *
+             * @param[in] result
+             *     This is used to provide the value of the column.
+             */
+            virtual void GetColumn(size_t column, FunctionResult& result) = 0;
+        };
+
+        /**
+         * This is the base class for data kept outside the database,
+         * such as in a C++ container, which is made available to SQL as
+         * a read-only virtual table, so that it can be scanned and joined
+         * in place, without being copied into the database.
+         */
+        class VirtualTable {
+        public:
+            virtual ~VirtualTable() noexcept = default;
+
+            /**
+             * Return the columns of the table.  This is called once,
+             * when the table is first used by a database connection.
+             *
+             * @return
+             *     The columns of the table are returned.
+             */
+            virtual std::vector< VirtualTableColumn > GetColumns() const = 0;
+
+            /**
+             * Return an estimate of the number of rows in the table,
+             * used by SQLite to choose how to carry out queries.
+             *
+             * @return
+             *     An estimate of the number of rows in the table
+             *     is returned.
+             */
+            virtual size_t EstimateRowCount() const = 0;
+
+            /**
+             * Return a cursor which iterates through all rows of the table.
+             *
+             * @return
+             *     A cursor which iterates through all rows of the table
+             *     is returned.
+             */
+            virtual std::unique_ptr< VirtualTableCursor > Scan() = 0;
+
+            /**
+             * Return a cursor which iterates through the rows of the table
+             * having the given value in the given key column.  SQLite
+             * still checks the value of each row returned, so rows with
+             * other values may be included.  The default implementation
+             * returns all rows.
+             *
+             * @param[in] column
+             *     This is the zero-based index of the key column.
+             *
+             * @param[in] value
+             *     This is the value to find, converted to the type
+             *     of the column.
+             *
+             * @return
+             *     A cursor which iterates through the rows having the
+             *     given value in the given column is returned.
+             */
+            virtual std::unique_ptr< VirtualTableCursor > Find(
+                size_t column,
+                const Value& value
+            ) {
+                (void)column;
+                (void)value;
+                return Scan();
+            }
+        };
+
+        /**
+         * This is a view of the database, pinned to the state of the
+         * database when the view was created.  All statements built from
+         * the view see that same state, even as changes are committed to
+         * the database.  The view uses its own connection to the database,
+         * so it may be used on another thread, and reading through it
+         * neither waits on nor holds up writing to the database.
+         */
+        class ReadView {
+        public:
+            virtual ~ReadView() noexcept = default;
+
+            /**
+             * Build a statement which reads the database as of the
+             * time the view was created.
+             *
+             * @param[in] statement
+             *     This is the text of the SQL statement to build.
+             *
+             * @return
+             *     The results of building the statement are returned.
+             */
+            virtual BuildStatementResults BuildStatement(
+                const std::string& statement
+            ) = 0;
+        };
+
+        // Constants
+    public:
+        /**
+         * This is the error reported for a statement which was
+         * interrupted by a call to Cancel.
+         */
+        static const std::string CANCELED_ERROR;
+
+        /**
+         * This is the error reported for a statement which was
+         * interrupted because a deadline or timeout passed.
+         */
+        static const std::string DEADLINE_EXCEEDED_ERROR;
+
         // Lifecycle
     public:
         ~SQLiteDatabase() noexcept;
@@ -38,6 +1036,555 @@ namespace DatabaseAbstractions {
     public:
         SQLiteDatabase();
         bool Open(const std::string& filePath);
+        bool Open(
+            const std::string& filePath,
+            const OpenOptions& options
+        );
+
+        /**
+         * Return whether or not the database was opened through
+         * the io_uring-backed virtual file system.
+         *
+         * @return
+         *     An indication of whether or not the database was opened
+         *     through the io_uring-backed virtual file system is returned.
+         */
+        bool IsUsingIoUring() const;
+
+        /**
+         * Begin recording the effects of all subsequent changes made to
+         * the database, so that they can be retrieved later as a
+         * changeset by calling EndChangeset.  Any recording already in
+         * progress is discarded.
+         *
+         * @return
+         *     An indication of whether or not recording was started
+         *     successfully is returned.
+         */
+        bool BeginChangeset();
+
+        /**
+         * Stop recording changes made to the database, and return
+         * a changeset containing the net effect of all changes
+         * made since BeginChangeset was called.
+         *
+         * @return
+         *     The changeset is returned.  It's empty if nothing
+         *     changed, or if no recording was in progress.
+         */
+        Blob EndChangeset();
+
+        /**
+         * Apply the given changeset to the database.
+         *
+         * @param[in] changeset
+         *     This is the changeset to apply.
+         *
+         * @param[in] conflictDelegate
+         *     This is the function to call to report any conflicts
+         *     and decide how to resolve them.  If not given, any
+         *     conflicting changes are omitted.
+         *
+         * @return
+         *     If the changeset could not be applied, a description
+         *     of the error is returned.  Otherwise, an empty
+         *     string is returned.
+         */
+        std::string ApplyChangeset(
+            const Blob& changeset,
+            ChangesetConflictDelegate conflictDelegate = nullptr
+        );
+
+        /**
+         * Return a changeset which reverses the effects of the
+         * given changeset.
+         *
+         * @param[in] changeset
+         *     This is the changeset to invert.
+         *
+         * @return
+         *     The inverted changeset is returned.  It's empty if
+         *     the given changeset could not be inverted.
+         */
+        static Blob InvertChangeset(const Blob& changeset);
+
+        /**
+         * Combine the given changesets into a single changeset having
+         * the same effect as applying them one after another.
+         *
+         * @param[in] changesets
+         *     These are the changesets to combine, in the order
+         *     in which they would be applied.
+         *
+         * @return
+         *     The combined changeset is returned.  It's empty if
+         *     the given changesets could not be combined.
+         */
+        static Blob ConcatenateChangesets(const std::vector< Blob >& changesets);
+
+        /**
+         * Set up a cache of the results of read-only queries.  Statements
+         * built afterwards will have their results cached, keyed by
+         * the text of the statement and the values of its bound parameters.
+         * Cached results are discarded when any table they were read from
+         * is changed, by this or any other connection, or when a snapshot
+         * is installed.
+         *
+         * Queries which call functions known to return different results
+         * each time (such as `random()` or `datetime('now')`) are not cached.
+         * Results of queries calling application-defined functions are
+         * cached, so those functions must be deterministic.
+         *
+         * @param[in] memoryBudget
+         *     This is the maximum number of bytes of memory to use
+         *     for holding cached results.  If zero, the cache is
+         *     disabled and any cached results are discarded.
+         */
+        void EnableQueryCache(size_t memoryBudget);
+
+        /**
+         * Return statistics about the use of the query result cache.
+         *
+         * @return
+         *     Statistics about the use of the query result cache
+         *     are returned.
+         */
+        QueryCacheStatistics GetQueryCacheStatistics() const;
+
+        /**
+         * Return free pages at the end of the database file to the
+         * file system, up to the given budget.  This is meant to be
+         * called while the database is otherwise idle, and only has an
+         * effect if the database was created with the `incrementalVacuum`
+         * option.  It's never called automatically: the database can't
+         * tell when the application is idle, and reclaiming pages in the
+         * background would compete with the application's own writes
+         * for the database's write lock.
+         *
+         * @param[in] byteBudget
+         *     This is the maximum number of bytes to reclaim.
+         *
+         * @return
+         *     The number of bytes reclaimed is returned.
+         */
+        size_t ReclaimFreePages(size_t byteBudget);
+
+        /**
+         * Set whether or not snapshots are compacted, leaving out
+         * free pages and defragmenting tables and indexes, when
+         * created by CreateSnapshot.  This makes snapshots smaller
+         * at the cost of taking longer to create them.
+         *
+         * @param[in] compactSnapshots
+         *     This indicates whether or not snapshots are compacted.
+         */
+        void SetCompactSnapshots(bool compactSnapshots);
+
+        /**
+         * Return statistics about reclaiming unused space in the database.
+         *
+         * @return
+         *     Statistics about reclaiming unused space in the database
+         *     are returned.
+         */
+        CompactionStatistics GetCompactionStatistics() const;
+
+        /**
+         * Put the database in write-ahead log mode, turn off SQLite's
+         * automatic checkpoints, and start a background thread which
+         * does checkpoints instead, using a separate connection.
+         * Any checkpoint scheduler already running is stopped first.
+         *
+         * @param[in] options
+         *     These control how the checkpoint scheduler operates.
+         *
+         * @return
+         *     An indication of whether or not the checkpoint scheduler
+         *     was started successfully is returned.
+         */
+        bool StartCheckpointScheduler(const CheckpointOptions& options);
+
+        /**
+         * Stop the checkpoint scheduler, if it's running, and turn
+         * SQLite's automatic checkpoints back on.
+         */
+        void StopCheckpointScheduler();
+
+        /**
+         * Return statistics about checkpoints done by the
+         * checkpoint scheduler.
+         *
+         * @return
+         *     Statistics about checkpoints done by the checkpoint
+         *     scheduler are returned.
+         */
+        CheckpointStatistics GetCheckpointStatistics() const;
+
+        /**
+         * Set up warming of the cache each time the database is opened,
+         * including when a snapshot is installed.  A background thread
+         * reads the pages of the hottest tables and their indexes,
+         * using a separate connection, so that they're already cached
+         * by the operating system when queries need them.
+         *
+         * While warm-up runs, a write which finds the database locked
+         * by it makes warm-up give way, and waits for it to do so,
+         * rather than failing.
+         *
+         * @param[in] options
+         *     These control how the cache is warmed up.
+         */
+        void EnableWarmUp(const WarmUpOptions& options);
+
+        /**
+         * Set the names of the tables to warm up first, in order of
+         * priority, the next time the database is opened.
+         *
+         * @param[in] tables
+         *     These are the names of the tables to warm up.
+         */
+        void SetHotTables(const std::vector< std::string >& tables);
+
+        /**
+         * Return the names of the tables to warm up first, in order
+         * of priority, the next time the database is opened.
+         *
+         * @return
+         *     The names of the tables to warm up first are returned.
+         */
+        std::vector< std::string > GetHotTables() const;
+
+        /**
+         * Wait for any warm-up of the cache in progress to finish.
+         */
+        void WaitForWarmUp();
+
+        /**
+         * Return statistics about the last warm-up of the cache.
+         *
+         * @return
+         *     Statistics about the last warm-up of the cache are returned.
+         */
+        WarmUpStatistics GetWarmUpStatistics() const;
+
+        /**
+         * Keep the statistics used by SQLite's query planner up to date,
+         * so that the plans it chooses fit the data as tables grow.
+         * Tables become due to be analyzed once enough of their rows have
+         * changed, and are analyzed by the next call to Optimize, which
+         * the application should make at a convenient time, such as when
+         * IsOptimizeDue returns true between batches of work.  Optimize
+         * is also called when the database is closed, and tables with
+         * indexes but no statistics are analyzed after a snapshot is
+         * installed.  Statistics are never refreshed while statements
+         * are being stepped or executed, so refreshing them doesn't count
+         * against their timeouts or deadlines.  The statistics are stored
+         * in the database, so they're included in snapshots.
+         *
+         * @param[in] options
+         *     These control how the statistics are kept up to date.
+         */
+        void EnableAutoOptimize(const OptimizeOptions& options);
+
+        /**
+         * Stop keeping the statistics used by SQLite's query planner
+         * up to date automatically.
+         */
+        void DisableAutoOptimize();
+
+        /**
+         * Analyze the tables due to be analyzed, if statistics are kept
+         * up to date automatically, and then run "PRAGMA optimize", which
+         * refreshes the statistics used by SQLite's query planner for any
+         * other tables whose queries might benefit, such as tables which
+         * have grown a lot.
+         */
+        void Optimize();
+
+        /**
+         * Return an indication of whether or not enough rows of some
+         * table have changed that it should be analyzed by calling
+         * Optimize.
+         *
+         * @return
+         *     An indication of whether or not Optimize should be
+         *     called is returned.
+         */
+        bool IsOptimizeDue() const;
+
+        /**
+         * Return statistics about refreshing the statistics used by
+         * SQLite's query planner.
+         *
+         * @return
+         *     Statistics about refreshing the statistics used by
+         *     SQLite's query planner are returned.
+         */
+        OptimizeStatistics GetOptimizeStatistics() const;
+
+        /**
+         * Register a scalar SQL function implemented in C++.  The
+         * function must be deterministic, since SQLite may factor calls
+         * with constant arguments out of loops, and the query cache may
+         * return results computed earlier.  The function stays registered
+         * if the database is reopened or a snapshot is installed.
+         *
+         * Besides functions registered this way, the following are
+         * always available:
+         * - float32_blob(text) -- convert a list of numbers, such as
+         *   '[1, 2.5, 3]', to a blob of 32-bit floating-point values.
+         * - dot_product(a, b) -- compute the dot product of two blobs
+         *   of 32-bit floating-point values.
+         * - l2_distance(a, b) -- compute the Euclidean distance between
+         *   two blobs of 32-bit floating-point values.
+         *
+         * @param[in] name
+         *     This is the name of the function in SQL.
+         *
+         * @param[in] argumentCount
+         *     This is the number of arguments the function takes,
+         *     or -1 if it takes any number of arguments.
+         *
+         * @param[in] function
+         *     This is called to compute the result of the function.
+         *
+         * @return
+         *     An error message is returned if the function could not be
+         *     registered.  Otherwise, an empty string is returned.
+         */
+        std::string CreateScalarFunction(
+            const std::string& name,
+            int argumentCount,
+            ScalarFunction function
+        );
+
+        /**
+         * Register an aggregate SQL function implemented in C++.  The
+         * function must be deterministic.  The function stays registered
+         * if the database is reopened or a snapshot is installed.
+         *
+         * @param[in] name
+         *     This is the name of the function in SQL.
+         *
+         * @param[in] argumentCount
+         *     This is the number of arguments the function takes,
+         *     or -1 if it takes any number of arguments.
+         *
+         * @param[in] factory
+         *     This is called to make the state for each group of rows
+         *     aggregated by the function.
+         *
+         * @return
+         *     An error message is returned if the function could not be
+         *     registered.  Otherwise, an empty string is returned.
+         */
+        std::string CreateAggregateFunction(
+            const std::string& name,
+            int argumentCount,
+            AggregateFactory factory
+        );
+
+        /**
+         * Register an aggregate SQL function implemented in C++ which may
+         * also be used as a window function, in which case rows are
+         * removed from the window through the Inverse method of its state.
+         * The function must be deterministic.  The function stays
+         * registered if the database is reopened or a snapshot is
+         * installed.
+         *
+         * @param[in] name
+         *     This is the name of the function in SQL.
+         *
+         * @param[in] argumentCount
+         *     This is the number of arguments the function takes,
+         *     or -1 if it takes any number of arguments.
+         *
+         * @param[in] factory
+         *     This is called to make the state for each group or window
+         *     of rows aggregated by the function.
+         *
+         * @return
+         *     An error message is returned if the function could not be
+         *     registered.  Otherwise, an empty string is returned.
+         */
+        std::string CreateWindowFunction(
+            const std::string& name,
+            int argumentCount,
+            AggregateFactory factory
+        );
+
+        /**
+         * Make the given table available to SQL under the given name,
+         * as a read-only (eponymous) virtual table, which doesn't need
+         * to be created with a CREATE VIRTUAL TABLE statement.  Its rows
+         * are read in place each time a query uses the table, so queries
+         * always see its current contents.  Queries reading the table
+         * are therefore never answered from the query cache.  The table
+         * stays registered if the database is reopened or a snapshot
+         * is installed.
+         *
+         * @param[in] name
+         *     This is the name of the table in SQL.
+         *
+         * @param[in] table
+         *     This is the table to make available to SQL.
+         *
+         * @return
+         *     An error message is returned if the table could not be
+         *     registered.  Otherwise, an empty string is returned.
+         */
+        std::string CreateVirtualTable(
+            const std::string& name,
+            std::shared_ptr< VirtualTable > table
+        );
+
+        /**
+         * Set the longest time each call which runs statements, such as
+         * stepping a statement or executing statements, may take before
+         * it's interrupted.  An interrupted call reports
+         * DEADLINE_EXCEEDED_ERROR, and a statement interrupted while
+         * being stepped must be reset before it's stepped again.
+         * Each step of a statement is a separate call, so the timeout
+         * bounds each step, not the time taken to step through all the
+         * rows of a statement.  Use SetDeadline to bound that.
+         *
+         * @param[in] timeout
+         *     This is the longest time each call may take,
+         *     or zero if there is no limit.
+         */
+        void SetTimeout(std::chrono::milliseconds timeout);
+
+        /**
+         * Set a time by which all calls which run statements must finish,
+         * until the deadline is cleared.  Calls still running when the
+         * deadline passes are interrupted, and calls made after it has
+         * passed fail without running, including steps of statements
+         * whose results come from the query cache.  Either way, they
+         * report DEADLINE_EXCEEDED_ERROR.
+         *
+         * @param[in] deadline
+         *     This is the time by which all calls must finish.
+         */
+        void SetDeadline(std::chrono::steady_clock::time_point deadline);
+
+        /**
+         * Clear any deadline set by SetDeadline.
+         */
+        void ClearDeadline();
+
+        /**
+         * Interrupt the call running statements which is in progress.
+         * If no call is in progress, such as between steps of a
+         * statement, the next call is canceled before it runs instead.
+         * The canceled call reports CANCELED_ERROR, and calls after it
+         * are not affected.  This may be called from any thread.
+         */
+        void Cancel();
+
+        /**
+         * Execute the given SQL statements, interrupting them if they
+         * take longer than the given time.
+         *
+         * @param[in] statement
+         *     This is the text of the SQL statements to execute.
+         *
+         * @param[in] timeout
+         *     This is the longest time the statements may take, if
+         *     nonzero, in place of the timeout set by SetTimeout.
+         *     Any deadline set by SetDeadline still applies.
+         *
+         * @return
+         *     An error message is returned if the statements could not
+         *     be executed.  Otherwise, an empty string is returned.
+         */
+        std::string ExecuteStatement(
+            const std::string& statement,
+            std::chrono::milliseconds timeout
+        );
+
+        /**
+         * Measure the memory currently used by SQLite and the database.
+         *
+         * @return
+         *     The measurements of memory used are returned.
+         */
+        MemoryUsage GetMemoryUsage() const;
+
+        /**
+         * Set limits on the heap memory used by SQLite, and register
+         * a function to call when memory pressure rises.  Memory use
+         * is checked after statements are executed, stepped to
+         * completion, or built, and when snapshots are created
+         * or installed.
+         *
+         * @param[in] limits
+         *     These are the limits on the heap memory used by SQLite.
+         *
+         * @param[in] onPressure
+         *     If not nullptr, this is called, on whichever thread
+         *     checked memory use, whenever memory pressure rises.
+         *     It may release memory, such as by disabling the query
+         *     result cache, but must not run statements.
+         */
+        void SetMemoryLimits(
+            const MemoryLimits& limits,
+            MemoryPressureDelegate onPressure = nullptr
+        );
+
+        /**
+         * Step a statement built by this class through up to the given
+         * number of rows of results, storing their column values in the
+         * given batch, rather than fetching each value separately.
+         * Arrays already allocated by the batch are reused, so using
+         * the same batch repeatedly avoids allocating memory.
+         *
+         * @param[in,out] statement
+         *     This is the statement to step.  It must have been built by
+         *     this class, either directly or through a read view.
+         *
+         * @param[in] columnTypes
+         *     These are the types of the columns to fetch, which are the
+         *     first columns of the results, in order.
+         *
+         * @param[in] maxRows
+         *     This is the most rows to step through.
+         *
+         * @param[out] batch
+         *     This is where to store the column values of the rows
+         *     stepped through.
+         *
+         * @return
+         *     The results of the last step are returned.  The statement
+         *     has no more rows if done is set, although the batch may
+         *     still hold rows stepped through before then.
+         */
+        static StepStatementResults StepBatch(
+            PreparedStatement& statement,
+            const std::vector< Value::Type >& columnTypes,
+            size_t maxRows,
+            ColumnBatch& batch
+        );
+
+        /**
+         * Create a view of the database, pinned to its current committed
+         * state, for consistent reads spanning several statements.
+         * The database is put in write-ahead log mode, if it isn't
+         * already, so that reading through the view and writing to the
+         * database don't wait on each other.  The view holds its state
+         * until it and all statements built from it are destroyed, and
+         * until then, installing a snapshot fails.  Timeouts, deadlines
+         * and cancellation set for the database also apply to statements
+         * built from the view.  SQL functions registered with the
+         * database are also available through the view, but virtual
+         * tables are not, since the view may be used on other threads.
+         *
+         * @return
+         *     The view of the database is returned.
+         *
+         * @retval nullptr
+         *     This is returned if the view could not be created.
+         */
+        std::shared_ptr< ReadView > CreateReadView();
 
         // Database
     public:
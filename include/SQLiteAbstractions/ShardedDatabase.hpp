@@ -0,0 +1,303 @@
+#pragma once
+
+/**
+ * @file ShardedDatabase.hpp
+ *
+ * This module declares the DatabaseAbstractions::ShardedDatabase class.
+ */
+
+#include <DatabaseAbstractions/Database.hpp>
+#include <functional>
+#include <memory>
+#include <SQLiteAbstractions/SQLiteDatabase.hpp>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+namespace DatabaseAbstractions {
+
+    /**
+     * This spreads data across several SQLite database files (shards),
+     * each with its own connection and its own thread, so that writes to
+     * different shards proceed in parallel and each shard can be
+     * snapshotted separately.  Rows are partitioned by hashing the value
+     * of a key chosen by the application, such as a user or entity ID.
+     * Statements concerning a single key are run on the shard owning the
+     * key, while other statements are run on all shards in parallel,
+     * with their results gathered together.
+     */
+    class ShardedDatabase {
+        // Types
+    public:
+        /**
+         * This is the type used to hold the column values of one row
+         * of query results.
+         */
+        using Row = std::vector< Value >;
+
+        /**
+         * This is the type of function used to order rows of query
+         * results gathered from several shards.
+         *
+         * @param[in] lhs
+         *     This is the first row to compare.
+         *
+         * @param[in] rhs
+         *     This is the second row to compare.
+         *
+         * @return
+         *     An indication of whether or not the first row
+         *     comes before the second row is returned.
+         */
+        using RowOrder = std::function<
+            bool(
+                const Row& lhs,
+                const Row& rhs
+            )
+        >;
+
+        /**
+         * This holds the results of a query.
+         */
+        struct QueryResults {
+            /**
+             * These are the rows produced by the query.
+             */
+            std::vector< Row > rows;
+
+            /**
+             * If the query failed on any shard, this is the error
+             * message reported.  Otherwise, this is empty.
+             */
+            std::string error;
+        };
+
+        // Lifecycle
+    public:
+        ~ShardedDatabase() noexcept;
+        ShardedDatabase(const ShardedDatabase&) = delete;
+        ShardedDatabase(ShardedDatabase&&) noexcept;
+        ShardedDatabase& operator=(const ShardedDatabase&) = delete;
+        ShardedDatabase& operator=(ShardedDatabase&&) noexcept;
+
+        // Methods
+    public:
+        /**
+         * This is the instance constructor.
+         */
+        ShardedDatabase();
+
+        /**
+         * Open the given database files as the shards of the database,
+         * closing any shards already open.  The number and order of the
+         * files determine which shard owns each key, so they must be
+         * the same each time the database is opened.
+         *
+         * @param[in] filePaths
+         *     These are the paths to the database files of the shards.
+         *
+         * @return
+         *     An indication of whether or not all shards were opened
+         *     successfully is returned.
+         */
+        bool Open(const std::vector< std::string >& filePaths);
+
+        /**
+         * Close all shards of the database.
+         */
+        void Close();
+
+        /**
+         * Return the number of shards of the database.
+         *
+         * @return
+         *     The number of shards of the database is returned.
+         */
+        size_t GetShardCount() const;
+
+        /**
+         * Return the index of the shard which owns the given key.
+         *
+         * @param[in] key
+         *     This is the key whose shard to find.
+         *
+         * @return
+         *     The index of the shard which owns the given key is returned.
+         */
+        size_t GetShardForKey(const Value& key) const;
+
+        /**
+         * Run the given function on the thread of the given shard,
+         * giving it the database of the shard, and wait for it
+         * to return.
+         *
+         * @param[in] shard
+         *     This is the index of the shard on which to run the function.
+         *
+         * @param[in] task
+         *     This is the function to run.
+         *
+         * @return
+         *     An indication of whether or not the function was run
+         *     is returned.  It is not run if the shard index is not
+         *     less than the number of shards.
+         */
+        bool RunOnShard(
+            size_t shard,
+            const std::function< void(SQLiteDatabase& database) >& task
+        );
+
+        /**
+         * Run the given function on the threads of all shards in
+         * parallel, giving it the index and database of each shard,
+         * and wait for all of them to return.
+         *
+         * @param[in] task
+         *     This is the function to run.
+         */
+        void RunOnAllShards(
+            const std::function< void(size_t shard, SQLiteDatabase& database) >& task
+        );
+
+        /**
+         * Execute the given SQL statements on the shard owning
+         * the given key.
+         *
+         * @param[in] key
+         *     This is the key which determines the shard on which
+         *     to execute the statements.
+         *
+         * @param[in] statement
+         *     This is the text of the SQL statements to execute.
+         *
+         * @param[in] parameters
+         *     These are the values to bind to the parameters of the
+         *     statement.  If any are given, the text must hold
+         *     only one statement.
+         *
+         * @return
+         *     An error message is returned if the statements could not
+         *     be executed.  Otherwise, an empty string is returned.
+         */
+        std::string ExecuteForKey(
+            const Value& key,
+            const std::string& statement,
+            const std::vector< Value >& parameters = {}
+        );
+
+        /**
+         * Execute the given SQL statements on all shards in parallel,
+         * such as to change the schema.
+         *
+         * Each shard executes the statements on its own, so if they
+         * fail on some shards, the changes made on the other shards
+         * remain, and the shards may be left with different schemas.
+         *
+         * @param[in] statement
+         *     This is the text of the SQL statements to execute.
+         *
+         * @return
+         *     An error message naming each shard on which the
+         *     statements could not be executed is returned, if any.
+         *     Otherwise, an empty string is returned.
+         */
+        std::string ExecuteOnAllShards(const std::string& statement);
+
+        /**
+         * Run the given query on the shard owning the given key.
+         *
+         * @param[in] key
+         *     This is the key which determines the shard on which
+         *     to run the query.
+         *
+         * @param[in] statement
+         *     This is the text of the query.
+         *
+         * @param[in] columnTypes
+         *     These are the types of the columns produced by the query.
+         *
+         * @param[in] parameters
+         *     These are the values to bind to the parameters of the query.
+         *
+         * @return
+         *     The results of the query are returned.
+         */
+        QueryResults QueryForKey(
+            const Value& key,
+            const std::string& statement,
+            const std::vector< Value::Type >& columnTypes,
+            const std::vector< Value >& parameters = {}
+        );
+
+        /**
+         * Run the given query on all shards in parallel, and gather
+         * the rows produced by all of them.
+         *
+         * @param[in] statement
+         *     This is the text of the query.
+         *
+         * @param[in] columnTypes
+         *     These are the types of the columns produced by the query.
+         *
+         * @param[in] parameters
+         *     These are the values to bind to the parameters of the query.
+         *
+         * @param[in] order
+         *     If given, the query is expected to produce rows in this
+         *     order on each shard (such as through an ORDER BY clause),
+         *     and the rows from all shards are merged in this order.
+         *     Otherwise, the rows are given in order of shard.
+         *
+         * @return
+         *     The results of the query are returned.
+         */
+        QueryResults QueryAllShards(
+            const std::string& statement,
+            const std::vector< Value::Type >& columnTypes,
+            const std::vector< Value >& parameters = {},
+            RowOrder order = nullptr
+        );
+
+        /**
+         * Make snapshots of all shards in parallel.
+         *
+         * @return
+         *     The snapshots of the shards, in order of shard,
+         *     are returned.
+         */
+        std::vector< Blob > CreateSnapshots();
+
+        /**
+         * Replace the contents of all shards in parallel with the
+         * given snapshots.
+         *
+         * Each shard installs its snapshot on its own, so if some
+         * snapshots could not be installed, the other shards are
+         * still replaced.
+         *
+         * @param[in] snapshots
+         *     These are the snapshots of the shards, in order of shard.
+         *
+         * @return
+         *     An error message naming each shard whose snapshot could
+         *     not be installed is returned, if any.  Otherwise, an
+         *     empty string is returned.
+         */
+        std::string InstallSnapshots(const std::vector< Blob >& snapshots);
+
+        // Properties
+    private:
+        /**
+         * This is the type of structure that contains the private
+         * properties of the instance.  It is defined in the implementation
+         * and declared here to ensure that it is scoped inside the class.
+         */
+        struct Impl;
+
+        /**
+         * This contains the private properties of the instance.
+         */
+        std::unique_ptr< Impl > impl_;
+    };
+
+}
@@ -0,0 +1,358 @@
+/**
+ * @file CheckpointScheduler.cpp
+ *
+ * This module contains the implementation of the
+ * DatabaseAbstractions::CheckpointScheduler class.
+ */
+
+#include "CheckpointScheduler.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <sqlite3.h>
+#include <stdint.h>
+#include <thread>
+
+namespace {
+
+    /**
+     * This is the number of bytes in the header of each frame
+     * of the write-ahead log.
+     */
+    constexpr size_t WAL_FRAME_HEADER_SIZE = 24;
+
+    /**
+     * Return the SQLite code for the given checkpoint mode.
+     *
+     * @param[in] mode
+     *     This is the checkpoint mode to convert.
+     *
+     * @return
+     *     The SQLite code for the given checkpoint mode is returned.
+     */
+    int ToSqliteCheckpointMode(DatabaseAbstractions::SQLiteDatabase::CheckpointMode mode) {
+        switch (mode) {
+            case DatabaseAbstractions::SQLiteDatabase::CheckpointMode::Full: {
+                return SQLITE_CHECKPOINT_FULL;
+            }
+
+            case DatabaseAbstractions::SQLiteDatabase::CheckpointMode::Restart: {
+                return SQLITE_CHECKPOINT_RESTART;
+            }
+
+            case DatabaseAbstractions::SQLiteDatabase::CheckpointMode::Truncate: {
+                return SQLITE_CHECKPOINT_TRUNCATE;
+            }
+
+            default: {
+                return SQLITE_CHECKPOINT_PASSIVE;
+            }
+        }
+    }
+
+}
+
+namespace DatabaseAbstractions {
+
+    /**
+     * This contains the private properties of a CheckpointScheduler instance.
+     */
+    struct CheckpointScheduler::Impl {
+        // Properties
+
+        /**
+         * These control how the checkpoint scheduler operates.
+         */
+        SQLiteDatabase::CheckpointOptions options;
+
+        /**
+         * This is the size of each frame of the write-ahead log, in bytes.
+         */
+        size_t frameSize = 0;
+
+        /**
+         * This is the connection to the database used to do checkpoints.
+         */
+        sqlite3* db = nullptr;
+
+        /**
+         * This is used to synchronize access to the properties below.
+         */
+        mutable std::mutex mutex;
+
+        /**
+         * This is used to wake up the background thread.
+         */
+        std::condition_variable wakeCondition;
+
+        /**
+         * This is used to wake up commits waiting for a checkpoint.
+         */
+        std::condition_variable checkpointCondition;
+
+        /**
+         * This is the background thread which does checkpoints.
+         */
+        std::thread worker;
+
+        /**
+         * This indicates whether or not the background thread
+         * should stop.
+         */
+        bool stop = false;
+
+        /**
+         * This counts the number of transactions committed.
+         */
+        uint64_t commitCount = 0;
+
+        /**
+         * This is the number of transactions committed as of the start
+         * of the last checkpoint attempted.
+         */
+        uint64_t attemptedCommitCount = 0;
+
+        /**
+         * This is the number of transactions committed as of the start
+         * of the last checkpoint which copied all frames from the
+         * write-ahead log.
+         */
+        uint64_t completedCommitCount = 0;
+
+        /**
+         * This indicates whether or not the last checkpoint attempted
+         * left frames in the write-ahead log which were not copied.
+         */
+        bool incomplete = false;
+
+        /**
+         * This is the number of frames in the write-ahead log as of
+         * the last commit.
+         */
+        size_t walFrames = 0;
+
+        /**
+         * This is the number of frames in the write-ahead log as of
+         * the last checkpoint.
+         */
+        size_t lastLogFrames = 0;
+
+        /**
+         * This is the number of frames in the write-ahead log which
+         * had been copied into the database as of the last checkpoint.
+         */
+        size_t lastCheckpointedFrames = 0;
+
+        /**
+         * This is the number of commits currently waiting for
+         * a checkpoint.
+         */
+        size_t backPressureWaiters = 0;
+
+        /**
+         * This holds statistics about checkpoints done.
+         */
+        SQLiteDatabase::CheckpointStatistics statistics;
+
+        // Methods
+
+        /**
+         * Do a checkpoint, and update statistics accordingly.
+         *
+         * @param[in] lock
+         *     This is the lock held on the mutex, which is released
+         *     while the checkpoint is being done.
+         */
+        void Checkpoint(std::unique_lock< std::mutex >& lock) {
+            const auto startCommitCount = commitCount;
+            const auto startWalFrames = walFrames;
+            attemptedCommitCount = startCommitCount;
+            lock.unlock();
+            int logFrames = 0;
+            int checkpointedFrames = 0;
+            const auto start = std::chrono::steady_clock::now();
+            const auto result = sqlite3_wal_checkpoint_v2(
+                db,
+                "main",
+                ToSqliteCheckpointMode(options.mode),
+                &logFrames,
+                &checkpointedFrames
+            );
+            const auto duration = std::chrono::duration_cast< std::chrono::microseconds >(
+                std::chrono::steady_clock::now() - start
+            );
+            lock.lock();
+            if ((size_t)std::max(logFrames, 0) < lastLogFrames) {
+                lastCheckpointedFrames = 0;
+            }
+            if (
+                (result == SQLITE_OK)
+                && (options.mode == SQLiteDatabase::CheckpointMode::Truncate)
+            ) {
+                // A successful truncating checkpoint reports an empty log,
+                // so count the frames the log held as of the last commit.
+                if (startWalFrames > lastCheckpointedFrames) {
+                    statistics.framesCheckpointed += startWalFrames - lastCheckpointedFrames;
+                }
+                lastCheckpointedFrames = 0;
+            } else if ((size_t)std::max(checkpointedFrames, 0) > lastCheckpointedFrames) {
+                statistics.framesCheckpointed += (size_t)checkpointedFrames - lastCheckpointedFrames;
+                lastCheckpointedFrames = (size_t)checkpointedFrames;
+            }
+            lastLogFrames = (size_t)std::max(logFrames, 0);
+            if (result == SQLITE_OK) {
+                ++statistics.checkpoints;
+            } else {
+                ++statistics.busyCheckpoints;
+            }
+            statistics.walFrames = (logFrames > 0) ? (size_t)logFrames : 0;
+            statistics.lastDuration = duration;
+            if (duration > statistics.maxDuration) {
+                statistics.maxDuration = duration;
+            }
+            statistics.totalDuration += duration;
+            incomplete = (
+                (result != SQLITE_OK)
+                || (checkpointedFrames < logFrames)
+            );
+            if (!incomplete) {
+                completedCommitCount = startCommitCount;
+            }
+            checkpointCondition.notify_all();
+        }
+
+        /**
+         * This is the body of the background thread.
+         */
+        void Worker() {
+            std::unique_lock< std::mutex > lock(mutex);
+            while (!stop) {
+                const auto triggered = wakeCondition.wait_for(
+                    lock,
+                    options.interval,
+                    [this]{
+                        return (
+                            stop
+                            || (
+                                (commitCount != attemptedCommitCount)
+                                && (
+                                    (walFrames >= options.frameThreshold)
+                                    || (backPressureWaiters > 0)
+                                )
+                            )
+                        );
+                    }
+                );
+                if (stop) {
+                    break;
+                }
+                if (
+                    !triggered
+                    && !incomplete
+                    && (commitCount == attemptedCommitCount)
+                ) {
+                    continue;
+                }
+                Checkpoint(lock);
+            }
+        }
+    };
+
+    CheckpointScheduler::~CheckpointScheduler() noexcept {
+        Stop();
+    }
+
+    CheckpointScheduler::CheckpointScheduler()
+        : impl_(new Impl())
+    {
+    }
+
+    bool CheckpointScheduler::Start(
+        const std::string& filePath,
+        const SQLiteDatabase::CheckpointOptions& options,
+        size_t pageSize
+    ) {
+        Stop();
+        if (
+            sqlite3_open_v2(
+                filePath.c_str(),
+                &impl_->db,
+                SQLITE_OPEN_READWRITE,
+                NULL
+            ) != SQLITE_OK
+        ) {
+            (void)sqlite3_close(impl_->db);
+            impl_->db = nullptr;
+            return false;
+        }
+        (void)sqlite3_busy_timeout(impl_->db, (int)options.interval.count());
+        impl_->options = options;
+        impl_->frameSize = pageSize + WAL_FRAME_HEADER_SIZE;
+        impl_->stop = false;
+        impl_->commitCount = 0;
+        impl_->attemptedCommitCount = 0;
+        impl_->completedCommitCount = 0;
+        impl_->incomplete = false;
+        impl_->walFrames = 0;
+        impl_->lastLogFrames = 0;
+        impl_->lastCheckpointedFrames = 0;
+        impl_->worker = std::thread(&Impl::Worker, impl_.get());
+        return true;
+    }
+
+    void CheckpointScheduler::Stop() {
+        if (!impl_->worker.joinable()) {
+            return;
+        }
+        {
+            std::lock_guard< std::mutex > lock(impl_->mutex);
+            impl_->stop = true;
+            impl_->wakeCondition.notify_all();
+            impl_->checkpointCondition.notify_all();
+        }
+        impl_->worker.join();
+        (void)sqlite3_close(impl_->db);
+        impl_->db = nullptr;
+    }
+
+    void CheckpointScheduler::OnCommit(size_t walFrames) {
+        std::unique_lock< std::mutex > lock(impl_->mutex);
+        const auto commitCount = ++impl_->commitCount;
+        impl_->walFrames = walFrames;
+        if (walFrames >= impl_->options.frameThreshold) {
+            impl_->wakeCondition.notify_all();
+        }
+        if (
+            (impl_->options.walSizeLimit == 0)
+            || (walFrames * impl_->frameSize <= impl_->options.walSizeLimit)
+            || impl_->stop
+        ) {
+            return;
+        }
+        ++impl_->backPressureWaiters;
+        impl_->wakeCondition.notify_all();
+        const auto start = std::chrono::steady_clock::now();
+        (void)impl_->checkpointCondition.wait_for(
+            lock,
+            impl_->options.maxBackPressureWait,
+            [this, commitCount]{
+                return (
+                    impl_->stop
+                    || (impl_->completedCommitCount >= commitCount)
+                );
+            }
+        );
+        --impl_->backPressureWaiters;
+        ++impl_->statistics.backPressureWaits;
+        impl_->statistics.backPressureDuration += std::chrono::duration_cast< std::chrono::microseconds >(
+            std::chrono::steady_clock::now() - start
+        );
+    }
+
+    SQLiteDatabase::CheckpointStatistics CheckpointScheduler::GetStatistics() const {
+        std::lock_guard< std::mutex > lock(impl_->mutex);
+        return impl_->statistics;
+    }
+
+}
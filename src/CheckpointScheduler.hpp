@@ -0,0 +1,101 @@
+#pragma once
+
+/**
+ * @file CheckpointScheduler.hpp
+ *
+ * This module declares the DatabaseAbstractions::CheckpointScheduler class.
+ */
+
+#include <memory>
+#include <SQLiteAbstractions/SQLiteDatabase.hpp>
+#include <stddef.h>
+#include <string>
+
+namespace DatabaseAbstractions {
+
+    /**
+     * This runs a background thread which does checkpoints of a database
+     * in write-ahead log mode, using its own connection to the database,
+     * so that commits don't have to do them.  It also holds back commits
+     * when the write-ahead log grows too large.
+     */
+    class CheckpointScheduler {
+        // Lifecycle
+    public:
+        ~CheckpointScheduler() noexcept;
+        CheckpointScheduler(const CheckpointScheduler&) = delete;
+        CheckpointScheduler(CheckpointScheduler&&) = delete;
+        CheckpointScheduler& operator=(const CheckpointScheduler&) = delete;
+        CheckpointScheduler& operator=(CheckpointScheduler&&) = delete;
+
+        // Methods
+    public:
+        /**
+         * This is the instance constructor.
+         */
+        CheckpointScheduler();
+
+        /**
+         * Open a connection to the database and start the background
+         * thread which does checkpoints.
+         *
+         * @param[in] filePath
+         *     This is the path to the database file.
+         *
+         * @param[in] options
+         *     These control how the checkpoint scheduler operates.
+         *
+         * @param[in] pageSize
+         *     This is the size of each page of the database, in bytes.
+         *
+         * @return
+         *     An indication of whether or not the checkpoint scheduler
+         *     was started successfully is returned.
+         */
+        bool Start(
+            const std::string& filePath,
+            const SQLiteDatabase::CheckpointOptions& options,
+            size_t pageSize
+        );
+
+        /**
+         * Stop the background thread and close its connection
+         * to the database.
+         */
+        void Stop();
+
+        /**
+         * This should be called whenever a transaction is committed to
+         * the database.  It wakes up the background thread if a checkpoint
+         * is due, and waits for the checkpoint to be done if the
+         * write-ahead log is too large.
+         *
+         * @param[in] walFrames
+         *     This is the number of frames in the write-ahead log.
+         */
+        void OnCommit(size_t walFrames);
+
+        /**
+         * Return statistics about checkpoints done.
+         *
+         * @return
+         *     Statistics about checkpoints done are returned.
+         */
+        SQLiteDatabase::CheckpointStatistics GetStatistics() const;
+
+        // Properties
+    private:
+        /**
+         * This is the type of structure that contains the private
+         * properties of the instance.  It is defined in the implementation
+         * and declared here to ensure that it is scoped inside the class.
+         */
+        struct Impl;
+
+        /**
+         * This contains the private properties of the instance.
+         */
+        std::unique_ptr< Impl > impl_;
+    };
+
+}
@@ -0,0 +1,458 @@
+/**
+ * @file PageCacheWarmer.cpp
+ *
+ * This module contains the implementation of the
+ * DatabaseAbstractions::PageCacheWarmer class.
+ */
+
+#include "PageCacheWarmer.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <sqlite3.h>
+#include <thread>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif /* __linux__ */
+
+namespace {
+
+    /**
+     * This is the number of virtual machine instructions SQLite executes
+     * between checks of whether or not warm-up should stop.  Scans step
+     * through rows one at a time, taking a few instructions per row, so
+     * this bounds how far past the byte budget warm-up can read.
+     */
+    constexpr int PROGRESS_CHECK_INTERVAL = 100;
+
+    /**
+     * This is how long a write on the main connection waits between
+     * attempts to get past the lock held by warm-up.
+     */
+    constexpr auto BUSY_RETRY_DELAY = std::chrono::milliseconds(1);
+
+    /**
+     * This is the most times a write on the main connection retries
+     * while the database is locked by warm-up, before giving up and
+     * reporting that the database is locked.
+     */
+    constexpr int BUSY_RETRY_LIMIT = 1000;
+
+    /**
+     * This is how long warm-up pauses, holding no lock, after giving
+     * way to a write on the main connection.
+     */
+    constexpr auto YIELD_DELAY = std::chrono::milliseconds(10);
+
+    /**
+     * This is the longest time, in milliseconds, warm-up waits for a
+     * write on another connection to finish before skipping the table
+     * or index it was about to read.
+     */
+    constexpr int WARM_UP_BUSY_TIMEOUT = 100;
+
+    /**
+     * Return the given identifier, quoted for use in an SQL statement.
+     *
+     * @param[in] identifier
+     *     This is the identifier to quote.
+     *
+     * @return
+     *     The quoted identifier is returned.
+     */
+    std::string QuoteIdentifier(const std::string& identifier) {
+        std::string quoted("\"");
+        for (auto c: identifier) {
+            if (c == '"') {
+                quoted.push_back('"');
+            }
+            quoted.push_back(c);
+        }
+        quoted.push_back('"');
+        return quoted;
+    }
+
+    /**
+     * Execute the given SQL statement, which produces a single column
+     * of text, and return the text from all rows.
+     *
+     * @param[in] db
+     *     This is the database connection to use.
+     *
+     * @param[in] statement
+     *     This is the SQL statement to execute.
+     *
+     * @param[in] parameter
+     *     This is the text to bind to the first parameter of the
+     *     statement, if not empty.
+     *
+     * @return
+     *     The text from all rows produced by the statement is returned.
+     */
+    std::vector< std::string > QueryNames(
+        sqlite3* db,
+        const char* statement,
+        const std::string& parameter = ""
+    ) {
+        std::vector< std::string > names;
+        sqlite3_stmt* statementRaw;
+        if (sqlite3_prepare_v2(db, statement, -1, &statementRaw, NULL) != SQLITE_OK) {
+            return names;
+        }
+        if (!parameter.empty()) {
+            (void)sqlite3_bind_text(
+                statementRaw,
+                1,
+                parameter.c_str(),
+                (int)parameter.length(),
+                SQLITE_TRANSIENT
+            );
+        }
+        while (sqlite3_step(statementRaw) == SQLITE_ROW) {
+            const auto name = (const char*)sqlite3_column_text(statementRaw, 0);
+            if (name != nullptr) {
+                names.push_back(name);
+            }
+        }
+        (void)sqlite3_finalize(statementRaw);
+        return names;
+    }
+
+}
+
+namespace DatabaseAbstractions {
+
+    /**
+     * This contains the private properties of a PageCacheWarmer instance.
+     */
+    struct PageCacheWarmer::Impl {
+        // Properties
+
+        /**
+         * This is the path to the database file.
+         */
+        std::string filePath;
+
+        /**
+         * These are the names of the tables to warm up, in order
+         * of priority.
+         */
+        std::vector< std::string > tables;
+
+        /**
+         * This is the maximum number of bytes to read.
+         */
+        size_t byteBudget = 0;
+
+        /**
+         * This is the size of each page of the database, in bytes.
+         */
+        size_t pageSize = 0;
+
+        /**
+         * This is the background thread which warms up the cache.
+         */
+        std::thread worker;
+
+        /**
+         * This indicates whether or not the background thread
+         * should stop.
+         */
+        std::atomic< bool > stop{false};
+
+        /**
+         * This is the main connection to the database, on which the
+         * busy handler is installed while warm-up may be running.
+         */
+        sqlite3* mainDb = nullptr;
+
+        /**
+         * This indicates whether or not the background thread is
+         * warming up the cache, and so may hold locks on the database.
+         */
+        std::atomic< bool > running{false};
+
+        /**
+         * This indicates whether or not a write on the main connection
+         * is waiting for warm-up to release its lock on the database.
+         */
+        std::atomic< bool > writerWaiting{false};
+
+        /**
+         * This is used to synchronize access to the properties below.
+         */
+        mutable std::mutex mutex;
+
+        /**
+         * This is the connection to the database used to warm up
+         * the cache, while the background thread is running.
+         */
+        sqlite3* db = nullptr;
+
+        /**
+         * This holds statistics about the last warm-up.
+         */
+        SQLiteDatabase::WarmUpStatistics statistics;
+
+        // Methods
+
+        /**
+         * Return the number of bytes read from the database file
+         * so far by the connection used to warm up the cache.
+         *
+         * @return
+         *     The number of bytes read so far is returned.
+         */
+        size_t GetBytesRead() {
+            int current = 0;
+            int highwater = 0;
+            (void)sqlite3_db_status(db, SQLITE_DBSTATUS_CACHE_MISS, &current, &highwater, 0);
+            return (size_t)current * pageSize;
+        }
+
+        /**
+         * This is the function called periodically by SQLite while
+         * a warm-up query is running.
+         *
+         * @param[in] context
+         *     This points to the Impl of the warmer.
+         *
+         * @return
+         *     Nonzero is returned if the query should be interrupted.
+         */
+        static int OnProgress(void* context) {
+            const auto impl = (Impl*)context;
+            return (
+                impl->stop
+                || impl->writerWaiting
+                || (impl->GetBytesRead() >= impl->byteBudget)
+            ) ? 1 : 0;
+        }
+
+        /**
+         * This is the function called by SQLite when the main connection
+         * finds the database locked.  In rollback journal mode, the
+         * shared lock held by a warm-up scan keeps writes from being
+         * committed, so this has warm-up give way and retries.
+         *
+         * @param[in] context
+         *     This points to the Impl of the warmer.
+         *
+         * @param[in] attempts
+         *     This is the number of times the busy handler has already
+         *     been called for the same locking event.
+         *
+         * @return
+         *     Nonzero is returned if SQLite should try again to get
+         *     the lock it needs.
+         */
+        static int OnBusy(void* context, int attempts) {
+            const auto impl = (Impl*)context;
+            if (
+                !impl->running
+                || (attempts >= BUSY_RETRY_LIMIT)
+            ) {
+                return 0;
+            }
+            impl->writerWaiting = true;
+            std::this_thread::sleep_for(BUSY_RETRY_DELAY);
+            return 1;
+        }
+
+        /**
+         * Read all pages of the table or index scanned by the given
+         * SQL statement, or as many as the byte budget allows.
+         *
+         * @param[in] statement
+         *     This is the SQL statement which scans the rows of the
+         *     table or index.  It must not be a plain `count(*)`,
+         *     which SQLite runs as a single instruction, leaving no
+         *     chance to stop once the byte budget is used up.
+         *
+         * @return
+         *     An indication of whether or not warm-up should
+         *     continue is returned.
+         */
+        bool Warm(const std::string& statement) {
+            const auto result = sqlite3_exec(db, statement.c_str(), NULL, NULL, NULL);
+            const bool gaveWay = writerWaiting;
+            if (gaveWay) {
+                std::this_thread::sleep_for(YIELD_DELAY);
+                writerWaiting = false;
+            }
+            std::lock_guard< std::mutex > lock(mutex);
+            statistics.bytesWarmed = GetBytesRead();
+            if (
+                (result == SQLITE_OK)
+                || (
+                    (result == SQLITE_INTERRUPT)
+                    && !gaveWay
+                )
+            ) {
+                ++statistics.objectsWarmed;
+            }
+            return (
+                !stop
+                && (statistics.bytesWarmed < byteBudget)
+            );
+        }
+
+        /**
+         * Ask the operating system to start reading the beginning of
+         * the database file into its cache, up to the byte budget.
+         * This is used when there is no information about which
+         * tables are most likely to be needed.
+         */
+        void AdviseWillNeed() {
+#ifdef __linux__
+            const auto fd = open(filePath.c_str(), O_RDONLY);
+            if (fd >= 0) {
+                (void)posix_fadvise(fd, 0, (off_t)byteBudget, POSIX_FADV_WILLNEED);
+                (void)close(fd);
+            }
+#endif /* __linux__ */
+        }
+
+        /**
+         * This is the body of the background thread.
+         */
+        void Worker() {
+            const auto start = std::chrono::steady_clock::now();
+            sqlite3* dbRaw;
+            if (
+                sqlite3_open_v2(
+                    filePath.c_str(),
+                    &dbRaw,
+                    SQLITE_OPEN_READONLY,
+                    NULL
+                ) != SQLITE_OK
+            ) {
+                (void)sqlite3_close(dbRaw);
+                std::lock_guard< std::mutex > lock(mutex);
+                running = false;
+                statistics.finished = true;
+                return;
+            }
+            {
+                std::lock_guard< std::mutex > lock(mutex);
+                db = dbRaw;
+            }
+            sqlite3_stmt* pageSizeStatement;
+            if (sqlite3_prepare_v2(db, "PRAGMA page_size", -1, &pageSizeStatement, NULL) == SQLITE_OK) {
+                if (sqlite3_step(pageSizeStatement) == SQLITE_ROW) {
+                    pageSize = (size_t)sqlite3_column_int64(pageSizeStatement, 0);
+                }
+                (void)sqlite3_finalize(pageSizeStatement);
+            }
+            (void)sqlite3_busy_timeout(db, WARM_UP_BUSY_TIMEOUT);
+            sqlite3_progress_handler(db, PROGRESS_CHECK_INTERVAL, OnProgress, this);
+            auto tablesToWarm = tables;
+            if (tablesToWarm.empty()) {
+                AdviseWillNeed();
+                tablesToWarm = QueryNames(
+                    db,
+                    "SELECT name FROM sqlite_master"
+                    " WHERE type = 'table' AND name NOT LIKE 'sqlite_%'"
+                    " ORDER BY rootpage"
+                );
+            }
+            bool keepGoing = true;
+            for (const auto& table: tablesToWarm) {
+                keepGoing = Warm(
+                    "SELECT 1 FROM " + QuoteIdentifier(table) + " NOT INDEXED"
+                );
+                if (!keepGoing) {
+                    break;
+                }
+                const auto indexes = QueryNames(
+                    db,
+                    "SELECT name FROM sqlite_master"
+                    " WHERE type = 'index' AND tbl_name = ?",
+                    table
+                );
+                for (const auto& index: indexes) {
+                    keepGoing = Warm(
+                        "SELECT 1 FROM " + QuoteIdentifier(table)
+                        + " INDEXED BY " + QuoteIdentifier(index)
+                    );
+                    if (!keepGoing) {
+                        break;
+                    }
+                }
+                if (!keepGoing) {
+                    break;
+                }
+            }
+            std::lock_guard< std::mutex > lock(mutex);
+            (void)sqlite3_close(db);
+            db = nullptr;
+            running = false;
+            statistics.duration = std::chrono::duration_cast< std::chrono::microseconds >(
+                std::chrono::steady_clock::now() - start
+            );
+            statistics.finished = true;
+        }
+    };
+
+    PageCacheWarmer::~PageCacheWarmer() noexcept {
+        Stop();
+    }
+
+    PageCacheWarmer::PageCacheWarmer()
+        : impl_(new Impl())
+    {
+    }
+
+    void PageCacheWarmer::Start(
+        const std::string& filePath,
+        const std::vector< std::string >& tables,
+        size_t byteBudget,
+        sqlite3* mainDb
+    ) {
+        Stop();
+        impl_->filePath = filePath;
+        impl_->tables = tables;
+        impl_->byteBudget = byteBudget;
+        impl_->pageSize = 0;
+        impl_->stop = false;
+        impl_->writerWaiting = false;
+        impl_->running = true;
+        impl_->statistics = SQLiteDatabase::WarmUpStatistics();
+        impl_->mainDb = mainDb;
+        (void)sqlite3_busy_handler(mainDb, Impl::OnBusy, impl_.get());
+        impl_->worker = std::thread(&Impl::Worker, impl_.get());
+    }
+
+    void PageCacheWarmer::Stop() {
+        if (impl_->mainDb != nullptr) {
+            (void)sqlite3_busy_handler(impl_->mainDb, NULL, NULL);
+            impl_->mainDb = nullptr;
+        }
+        if (!impl_->worker.joinable()) {
+            return;
+        }
+        impl_->stop = true;
+        {
+            std::lock_guard< std::mutex > lock(impl_->mutex);
+            if (impl_->db != nullptr) {
+                sqlite3_interrupt(impl_->db);
+            }
+        }
+        impl_->worker.join();
+    }
+
+    void PageCacheWarmer::Wait() {
+        if (impl_->worker.joinable()) {
+            impl_->worker.join();
+        }
+    }
+
+    SQLiteDatabase::WarmUpStatistics PageCacheWarmer::GetStatistics() const {
+        std::lock_guard< std::mutex > lock(impl_->mutex);
+        return impl_->statistics;
+    }
+
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+/**
+ * @file PageCacheWarmer.hpp
+ *
+ * This module declares the DatabaseAbstractions::PageCacheWarmer class.
+ */
+
+#include <memory>
+#include <sqlite3.h>
+#include <SQLiteAbstractions/SQLiteDatabase.hpp>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+namespace DatabaseAbstractions {
+
+    /**
+     * This runs a background thread which reads the pages of selected
+     * tables and their indexes, using its own connection to the database,
+     * so that they're already cached by the operating system by the time
+     * queries need them.
+     */
+    class PageCacheWarmer {
+        // Lifecycle
+    public:
+        ~PageCacheWarmer() noexcept;
+        PageCacheWarmer(const PageCacheWarmer&) = delete;
+        PageCacheWarmer(PageCacheWarmer&&) = delete;
+        PageCacheWarmer& operator=(const PageCacheWarmer&) = delete;
+        PageCacheWarmer& operator=(PageCacheWarmer&&) = delete;
+
+        // Methods
+    public:
+        /**
+         * This is the instance constructor.
+         */
+        PageCacheWarmer();
+
+        /**
+         * Start the background thread which warms up the cache.
+         * Any warm-up already in progress is stopped first.
+         *
+         * @param[in] filePath
+         *     This is the path to the database file.
+         *
+         * @param[in] tables
+         *     These are the names of the tables to warm up, in order
+         *     of priority.  If empty, all tables are warmed up, in the
+         *     order in which they appear in the schema.
+         *
+         * @param[in] byteBudget
+         *     This is the maximum number of bytes to read.
+         *
+         * @param[in] mainDb
+         *     This is the main connection to the database.  Until warm-up
+         *     is stopped, a busy handler is installed on it, so that
+         *     writes which find the database locked by warm-up make
+         *     warm-up give way, and wait for it to do so.
+         */
+        void Start(
+            const std::string& filePath,
+            const std::vector< std::string >& tables,
+            size_t byteBudget,
+            sqlite3* mainDb
+        );
+
+        /**
+         * Stop the background thread, interrupting any warm-up
+         * in progress, and remove the busy handler from the main
+         * connection to the database.
+         */
+        void Stop();
+
+        /**
+         * Wait for the background thread to finish warming up the cache.
+         */
+        void Wait();
+
+        /**
+         * Return statistics about the last warm-up.
+         *
+         * @return
+         *     Statistics about the last warm-up are returned.
+         */
+        SQLiteDatabase::WarmUpStatistics GetStatistics() const;
+
+        // Properties
+    private:
+        /**
+         * This is the type of structure that contains the private
+         * properties of the instance.  It is defined in the implementation
+         * and declared here to ensure that it is scoped inside the class.
+         */
+        struct Impl;
+
+        /**
+         * This contains the private properties of the instance.
+         */
+        std::unique_ptr< Impl > impl_;
+    };
+
+}
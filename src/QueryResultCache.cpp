@@ -0,0 +1,324 @@
+/**
+ * @file QueryResultCache.cpp
+ *
+ * This module contains the implementation of the
+ * DatabaseAbstractions::QueryResultCache class.
+ */
+
+#include "QueryResultCache.hpp"
+
+#include <algorithm>
+#include <ctype.h>
+
+namespace {
+
+    /**
+     * This is the estimated number of bytes of memory used to hold
+     * a column value, not counting the value's contents.
+     */
+    constexpr size_t VALUE_OVERHEAD = 64;
+
+    /**
+     * This is the estimated number of bytes of memory used to hold
+     * a cache entry, not counting its results.
+     */
+    constexpr size_t ENTRY_OVERHEAD = 256;
+
+    /**
+     * Return the given table name, normalized so that it matches the same
+     * table name given with different letter case.
+     *
+     * @param[in] table
+     *     This is the table name to normalize.
+     *
+     * @return
+     *     The normalized table name is returned.
+     */
+    std::string NormalizeTableName(const std::string& table) {
+        std::string normalized(table);
+        std::transform(
+            normalized.begin(),
+            normalized.end(),
+            normalized.begin(),
+            [](char c){ return (char)tolower((unsigned char)c); }
+        );
+        return normalized;
+    }
+
+    /**
+     * This holds the results of a query in the cache, along with
+     * information used to find and discard them later.
+     */
+    struct Entry {
+        std::shared_ptr< const DatabaseAbstractions::QueryResultCache::Rows > rows;
+        std::set< std::string > tables;
+        std::list< std::string >::iterator lruPosition;
+        size_t bytes = 0;
+    };
+
+}
+
+namespace DatabaseAbstractions {
+
+    QueryResultCache::Rows::~Rows() noexcept {
+        for (auto& row: rows) {
+            for (auto value: row) {
+                sqlite3_value_free(value);
+            }
+        }
+    }
+
+    void QueryResultCache::Rows::AddRow(sqlite3_stmt* statement) {
+        const auto numColumns = sqlite3_column_count(statement);
+        Row row;
+        row.reserve((size_t)numColumns);
+        for (int i = 0; i < numColumns; ++i) {
+            const auto value = sqlite3_value_dup(sqlite3_column_value(statement, i));
+            bytes += VALUE_OVERHEAD;
+            if (value != nullptr) {
+                bytes += (size_t)sqlite3_value_bytes(value);
+            }
+            row.push_back(value);
+        }
+        rows.push_back(std::move(row));
+    }
+
+    /**
+     * This contains the private properties of a QueryResultCache instance.
+     */
+    struct QueryResultCache::Impl {
+        // Properties
+
+        /**
+         * This is the maximum number of bytes of memory
+         * to use for holding cached results.
+         */
+        size_t memoryBudget = 0;
+
+        /**
+         * This is the database connection whose query results are cached.
+         */
+        std::shared_ptr< sqlite3 > db;
+
+        /**
+         * This is used to check whether or not the database has been
+         * changed by another connection.
+         */
+        sqlite3_stmt* dataVersionStatement = nullptr;
+
+        /**
+         * This is the last value reported by the data version pragma.
+         */
+        sqlite3_int64 dataVersion = 0;
+
+        /**
+         * This counts the number of times the cache has been invalidated.
+         */
+        uint64_t generation = 0;
+
+        /**
+         * These are the cached results, keyed by query and parameter values.
+         */
+        std::unordered_map< std::string, Entry > entries;
+
+        /**
+         * This maps each table name to the keys of the cached results
+         * read from the table.
+         */
+        std::unordered_map< std::string, std::set< std::string > > keysByTable;
+
+        /**
+         * These are the keys of cached results, in order from least
+         * recently used to most recently used.
+         */
+        std::list< std::string > lru;
+
+        /**
+         * This holds statistics about the use of the cache.
+         */
+        SQLiteDatabase::QueryCacheStatistics statistics;
+
+        // Methods
+
+        /**
+         * Release the statement used to check the data version.
+         */
+        void DropDataVersionStatement() {
+            if (dataVersionStatement != nullptr) {
+                (void)sqlite3_finalize(dataVersionStatement);
+                dataVersionStatement = nullptr;
+            }
+        }
+
+        /**
+         * Return the current data version of the database.
+         *
+         * @return
+         *     The current data version of the database is returned.
+         */
+        sqlite3_int64 ReadDataVersion() {
+            sqlite3_int64 version = dataVersion;
+            if (dataVersionStatement == nullptr) {
+                return version;
+            }
+            if (sqlite3_step(dataVersionStatement) == SQLITE_ROW) {
+                version = sqlite3_column_int64(dataVersionStatement, 0);
+            }
+            (void)sqlite3_reset(dataVersionStatement);
+            return version;
+        }
+
+        /**
+         * Discard the cached results with the given key.
+         *
+         * @param[in] key
+         *     This identifies the cached results to discard.
+         */
+        void Remove(const std::string& key) {
+            const auto entry = entries.find(key);
+            if (entry == entries.end()) {
+                return;
+            }
+            for (const auto& table: entry->second.tables) {
+                const auto keys = keysByTable.find(table);
+                if (keys != keysByTable.end()) {
+                    (void)keys->second.erase(key);
+                    if (keys->second.empty()) {
+                        (void)keysByTable.erase(keys);
+                    }
+                }
+            }
+            lru.erase(entry->second.lruPosition);
+            statistics.bytes -= entry->second.bytes;
+            --statistics.entries;
+            (void)entries.erase(entry);
+        }
+
+        /**
+         * Discard all cached results.
+         */
+        void Clear() {
+            entries.clear();
+            keysByTable.clear();
+            lru.clear();
+            statistics.bytes = 0;
+            statistics.entries = 0;
+            ++generation;
+        }
+    };
+
+    QueryResultCache::~QueryResultCache() noexcept {
+        impl_->DropDataVersionStatement();
+    }
+
+    QueryResultCache::QueryResultCache(size_t memoryBudget)
+        : impl_(new Impl())
+    {
+        impl_->memoryBudget = memoryBudget;
+    }
+
+    void QueryResultCache::SetConnection(const std::shared_ptr< sqlite3 >& db) {
+        impl_->DropDataVersionStatement();
+        impl_->db = db;
+        if (db != nullptr) {
+            if (
+                sqlite3_prepare_v2(
+                    db.get(),
+                    "PRAGMA data_version",
+                    -1,
+                    &impl_->dataVersionStatement,
+                    NULL
+                ) != SQLITE_OK
+            ) {
+                impl_->dataVersionStatement = nullptr;
+            }
+            impl_->dataVersion = impl_->ReadDataVersion();
+        }
+        impl_->Clear();
+    }
+
+    size_t QueryResultCache::GetMemoryBudget() const {
+        return impl_->memoryBudget;
+    }
+
+    uint64_t QueryResultCache::GetGeneration() const {
+        return impl_->generation;
+    }
+
+    auto QueryResultCache::Lookup(const std::string& key) -> std::shared_ptr< const Rows > {
+        const auto dataVersion = impl_->ReadDataVersion();
+        if (dataVersion != impl_->dataVersion) {
+            impl_->dataVersion = dataVersion;
+            InvalidateAll();
+        }
+        const auto entry = impl_->entries.find(key);
+        if (entry == impl_->entries.end()) {
+            ++impl_->statistics.misses;
+            return nullptr;
+        }
+        ++impl_->statistics.hits;
+        impl_->lru.splice(impl_->lru.end(), impl_->lru, entry->second.lruPosition);
+        return entry->second.rows;
+    }
+
+    void QueryResultCache::Insert(
+        const std::string& key,
+        const std::shared_ptr< const Rows >& rows,
+        const std::set< std::string >& tables,
+        uint64_t generation
+    ) {
+        if (generation != impl_->generation) {
+            return;
+        }
+        const auto bytes = rows->bytes + key.length() + ENTRY_OVERHEAD;
+        if (bytes > impl_->memoryBudget) {
+            return;
+        }
+        impl_->Remove(key);
+        while (
+            !impl_->lru.empty()
+            && (impl_->statistics.bytes + bytes > impl_->memoryBudget)
+        ) {
+            impl_->Remove(impl_->lru.front());
+            ++impl_->statistics.evictions;
+        }
+        Entry entry;
+        entry.rows = rows;
+        entry.bytes = bytes;
+        entry.lruPosition = impl_->lru.insert(impl_->lru.end(), key);
+        for (const auto& table: tables) {
+            const auto normalizedTable = NormalizeTableName(table);
+            (void)entry.tables.insert(normalizedTable);
+            (void)impl_->keysByTable[normalizedTable].insert(key);
+        }
+        impl_->entries[key] = std::move(entry);
+        impl_->statistics.bytes += bytes;
+        ++impl_->statistics.entries;
+        ++impl_->statistics.insertions;
+    }
+
+    void QueryResultCache::InvalidateTable(const std::string& table) {
+        ++impl_->generation;
+        const auto keys = impl_->keysByTable.find(NormalizeTableName(table));
+        if (keys == impl_->keysByTable.end()) {
+            return;
+        }
+        ++impl_->statistics.invalidations;
+        const auto keysToRemove = keys->second;
+        for (const auto& key: keysToRemove) {
+            impl_->Remove(key);
+        }
+    }
+
+    void QueryResultCache::InvalidateAll() {
+        if (!impl_->entries.empty()) {
+            ++impl_->statistics.invalidations;
+        }
+        impl_->Clear();
+    }
+
+    SQLiteDatabase::QueryCacheStatistics QueryResultCache::GetStatistics() const {
+        return impl_->statistics;
+    }
+
+}
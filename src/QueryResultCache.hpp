@@ -0,0 +1,201 @@
+#pragma once
+
+/**
+ * @file QueryResultCache.hpp
+ *
+ * This module declares the DatabaseAbstractions::QueryResultCache class.
+ */
+
+#include <list>
+#include <memory>
+#include <set>
+#include <sqlite3.h>
+#include <SQLiteAbstractions/SQLiteDatabase.hpp>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace DatabaseAbstractions {
+
+    /**
+     * This holds the materialized results of read-only queries, keyed by
+     * the text of the query along with the values of its bound parameters,
+     * so that repeated queries can be answered without stepping through
+     * the query again.  Results are discarded whenever any of the tables
+     * they were read from is changed.
+     */
+    class QueryResultCache {
+        // Types
+    public:
+        /**
+         * This holds one row of results, as copies of the column values.
+         */
+        using Row = std::vector< sqlite3_value* >;
+
+        /**
+         * This holds all the rows of results of a query.
+         */
+        struct Rows {
+            // Properties
+
+            /**
+             * These are the rows of results.
+             */
+            std::vector< Row > rows;
+
+            /**
+             * This is the estimated number of bytes of memory used
+             * to hold the results.
+             */
+            size_t bytes = 0;
+
+            // Lifecycle
+
+            ~Rows() noexcept;
+            Rows(const Rows&) = delete;
+            Rows(Rows&&) = delete;
+            Rows& operator=(const Rows&) = delete;
+            Rows& operator=(Rows&&) = delete;
+
+            // Methods
+
+            Rows() = default;
+
+            /**
+             * Copy the column values of the current result row
+             * of the given statement and add them as a new row.
+             *
+             * @param[in] statement
+             *     This is the statement whose current row is copied.
+             */
+            void AddRow(sqlite3_stmt* statement);
+        };
+
+        // Lifecycle
+    public:
+        ~QueryResultCache() noexcept;
+        QueryResultCache(const QueryResultCache&) = delete;
+        QueryResultCache(QueryResultCache&&) = delete;
+        QueryResultCache& operator=(const QueryResultCache&) = delete;
+        QueryResultCache& operator=(QueryResultCache&&) = delete;
+
+        // Methods
+    public:
+        /**
+         * This is the instance constructor.
+         *
+         * @param[in] memoryBudget
+         *     This is the maximum number of bytes of memory
+         *     to use for holding cached results.
+         */
+        explicit QueryResultCache(size_t memoryBudget);
+
+        /**
+         * Set the database connection whose query results are cached.
+         * This discards all cached results.
+         *
+         * @param[in] db
+         *     This is the database connection whose query results
+         *     are cached, or nullptr if the connection is being closed.
+         */
+        void SetConnection(const std::shared_ptr< sqlite3 >& db);
+
+        /**
+         * Return the maximum number of bytes of memory to use for
+         * holding cached results.
+         *
+         * @return
+         *     The maximum number of bytes of memory to use for
+         *     holding cached results is returned.
+         */
+        size_t GetMemoryBudget() const;
+
+        /**
+         * Return the number of times the cache has been invalidated
+         * so far.  This is used to detect whether or not results
+         * being recorded may have been made stale by a change
+         * before they could be added to the cache.
+         *
+         * @return
+         *     The number of times the cache has been invalidated
+         *     so far is returned.
+         */
+        uint64_t GetGeneration() const;
+
+        /**
+         * Look up the cached results of a query.
+         *
+         * @param[in] key
+         *     This identifies the query and its parameter values.
+         *
+         * @return
+         *     The cached results of the query are returned.
+         *
+         * @retval nullptr
+         *     This is returned if the results are not cached.
+         */
+        std::shared_ptr< const Rows > Lookup(const std::string& key);
+
+        /**
+         * Add the results of a query to the cache.
+         *
+         * @param[in] key
+         *     This identifies the query and its parameter values.
+         *
+         * @param[in] rows
+         *     These are the results of the query.
+         *
+         * @param[in] tables
+         *     These are the names of the tables read by the query.
+         *
+         * @param[in] generation
+         *     This is the value returned by GetGeneration before
+         *     the query results were recorded.  If the cache has been
+         *     invalidated since then, the results are not added.
+         */
+        void Insert(
+            const std::string& key,
+            const std::shared_ptr< const Rows >& rows,
+            const std::set< std::string >& tables,
+            uint64_t generation
+        );
+
+        /**
+         * Discard all cached results read from the given table.
+         *
+         * @param[in] table
+         *     This is the name of the table which changed.
+         */
+        void InvalidateTable(const std::string& table);
+
+        /**
+         * Discard all cached results.
+         */
+        void InvalidateAll();
+
+        /**
+         * Return statistics about the use of the cache.
+         *
+         * @return
+         *     Statistics about the use of the cache are returned.
+         */
+        SQLiteDatabase::QueryCacheStatistics GetStatistics() const;
+
+        // Properties
+    private:
+        /**
+         * This is the type of structure that contains the private
+         * properties of the instance.  It is defined in the implementation
+         * and declared here to ensure that it is scoped inside the class.
+         */
+        struct Impl;
+
+        /**
+         * This contains the private properties of the instance.
+         */
+        std::unique_ptr< Impl > impl_;
+    };
+
+}
@@ -5,12 +5,26 @@
  * SQLiteAbstractions::SQLiteDatabase class.
  */
 
+#include "CheckpointScheduler.hpp"
+#include "PageCacheWarmer.hpp"
+#include "QueryResultCache.hpp"
+#include "UserFunctions.hpp"
+#include "UringVfs.hpp"
+#include "VectorFunctions.hpp"
+#include "VirtualTables.hpp"
+
+#include <algorithm>
+#include <atomic>
 #include <functional>
+#include <map>
+#include <set>
 #include <sqlite3.h>
 #include <SQLiteAbstractions/SQLiteDatabase.hpp>
 #include <memory>
+#include <mutex>
 #include <sstream>
 #include <string>
+#include <string.h>
 #include <StringExtensions/StringExtensions.hpp>
 #include <SystemAbstractions/File.hpp>
 #include <unordered_set>
@@ -25,6 +39,1329 @@ namespace {
         return sqlite3_errmsg(db.get());
     }
 
+    /**
+     * This is the number of frames in the write-ahead log at which SQLite
+     * does a checkpoint automatically, unless told otherwise.
+     */
+    constexpr int DEFAULT_WAL_AUTOCHECKPOINT = 1000;
+
+    /**
+     * This is the most connections used for read views which are kept
+     * open while not in use, to be reused by later read views.
+     */
+    constexpr size_t MAX_IDLE_READERS = 4;
+
+    /**
+     * This is the percentage of the hard heap limit at which memory
+     * pressure is considered to be at the hard level.
+     */
+    constexpr size_t HARD_PRESSURE_PERCENT = 90;
+
+    /**
+     * These are the names of built-in SQL functions which may return
+     * different results each time they're called with the same arguments.
+     */
+    const std::unordered_set< std::string > NONDETERMINISTIC_FUNCTIONS{
+        "changes",
+        "current_date",
+        "current_time",
+        "current_timestamp",
+        "date",
+        "datetime",
+        "julianday",
+        "last_insert_rowid",
+        "random",
+        "randomblob",
+        "strftime",
+        "time",
+        "total_changes",
+        "unixepoch",
+    };
+
+    /**
+     * This holds information about what a statement does to the database,
+     * as reported by SQLite while the statement is being prepared.
+     */
+    struct StatementAccess {
+        /**
+         * These are the names of the tables read by the statement.
+         */
+        std::set< std::string > tablesRead;
+
+        /**
+         * These are the names of the tables modified by the statement.
+         */
+        std::set< std::string > tablesWritten;
+
+        /**
+         * This indicates whether or not the statement may change
+         * the database in ways not limited to specific tables,
+         * such as changing the schema or rolling back changes.
+         */
+        bool changesEverything = false;
+
+        /**
+         * This indicates whether or not the statement calls any function
+         * which may return different results each time it's called.
+         */
+        bool nondeterministic = false;
+    };
+
+    /**
+     * This is the function called by SQLite while a statement is being
+     * prepared, for each action the statement will take.  It's used to
+     * gather information about what the statement does to the database.
+     *
+     * @param[in] context
+     *     This points to the StatementAccess in which to gather information.
+     *
+     * @param[in] action
+     *     This is the SQLite code indicating the kind of action.
+     *
+     * @param[in] arg1
+     *     This is the first detail about the action, if any.
+     *
+     * @param[in] arg2
+     *     This is the second detail about the action, if any.
+     *
+     * @param[in] databaseName
+     *     This is the name of the database affected, if any.
+     *
+     * @param[in] triggerOrView
+     *     This is the name of the trigger or view which caused the action,
+     *     if any.
+     *
+     * @return
+     *     The SQLite code indicating whether or not the action
+     *     is allowed is returned.  All actions are allowed.
+     */
+    int OnAuthorize(
+        void* context,
+        int action,
+        const char* arg1,
+        const char* arg2,
+        const char* databaseName,
+        const char* triggerOrView
+    ) {
+        (void)databaseName;
+        (void)triggerOrView;
+        const auto access = (StatementAccess*)context;
+        switch (action) {
+            case SQLITE_READ: {
+                if (arg1 != nullptr) {
+                    (void)access->tablesRead.insert(arg1);
+                }
+            } break;
+
+            case SQLITE_INSERT:
+            case SQLITE_UPDATE:
+            case SQLITE_DELETE: {
+                if (arg1 != nullptr) {
+                    (void)access->tablesWritten.insert(arg1);
+                }
+            } break;
+
+            case SQLITE_FUNCTION: {
+                if (
+                    (arg2 != nullptr)
+                    && (NONDETERMINISTIC_FUNCTIONS.find(arg2) != NONDETERMINISTIC_FUNCTIONS.end())
+                ) {
+                    access->nondeterministic = true;
+                }
+            } break;
+
+            case SQLITE_TRANSACTION:
+            case SQLITE_SAVEPOINT: {
+                if (
+                    (arg1 != nullptr)
+                    && (strcmp(arg1, "ROLLBACK") == 0)
+                ) {
+                    access->changesEverything = true;
+                }
+            } break;
+
+            case SQLITE_SELECT:
+            case SQLITE_RECURSIVE: {
+            } break;
+
+            default: {
+                access->changesEverything = true;
+            } break;
+        }
+        return SQLITE_OK;
+    }
+
+    /**
+     * Discard cached query results which may be made stale by the
+     * given statement having been executed.
+     *
+     * @param[in] cache
+     *     This is the cache of query results.
+     *
+     * @param[in] access
+     *     This holds information about what the statement
+     *     does to the database.
+     *
+     * @param[in] readOnly
+     *     This indicates whether or not SQLite considers the statement
+     *     to leave the database unchanged.
+     */
+    void InvalidateQueryCache(
+        QueryResultCache& cache,
+        const StatementAccess& access,
+        bool readOnly
+    ) {
+        if (
+            access.changesEverything
+            || (
+                !readOnly
+                && access.tablesWritten.empty()
+            )
+        ) {
+            cache.InvalidateAll();
+        } else {
+            for (const auto& table: access.tablesWritten) {
+                cache.InvalidateTable(table);
+            }
+        }
+    }
+
+    /**
+     * Return a string which uniquely represents the given value,
+     * for use in forming a key for the query result cache.
+     *
+     * @param[in] value
+     *     This is the value to represent.
+     *
+     * @return
+     *     A string which uniquely represents the given value is returned.
+     */
+    std::string MakeParameterKey(const Value& value) {
+        switch (value.GetType()) {
+            case Value::Type::Text: {
+                const std::string& valueAsString = value;
+                return "T" + std::to_string(valueAsString.length()) + ":" + valueAsString;
+            }
+
+            case Value::Type::Integer: {
+                return "I" + std::to_string((intmax_t)value) + ";";
+            }
+
+            case Value::Type::Real: {
+                const auto valueAsDouble = (double)value;
+                std::string key("R");
+                key.append((const char*)&valueAsDouble, sizeof(valueAsDouble));
+                return key;
+            }
+
+            case Value::Type::Boolean: {
+                return (bool)value ? "I1;" : "I0;";
+            }
+
+            case Value::Type::Null: {
+                return "N";
+            }
+
+            default: {
+                return "";
+            }
+        }
+    }
+
+#if defined(SQLITE_ENABLE_SESSION) && defined(SQLITE_ENABLE_PREUPDATE_HOOK)
+    using Session = std::shared_ptr< sqlite3_session >;
+
+    /**
+     * This holds the state used by the conflict handler while
+     * a changeset is being applied.
+     */
+    struct ApplyChangesetContext {
+        SQLiteDatabase::ChangesetConflictDelegate conflictDelegate;
+    };
+
+    /**
+     * This is the function called by SQLite whenever a conflict is
+     * encountered while applying a changeset.
+     *
+     * @param[in] context
+     *     This points to the ApplyChangesetContext of the apply operation.
+     *
+     * @param[in] conflictType
+     *     This is the SQLite code indicating the kind of conflict.
+     *
+     * @param[in] iterator
+     *     This refers to the change which caused the conflict.
+     *
+     * @return
+     *     The SQLite code indicating how to resolve the conflict
+     *     is returned.
+     */
+    int OnChangesetConflict(
+        void* context,
+        int conflictType,
+        sqlite3_changeset_iter* iterator
+    ) {
+        const auto applyContext = (ApplyChangesetContext*)context;
+        if (applyContext->conflictDelegate == nullptr) {
+            return SQLITE_CHANGESET_OMIT;
+        }
+        SQLiteDatabase::ChangesetConflict conflict;
+        bool replaceable = false;
+        switch (conflictType) {
+            case SQLITE_CHANGESET_DATA: {
+                conflict.type = SQLiteDatabase::ChangesetConflict::Type::Data;
+                replaceable = true;
+            } break;
+
+            case SQLITE_CHANGESET_NOTFOUND: {
+                conflict.type = SQLiteDatabase::ChangesetConflict::Type::NotFound;
+            } break;
+
+            case SQLITE_CHANGESET_CONFLICT: {
+                conflict.type = SQLiteDatabase::ChangesetConflict::Type::Conflict;
+                replaceable = true;
+            } break;
+
+            case SQLITE_CHANGESET_CONSTRAINT: {
+                conflict.type = SQLiteDatabase::ChangesetConflict::Type::Constraint;
+            } break;
+
+            case SQLITE_CHANGESET_FOREIGN_KEY: {
+                conflict.type = SQLiteDatabase::ChangesetConflict::Type::ForeignKey;
+            } break;
+
+            default: break;
+        }
+        const char* table = nullptr;
+        int numColumns = 0;
+        int operation = 0;
+        if (
+            sqlite3changeset_op(
+                iterator,
+                &table,
+                &numColumns,
+                &operation,
+                NULL
+            ) == SQLITE_OK
+        ) {
+            if (table != nullptr) {
+                conflict.table = table;
+            }
+            switch (operation) {
+                case SQLITE_INSERT: {
+                    conflict.operation = SQLiteDatabase::ChangesetConflict::Operation::Insert;
+                } break;
+
+                case SQLITE_UPDATE: {
+                    conflict.operation = SQLiteDatabase::ChangesetConflict::Operation::Update;
+                } break;
+
+                case SQLITE_DELETE: {
+                    conflict.operation = SQLiteDatabase::ChangesetConflict::Operation::Delete;
+                } break;
+
+                default: break;
+            }
+        }
+        switch (applyContext->conflictDelegate(conflict)) {
+            case SQLiteDatabase::ChangesetConflictResolution::Replace: {
+                return (
+                    replaceable
+                    ? SQLITE_CHANGESET_REPLACE
+                    : SQLITE_CHANGESET_OMIT
+                );
+            }
+
+            case SQLiteDatabase::ChangesetConflictResolution::Abort: {
+                return SQLITE_CHANGESET_ABORT;
+            }
+
+            default: {
+                return SQLITE_CHANGESET_OMIT;
+            }
+        }
+    }
+#endif /* SQLITE_ENABLE_SESSION && SQLITE_ENABLE_PREUPDATE_HOOK */
+
+    /**
+     * This is the number of virtual machine instructions SQLite executes
+     * between checks of whether or not a deadline has passed.
+     */
+    constexpr int DEADLINE_CHECK_INTERVAL = 1000;
+
+    /**
+     * This holds the deadlines which bound how long calls which run
+     * statements may take, and is used to interrupt them, either when
+     * a deadline passes, or when asked to by another thread.
+     */
+    struct Interruption {
+        // Properties
+
+        /**
+         * This is the longest time each call which runs statements may
+         * take, or zero if there is no limit.
+         */
+        std::chrono::milliseconds timeout = std::chrono::milliseconds(0);
+
+        /**
+         * This indicates whether or not there is a deadline by which
+         * all calls which run statements must finish.
+         */
+        bool hasDeadline = false;
+
+        /**
+         * This is the time by which all calls which run statements
+         * must finish, if hasDeadline is set.
+         */
+        std::chrono::steady_clock::time_point deadline;
+
+        /**
+         * This indicates whether or not the call in progress must
+         * finish by a deadline.
+         */
+        bool callHasDeadline = false;
+
+        /**
+         * This is the time by which the call in progress must finish,
+         * if callHasDeadline is set.
+         */
+        std::chrono::steady_clock::time_point callDeadline;
+
+        /**
+         * This indicates whether or not the call in progress was
+         * interrupted because its deadline passed.
+         */
+        bool deadlineExceeded = false;
+
+        /**
+         * This is used to synchronize canceling calls between the thread
+         * running them and any thread canceling them.
+         */
+        std::mutex mutex;
+
+        /**
+         * This indicates whether or not a call which runs
+         * statements is in progress.
+         */
+        bool callInProgress = false;
+
+        /**
+         * This indicates whether or not Cancel was called while no call
+         * was in progress, so that the next call is to be canceled.
+         */
+        bool cancelPending = false;
+
+        /**
+         * This indicates whether or not the call in progress
+         * is to be canceled.
+         */
+        std::atomic< bool > cancelCall{false};
+
+        /**
+         * If not nullptr, this is the Interruption of the database, from
+         * which this one, belonging to a read view, takes its timeout
+         * and deadline, and by which it is canceled.
+         */
+        std::shared_ptr< Interruption > leader;
+
+        /**
+         * These are the Interruptions of read views which take their
+         * timeout and deadline from this one, and are canceled with it.
+         */
+        std::set< Interruption* > followers;
+
+        // Lifecycle
+
+        ~Interruption() noexcept {
+            if (leader != nullptr) {
+                std::lock_guard< std::mutex > lock(leader->mutex);
+                (void)leader->followers.erase(this);
+            }
+        }
+
+        Interruption() = default;
+        Interruption(const Interruption&) = delete;
+        Interruption(Interruption&&) = delete;
+        Interruption& operator=(const Interruption&) = delete;
+        Interruption& operator=(Interruption&&) = delete;
+
+        // Methods
+
+        /**
+         * Take the timeout and deadline from the given Interruption,
+         * and be canceled along with it.
+         *
+         * @param[in] newLeader
+         *     This is the Interruption to follow.
+         */
+        void Follow(std::shared_ptr< Interruption > newLeader) {
+            leader = std::move(newLeader);
+            std::lock_guard< std::mutex > lock(leader->mutex);
+            (void)leader->followers.insert(this);
+        }
+
+        /**
+         * Install the function SQLite calls to check deadlines and
+         * cancellation on the given database connection.
+         *
+         * @param[in] db
+         *     This is the database connection whose calls are interrupted.
+         */
+        void Attach(sqlite3* db) {
+            sqlite3_progress_handler(db, DEADLINE_CHECK_INTERVAL, OnProgress, this);
+        }
+
+        /**
+         * Work out the deadline of a call which is about to run statements,
+         * and mark the call as being in progress, unless the call is to
+         * be canceled before it starts.
+         *
+         * @param[in] callTimeout
+         *     This is the longest time the call may take, if nonzero,
+         *     in place of the timeout set for all calls.
+         *
+         * @return
+         *     An indication of whether or not the call may go ahead is
+         *     returned.  If not, the call is canceled, and must report
+         *     the error given by GetInterruptedError, without calling
+         *     EndCall.
+         */
+        bool BeginCall(
+            std::chrono::milliseconds callTimeout = std::chrono::milliseconds(0)
+        ) {
+            const auto settings = (
+                (leader == nullptr)
+                ? this
+                : leader.get()
+            );
+            {
+                std::lock_guard< std::mutex > lock(settings->mutex);
+                if (callTimeout.count() == 0) {
+                    callTimeout = settings->timeout;
+                }
+                callHasDeadline = settings->hasDeadline;
+                callDeadline = settings->deadline;
+            }
+            if (callTimeout.count() > 0) {
+                const auto timeoutDeadline = std::chrono::steady_clock::now() + callTimeout;
+                if (
+                    !callHasDeadline
+                    || (timeoutDeadline < callDeadline)
+                ) {
+                    callDeadline = timeoutDeadline;
+                }
+                callHasDeadline = true;
+            }
+            deadlineExceeded = false;
+            std::lock_guard< std::mutex > lock(mutex);
+            if (cancelPending) {
+                cancelPending = false;
+                callHasDeadline = false;
+                return false;
+            }
+            if (
+                callHasDeadline
+                && (std::chrono::steady_clock::now() >= callDeadline)
+            ) {
+                deadlineExceeded = true;
+                callHasDeadline = false;
+                return false;
+            }
+            cancelCall = false;
+            callInProgress = true;
+            return true;
+        }
+
+        /**
+         * Mark the call in progress as finished, so that deadlines
+         * and cancellation no longer apply to it.
+         */
+        void EndCall() {
+            std::lock_guard< std::mutex > lock(mutex);
+            callInProgress = false;
+            cancelCall = false;
+            callHasDeadline = false;
+        }
+
+        /**
+         * Cancel the call in progress, or if there isn't one,
+         * the next call, along with those of any followers.
+         */
+        void Cancel() {
+            std::lock_guard< std::mutex > lock(mutex);
+            if (callInProgress) {
+                cancelCall = true;
+            } else {
+                cancelPending = true;
+            }
+            for (const auto follower: followers) {
+                follower->Cancel();
+            }
+        }
+
+        /**
+         * Return the error message to report for a call which
+         * was interrupted.
+         *
+         * @return
+         *     The error message to report for a call which was
+         *     interrupted is returned.
+         */
+        const std::string& GetInterruptedError() const {
+            return (
+                deadlineExceeded
+                ? SQLiteDatabase::DEADLINE_EXCEEDED_ERROR
+                : SQLiteDatabase::CANCELED_ERROR
+            );
+        }
+
+        /**
+         * This is the function called periodically by SQLite while
+         * statements are running.
+         *
+         * @param[in] context
+         *     This points to the Interruption of the database.
+         *
+         * @return
+         *     Nonzero is returned if the statement should be interrupted.
+         */
+        static int OnProgress(void* context) {
+            const auto self = (Interruption*)context;
+            if (self->cancelCall) {
+                return 1;
+            }
+            if (
+                self->callHasDeadline
+                && (std::chrono::steady_clock::now() >= self->callDeadline)
+            ) {
+                self->deadlineExceeded = true;
+                return 1;
+            }
+            return 0;
+        }
+    };
+
+    /**
+     * This measures the memory used by SQLite and the database, and
+     * reports to the application when memory pressure rises.
+     */
+    struct MemoryMonitor {
+        // Properties
+
+        /**
+         * This is used to synchronize access to the monitor.
+         */
+        std::mutex mutex;
+
+        /**
+         * This is the database connection whose memory use is measured,
+         * or nullptr if the database isn't open.
+         */
+        sqlite3* db = nullptr;
+
+        /**
+         * This is the query result cache, if enabled.
+         */
+        std::shared_ptr< QueryResultCache > cache;
+
+        /**
+         * These are the limits on the heap memory used by SQLite.
+         */
+        SQLiteDatabase::MemoryLimits limits;
+
+        /**
+         * This is the function to call when memory pressure rises.
+         */
+        SQLiteDatabase::MemoryPressureDelegate onPressure;
+
+        /**
+         * This is the level of memory pressure the last time
+         * memory use was checked.
+         */
+        SQLiteDatabase::MemoryPressure pressure = SQLiteDatabase::MemoryPressure::None;
+
+        /**
+         * This is the number of bytes of snapshots, outside SQLite's heap,
+         * which calls to create or install them are currently working with.
+         */
+        std::atomic< size_t > snapshotBytes{0};
+
+        /**
+         * This is the most bytes of snapshots which calls to create
+         * or install them were working with at any one time.
+         */
+        std::atomic< size_t > snapshotPeak{0};
+
+        // Methods
+
+        /**
+         * Set the database connection whose memory use is measured.
+         *
+         * @param[in] newDb
+         *     This is the database connection whose memory use
+         *     is measured, or nullptr if the database is closed.
+         */
+        void SetConnection(sqlite3* newDb) {
+            std::lock_guard< std::mutex > lock(mutex);
+            db = newDb;
+        }
+
+        /**
+         * Set the query result cache whose memory use is measured.
+         *
+         * @param[in] newCache
+         *     This is the query result cache, or nullptr if disabled.
+         */
+        void SetQueryCache(std::shared_ptr< QueryResultCache > newCache) {
+            std::lock_guard< std::mutex > lock(mutex);
+            cache = std::move(newCache);
+        }
+
+        /**
+         * Set the limits on the heap memory used by SQLite.
+         *
+         * @param[in] newLimits
+         *     These are the limits on the heap memory used by SQLite.
+         *
+         * @param[in] newOnPressure
+         *     This is the function to call when memory pressure rises.
+         */
+        void SetLimits(
+            const SQLiteDatabase::MemoryLimits& newLimits,
+            SQLiteDatabase::MemoryPressureDelegate newOnPressure
+        ) {
+            std::lock_guard< std::mutex > lock(mutex);
+            limits = newLimits;
+            onPressure = std::move(newOnPressure);
+            pressure = SQLiteDatabase::MemoryPressure::None;
+#if SQLITE_VERSION_NUMBER >= 3031000
+            (void)sqlite3_hard_heap_limit64((sqlite3_int64)limits.hardHeapLimit);
+#endif /* SQLITE_VERSION_NUMBER >= 3031000 */
+            (void)sqlite3_soft_heap_limit64((sqlite3_int64)limits.softHeapLimit);
+        }
+
+        /**
+         * Account for bytes held by a snapshot being created or installed.
+         *
+         * @param[in] bytes
+         *     This is the number of bytes held by the snapshot.
+         */
+        void AddSnapshotBytes(size_t bytes) {
+            const auto total = (snapshotBytes += bytes);
+            auto peak = snapshotPeak.load();
+            while (
+                (total > peak)
+                && !snapshotPeak.compare_exchange_weak(peak, total)
+            ) {
+            }
+        }
+
+        /**
+         * Stop accounting for bytes held by a snapshot which is
+         * no longer being created or installed.
+         *
+         * @param[in] bytes
+         *     This is the number of bytes held by the snapshot.
+         */
+        void RemoveSnapshotBytes(size_t bytes) {
+            snapshotBytes -= bytes;
+        }
+
+        /**
+         * Measure the memory currently used by SQLite and the database.
+         *
+         * @return
+         *     The measurements of memory used are returned.
+         */
+        SQLiteDatabase::MemoryUsage Measure() {
+            std::lock_guard< std::mutex > lock(mutex);
+            SQLiteDatabase::MemoryUsage usage;
+            sqlite3_int64 heapUsed = 0;
+            sqlite3_int64 heapPeak = 0;
+            (void)sqlite3_status64(SQLITE_STATUS_MEMORY_USED, &heapUsed, &heapPeak, 0);
+            usage.heapUsed = (size_t)heapUsed;
+            usage.heapPeak = (size_t)heapPeak;
+            if (db != nullptr) {
+                int current = 0;
+                int highwater = 0;
+                (void)sqlite3_db_status(db, SQLITE_DBSTATUS_CACHE_USED, &current, &highwater, 0);
+                usage.cacheUsed = (size_t)current;
+                (void)sqlite3_db_status(db, SQLITE_DBSTATUS_STMT_USED, &current, &highwater, 0);
+                usage.statementsUsed = (size_t)current;
+                (void)sqlite3_db_status(db, SQLITE_DBSTATUS_SCHEMA_USED, &current, &highwater, 0);
+                usage.schemaUsed = (size_t)current;
+            }
+            if (cache != nullptr) {
+                usage.queryCacheUsed = cache->GetStatistics().bytes;
+            }
+            usage.snapshotBytes = snapshotBytes;
+            usage.snapshotPeak = snapshotPeak;
+
+            // Snapshots being created or installed are counted against the
+            // limits even though they're held outside SQLite's heap, because
+            // they add to the memory used by the process all the same.  The
+            // query result cache isn't added, since the values it holds are
+            // copies made by SQLite, already counted in its heap.
+            const auto used = usage.heapUsed + usage.snapshotBytes;
+            if (
+                (limits.hardHeapLimit > 0)
+                && (used >= limits.hardHeapLimit / 100 * HARD_PRESSURE_PERCENT)
+            ) {
+                usage.pressure = SQLiteDatabase::MemoryPressure::Hard;
+            } else if (
+                (limits.softHeapLimit > 0)
+                && (used >= limits.softHeapLimit)
+            ) {
+                usage.pressure = SQLiteDatabase::MemoryPressure::Soft;
+            }
+            return usage;
+        }
+
+        /**
+         * Measure the memory currently used by SQLite and the database,
+         * and call the application back if memory pressure has risen
+         * since the last check.
+         */
+        void Check() {
+            const auto usage = Measure();
+            SQLiteDatabase::MemoryPressureDelegate onPressureRisen;
+            {
+                std::lock_guard< std::mutex > lock(mutex);
+                if (usage.pressure > pressure) {
+                    onPressureRisen = onPressure;
+                }
+                pressure = usage.pressure;
+            }
+            if (onPressureRisen != nullptr) {
+                onPressureRisen(usage.pressure, usage);
+            }
+        }
+    };
+
+    /**
+     * This accounts for the bytes held by a snapshot for as long
+     * as it's being created or installed.
+     */
+    struct SnapshotBytesHeld {
+        // Properties
+
+        std::shared_ptr< MemoryMonitor > memoryMonitor;
+        size_t bytes = 0;
+
+        // Lifecycle
+
+        ~SnapshotBytesHeld() noexcept {
+            memoryMonitor->RemoveSnapshotBytes(bytes);
+        }
+        SnapshotBytesHeld(const SnapshotBytesHeld&) = delete;
+        SnapshotBytesHeld(SnapshotBytesHeld&&) = delete;
+        SnapshotBytesHeld& operator=(const SnapshotBytesHeld&) = delete;
+        SnapshotBytesHeld& operator=(SnapshotBytesHeld&&) = delete;
+
+        // Methods
+
+        SnapshotBytesHeld(
+            std::shared_ptr< MemoryMonitor > newMemoryMonitor,
+            size_t newBytes
+        )
+            : memoryMonitor(std::move(newMemoryMonitor))
+            , bytes(newBytes)
+        {
+            memoryMonitor->AddSnapshotBytes(bytes);
+        }
+    };
+
+    /**
+     * This keeps the statistics used by SQLite's query planner up to
+     * date, by analyzing tables once enough of their rows have changed,
+     * and running "PRAGMA optimize" when the database is closed.
+     */
+    struct AutoOptimizer {
+        // Properties
+
+        /**
+         * This is the database connection whose statistics are kept
+         * up to date, or nullptr if the database isn't open.
+         */
+        sqlite3* db = nullptr;
+
+        /**
+         * This indicates whether or not the statistics are kept
+         * up to date automatically.
+         */
+        bool enabled = false;
+
+        /**
+         * These control how the statistics are kept up to date.
+         */
+        SQLiteDatabase::OptimizeOptions options;
+
+        /**
+         * These are statistics about refreshing the statistics.
+         */
+        SQLiteDatabase::OptimizeStatistics statistics;
+
+        /**
+         * These count the rows changed in each table by committed
+         * transactions since the table was last analyzed.
+         */
+        std::map< std::string, size_t > tableChanges;
+
+        /**
+         * These count the rows changed in each table by the transaction
+         * in progress, which are added to tableChanges only if the
+         * transaction is committed.
+         */
+        std::map< std::string, size_t > transactionChanges;
+
+        /**
+         * This refers to the count of rows changed in the table whose
+         * rows were changed most recently, since rows of the same table
+         * are usually changed many times in a row.
+         */
+        std::map< std::string, size_t >::iterator lastTableChanges = transactionChanges.end();
+
+        /**
+         * This indicates whether or not enough rows of some table have
+         * changed for the table to be analyzed.
+         */
+        bool due = false;
+
+        // Methods
+
+        /**
+         * Set the database connection whose statistics are kept up to date.
+         *
+         * @param[in] newDb
+         *     This is the database connection whose statistics are kept
+         *     up to date, or nullptr if the database is closed.
+         */
+        void SetConnection(sqlite3* newDb) {
+            db = newDb;
+            ResetChanges();
+        }
+
+        /**
+         * Forget about rows changed since tables were last analyzed.
+         */
+        void ResetChanges() {
+            tableChanges.clear();
+            transactionChanges.clear();
+            lastTableChanges = transactionChanges.end();
+            due = false;
+        }
+
+        /**
+         * Count a row changed in the given table by the
+         * transaction in progress.
+         *
+         * @param[in] table
+         *     This is the name of the table whose row was changed.
+         */
+        void OnRowChanged(const char* table) {
+            if (
+                !enabled
+                || (options.rowChangeThreshold == 0)
+            ) {
+                return;
+            }
+            if (
+                (lastTableChanges == transactionChanges.end())
+                || (lastTableChanges->first != table)
+            ) {
+                lastTableChanges = transactionChanges.insert(
+                    std::make_pair(std::string(table), (size_t)0)
+                ).first;
+            }
+            ++lastTableChanges->second;
+        }
+
+        /**
+         * Add the rows changed by the transaction being committed
+         * to the counts of rows changed since tables were analyzed.
+         */
+        void OnCommit() {
+            for (const auto& changes: transactionChanges) {
+                auto& count = tableChanges[changes.first];
+                count += changes.second;
+                if (count >= options.rowChangeThreshold) {
+                    due = true;
+                }
+            }
+            transactionChanges.clear();
+            lastTableChanges = transactionChanges.end();
+        }
+
+        /**
+         * Forget about the rows changed by the transaction
+         * being rolled back.
+         */
+        void OnRollback() {
+            transactionChanges.clear();
+            lastTableChanges = transactionChanges.end();
+        }
+
+        /**
+         * Return the value of the given pragma, which is an integer.
+         *
+         * @param[in] statement
+         *     This is the statement which queries the pragma.
+         *
+         * @return
+         *     The value of the pragma is returned.
+         */
+        sqlite3_int64 QueryPragma(const char* statement) {
+            sqlite3_int64 value = 0;
+            sqlite3_stmt* statementRaw;
+            if (sqlite3_prepare_v2(db, statement, -1, &statementRaw, NULL) == SQLITE_OK) {
+                if (sqlite3_step(statementRaw) == SQLITE_ROW) {
+                    value = sqlite3_column_int64(statementRaw, 0);
+                }
+                (void)sqlite3_finalize(statementRaw);
+            }
+            return value;
+        }
+
+        /**
+         * Run the given statements, which refresh statistics,
+         * limiting how many rows of each index they examine.
+         *
+         * @param[in] statements
+         *     These are the statements to run.
+         */
+        void Refresh(const std::vector< std::string >& statements) {
+            if (db == nullptr) {
+                return;
+            }
+            const auto start = std::chrono::steady_clock::now();
+            const auto previousLimit = QueryPragma("PRAGMA analysis_limit");
+            const auto limitStatement = (
+                "PRAGMA analysis_limit = "
+                + std::to_string(options.analysisLimit)
+            );
+            (void)sqlite3_exec(db, limitStatement.c_str(), NULL, NULL, NULL);
+            for (const auto& statement: statements) {
+                // A table may have been dropped since its rows changed,
+                // so keep going if a statement fails.
+                (void)sqlite3_exec(db, statement.c_str(), NULL, NULL, NULL);
+            }
+            const auto restoreLimitStatement = (
+                "PRAGMA analysis_limit = "
+                + std::to_string(previousLimit)
+            );
+            (void)sqlite3_exec(db, restoreLimitStatement.c_str(), NULL, NULL, NULL);
+            ++statistics.runs;
+            statistics.duration += std::chrono::duration_cast< std::chrono::microseconds >(
+                std::chrono::steady_clock::now() - start
+            );
+        }
+
+        /**
+         * Analyze the given tables.
+         *
+         * @param[in] tables
+         *     These are the names of the tables to analyze.
+         */
+        void Analyze(const std::vector< std::string >& tables) {
+            if (tables.empty()) {
+                return;
+            }
+            Refresh(MakeAnalyzeStatements(tables));
+        }
+
+        /**
+         * Return the statements which analyze the given tables.
+         *
+         * @param[in] tables
+         *     These are the names of the tables to analyze.
+         *
+         * @return
+         *     The statements which analyze the given tables are returned.
+         */
+        static std::vector< std::string > MakeAnalyzeStatements(
+            const std::vector< std::string >& tables
+        ) {
+            std::vector< std::string > statements;
+            statements.reserve(tables.size());
+            for (const auto& table: tables) {
+                const auto statement = sqlite3_mprintf("ANALYZE \"%w\"", table.c_str());
+                if (statement != NULL) {
+                    statements.push_back(statement);
+                    sqlite3_free(statement);
+                }
+            }
+            return statements;
+        }
+
+        /**
+         * Return the names of the tables whose rows have changed
+         * enough for them to be analyzed.
+         *
+         * @return
+         *     The names of the tables due to be analyzed are returned.
+         */
+        std::vector< std::string > GetTablesDue() const {
+            std::vector< std::string > tables;
+            if (!due) {
+                return tables;
+            }
+            for (const auto& changes: tableChanges) {
+                if (changes.second >= options.rowChangeThreshold) {
+                    tables.push_back(changes.first);
+                }
+            }
+            return tables;
+        }
+
+        /**
+         * Analyze the tables which have indexes but no statistics,
+         * such as after a snapshot made without them is installed.
+         */
+        void AnalyzeUnanalyzedTables() {
+            if (db == nullptr) {
+                return;
+            }
+            const auto hasStatistics = (
+                sqlite3_table_column_metadata(
+                    db,
+                    "main",
+                    "sqlite_stat1",
+                    "tbl",
+                    NULL,
+                    NULL,
+                    NULL,
+                    NULL,
+                    NULL
+                ) == SQLITE_OK
+            );
+            const auto query = std::string(
+                "SELECT DISTINCT tbl_name FROM sqlite_master"
+                " WHERE type = 'index'"
+            ) + (
+                hasStatistics
+                ? " AND tbl_name NOT IN (SELECT tbl FROM sqlite_stat1)"
+                : ""
+            );
+            sqlite3_stmt* statementRaw;
+            if (sqlite3_prepare_v2(db, query.c_str(), -1, &statementRaw, NULL) != SQLITE_OK) {
+                return;
+            }
+            std::vector< std::string > tables;
+            while (sqlite3_step(statementRaw) == SQLITE_ROW) {
+                tables.push_back((const char*)sqlite3_column_text(statementRaw, 0));
+            }
+            (void)sqlite3_finalize(statementRaw);
+            Analyze(tables);
+        }
+
+        /**
+         * Analyze the tables whose rows have changed enough, if any,
+         * and refresh the statistics for any other tables SQLite
+         * decides need it.
+         */
+        void Optimize() {
+            auto statements = MakeAnalyzeStatements(GetTablesDue());
+            statements.push_back("PRAGMA optimize");
+            tableChanges.clear();
+            due = false;
+            Refresh(statements);
+        }
+    };
+
+    /**
+     * This reads a column of the current row of a statement's results,
+     * for adding to a batch.
+     */
+    struct StatementColumnSource {
+        sqlite3_stmt* statement;
+        int index;
+
+        int GetType() const {
+            return sqlite3_column_type(statement, index);
+        }
+
+        int64_t GetInteger() const {
+            return (int64_t)sqlite3_column_int64(statement, index);
+        }
+
+        double GetReal() const {
+            return sqlite3_column_double(statement, index);
+        }
+
+        const char* GetText() const {
+            return (const char*)sqlite3_column_text(statement, index);
+        }
+
+        size_t GetTextSize() const {
+            return (size_t)sqlite3_column_bytes(statement, index);
+        }
+    };
+
+    /**
+     * This reads a column of a row of cached query results,
+     * for adding to a batch.
+     */
+    struct CachedColumnSource {
+        sqlite3_value* value;
+
+        int GetType() const {
+            return (
+                (value == nullptr)
+                ? SQLITE_NULL
+                : sqlite3_value_type(value)
+            );
+        }
+
+        int64_t GetInteger() const {
+            return (int64_t)sqlite3_value_int64(value);
+        }
+
+        double GetReal() const {
+            return sqlite3_value_double(value);
+        }
+
+        const char* GetText() const {
+            return (const char*)sqlite3_value_text(value);
+        }
+
+        size_t GetTextSize() const {
+            return (size_t)sqlite3_value_bytes(value);
+        }
+    };
+
+    /**
+     * Empty the given batch and set it up to hold columns of the given
+     * types, keeping the memory it has already allocated.
+     *
+     * @param[out] batch
+     *     This is the batch to set up.
+     *
+     * @param[in] columnTypes
+     *     These are the types of the columns the batch is to hold.
+     *
+     * @param[in] maxRows
+     *     This is the most rows the batch is expected to hold.
+     */
+    void ResetBatch(
+        SQLiteDatabase::ColumnBatch& batch,
+        const std::vector< Value::Type >& columnTypes,
+        size_t maxRows
+    ) {
+        batch.rowCount = 0;
+        batch.columns.resize(columnTypes.size());
+        for (size_t i = 0; i < columnTypes.size(); ++i) {
+            auto& column = batch.columns[i];
+            column.type = columnTypes[i];
+            column.validity.clear();
+            column.nullCount = 0;
+            column.integers.clear();
+            column.reals.clear();
+            column.booleans.clear();
+            column.offsets.clear();
+            column.bytes.clear();
+            switch (column.type) {
+                case Value::Type::Integer: {
+                    column.integers.reserve(maxRows);
+                } break;
+
+                case Value::Type::Real: {
+                    column.reals.reserve(maxRows);
+                } break;
+
+                case Value::Type::Text: {
+                    column.offsets.reserve(maxRows + 1);
+                    column.offsets.push_back(0);
+                } break;
+
+                default: break;
+            }
+        }
+    }
+
+    /**
+     * Add a bit to the end of the given bitmap.
+     *
+     * @param[in,out] bitmap
+     *     This is the bitmap to which to add the bit.
+     *
+     * @param[in] index
+     *     This is the index of the bit to add, which is the
+     *     number of bits already in the bitmap.
+     *
+     * @param[in] bit
+     *     This is the value of the bit to add.
+     */
+    void AppendBit(
+        std::vector< uint8_t >& bitmap,
+        size_t index,
+        bool bit
+    ) {
+        if ((index % 8) == 0) {
+            bitmap.push_back(0);
+        }
+        if (bit) {
+            bitmap.back() |= (uint8_t)(1 << (index % 8));
+        }
+    }
+
+    /**
+     * Add the value of a column of a row of query results
+     * to the end of the given batch column.
+     *
+     * @param[in,out] column
+     *     This is the batch column to which to add the value.
+     *
+     * @param[in] row
+     *     This is the index of the row within the batch.
+     *
+     * @param[in] source
+     *     This is used to read the value to add.
+     */
+    template< typename Source > void AppendToBatchColumn(
+        SQLiteDatabase::BatchColumn& column,
+        size_t row,
+        const Source& source
+    ) {
+        const auto isNull = (source.GetType() == SQLITE_NULL);
+        AppendBit(column.validity, row, !isNull);
+        if (isNull) {
+            ++column.nullCount;
+        }
+        switch (column.type) {
+            case Value::Type::Integer: {
+                column.integers.push_back(isNull ? 0 : source.GetInteger());
+            } break;
+
+            case Value::Type::Real: {
+                column.reals.push_back(isNull ? 0.0 : source.GetReal());
+            } break;
+
+            case Value::Type::Boolean: {
+                AppendBit(
+                    column.booleans,
+                    row,
+                    !isNull && (source.GetInteger() != 0)
+                );
+            } break;
+
+            case Value::Type::Text: {
+                if (!isNull) {
+                    // The text must be fetched before its size is
+                    // measured, in case it has to be converted first.
+                    const auto text = source.GetText();
+                    column.bytes.insert(
+                        column.bytes.end(),
+                        text,
+                        text + source.GetTextSize()
+                    );
+                }
+                column.offsets.push_back((int32_t)column.bytes.size());
+            } break;
+
+            default: break;
+        }
+    }
+
     struct SQliteStatement
         : public PreparedStatement
     {
@@ -33,6 +1370,95 @@ namespace {
         sqlite3_stmt* statement = nullptr;
         DatabaseConnection db;
 
+        /**
+         * This is the cache of query results, if results of
+         * this statement are to be cached, or nullptr otherwise.
+         */
+        std::shared_ptr< QueryResultCache > cache;
+
+        /**
+         * This holds the deadlines which bound how long each step
+         * of the statement may take.
+         */
+        std::shared_ptr< Interruption > interruption;
+
+        /**
+         * This is used to check memory use once the statement
+         * is done being stepped.
+         */
+        std::shared_ptr< MemoryMonitor > memoryMonitor;
+
+        /**
+         * These count the number of times each table is read by
+         * statements run, if hot tables are tracked, or nullptr otherwise.
+         */
+        std::shared_ptr< std::map< std::string, size_t > > tableReadCounts;
+
+        /**
+         * These are the names of the tables read by the statement
+         * which count towards tableReadCounts.
+         */
+        std::vector< std::string > countedTables;
+
+        /**
+         * This holds information about what the statement does
+         * to the database, if the query result cache is used.
+         */
+        StatementAccess access;
+
+        /**
+         * This indicates whether or not SQLite considers the statement
+         * to leave the database unchanged.
+         */
+        bool readOnly = false;
+
+        /**
+         * This indicates whether or not the results of the statement
+         * may be added to the query result cache.
+         */
+        bool cacheable = false;
+
+        /**
+         * These represent the values bound to the parameters of the
+         * statement, for use in forming a key for the query result cache.
+         */
+        std::vector< std::string > parameterKeys;
+
+        /**
+         * This indicates whether or not the statement has been stepped
+         * since it was built or last reset.
+         */
+        bool started = false;
+
+        /**
+         * These are the cached results being returned in place
+         * of stepping the statement, if any.
+         */
+        std::shared_ptr< const QueryResultCache::Rows > cachedRows;
+
+        /**
+         * This is the index of the current row of cachedRows.
+         */
+        size_t cachedRowIndex = 0;
+
+        /**
+         * These are the results recorded while stepping the statement,
+         * to add to the query result cache once all rows are stepped.
+         */
+        std::shared_ptr< QueryResultCache::Rows > recordedRows;
+
+        /**
+         * This is the key under which to add recorded results
+         * to the query result cache.
+         */
+        std::string recordedKey;
+
+        /**
+         * This is the generation of the query result cache
+         * when recording of results started.
+         */
+        uint64_t recordedGeneration = 0;
+
         // Lifecycle
 
         ~SQliteStatement() noexcept {
@@ -51,24 +1477,141 @@ namespace {
             Drop();
             statement = other.statement;
             other.statement = nullptr;
+            return *this;
+        }
+
+        // Constructor
+
+        explicit SQliteStatement(
+            sqlite3_stmt* statement,
+            DatabaseConnection& db
+        )
+            : statement(statement)
+            , db(db)
+        {
+        }
+
+        // Methods
+
+        void Drop() {
+            if (statement) {
+                (void)sqlite3_finalize(statement);
+            }
+        }
+
+        /**
+         * Form the key under which the results of the statement,
+         * with its current parameter values, are cached.
+         *
+         * @return
+         *     The key under which the results of the statement
+         *     are cached is returned.
+         */
+        std::string MakeCacheKey() const {
+            std::string key(sqlite3_sql(statement));
+            key.push_back('\0');
+            for (const auto& parameterKey: parameterKeys) {
+                key += parameterKey;
+                key.push_back(',');
+            }
+            return key;
         }
 
-        // Constructor
+        /**
+         * Look up the results of the statement in the query result cache.
+         * If they're found, set up to return them rather than stepping
+         * the statement.  Otherwise, set up to record the results so they
+         * can be added to the cache.
+         */
+        void StartCachedQuery() {
+            recordedKey = MakeCacheKey();
+            cachedRows = cache->Lookup(recordedKey);
+            cachedRowIndex = 0;
+            if (cachedRows == nullptr) {
+                recordedRows = std::make_shared< QueryResultCache::Rows >();
+                recordedGeneration = cache->GetGeneration();
+            }
+        }
+
+        /**
+         * Step through the next row of cached results.
+         *
+         * @return
+         *     The results of the step are returned.
+         */
+        StepStatementResults StepCachedRows() {
+            StepStatementResults results;
+            if (started) {
+                ++cachedRowIndex;
+            }
+            results.done = (cachedRowIndex >= cachedRows->rows.size());
+            return results;
+        }
+
+        /**
+         * Add the column values of the current row of results to
+         * the results being recorded, or stop recording if the results
+         * become too large to be cached.
+         */
+        void RecordRow() {
+            recordedRows->AddRow(statement);
+            if (recordedRows->bytes > cache->GetMemoryBudget()) {
+                recordedRows = nullptr;
+            }
+        }
+
+        /**
+         * Fetch the value of a column of the current row of cached results.
+         *
+         * @param[in] index
+         *     This is the index of the column to fetch.
+         *
+         * @param[in] type
+         *     This is the type of value to fetch.
+         *
+         * @return
+         *     The value of the column is returned.
+         */
+        Value FetchCachedColumn(int index, Value::Type type) {
+            if (cachedRowIndex >= cachedRows->rows.size()) {
+                return Value();
+            }
+            const auto& row = cachedRows->rows[cachedRowIndex];
+            if (
+                (index < 0)
+                || ((size_t)index >= row.size())
+                || (row[index] == nullptr)
+            ) {
+                return Value();
+            }
+            const auto value = row[index];
+            if (sqlite3_value_type(value) == SQLITE_NULL) {
+                return Value(nullptr);
+            }
+            switch (type) {
+                case Value::Type::Text: {
+                    const auto text = (const char*)sqlite3_value_text(value);
+                    return Value(
+                        std::string(
+                            text,
+                            (size_t)sqlite3_value_bytes(value)
+                        )
+                    );
+                }
+
+                case Value::Type::Integer: {
+                    return Value((intmax_t)sqlite3_value_int64(value));
+                }
 
-        explicit SQliteStatement(
-            sqlite3_stmt* statement,
-            DatabaseConnection& db
-        )
-            : statement(statement)
-            , db(db)
-        {
-        }
+                case Value::Type::Real: {
+                    return Value(sqlite3_value_double(value));
+                }
 
-        // Methods
+                case Value::Type::Boolean: {
+                    return Value(sqlite3_value_int(value) != 0);
+                }
 
-        void Drop() {
-            if (statement) {
-                (void)sqlite3_finalize(statement);
+                default: return Value();
             }
         }
 
@@ -78,6 +1621,12 @@ namespace {
             int index,
             const Value& value
         ) override {
+            if (cache != nullptr) {
+                if (parameterKeys.size() <= (size_t)index) {
+                    parameterKeys.resize((size_t)index + 1);
+                }
+                parameterKeys[index] = MakeParameterKey(value);
+            }
             switch(value.GetType()) {
                 case Value::Type::Text: {
                     const std::string& valueAsString = value;
@@ -125,88 +1674,1149 @@ namespace {
             }
         }
 
-        virtual void BindParameters(std::initializer_list< const Value > values) override {
-            int index = 0;
-            for (
-                auto value = values.begin();
-                value != values.end();
-                ++value, ++index
+        virtual void BindParameters(std::initializer_list< const Value > values) override {
+            int index = 0;
+            for (
+                auto value = values.begin();
+                value != values.end();
+                ++value, ++index
+            ) {
+                BindParameter(index, *value);
+            }
+        }
+
+        virtual Value FetchColumn(int index, Value::Type type) override {
+            if (cachedRows != nullptr) {
+                return FetchCachedColumn(index, type);
+            }
+            if (sqlite3_column_type(statement, index) == SQLITE_NULL) {
+                return Value(nullptr);
+            }
+            switch (type) {
+                case Value::Type::Text: {
+                    return Value(
+                        std::string(
+                            (const char*)sqlite3_column_text(statement, index),
+                            (size_t)sqlite3_column_bytes(statement, index)
+                        )
+                    );
+                }
+
+                case Value::Type::Integer: {
+                    return Value((intmax_t)sqlite3_column_int64(statement, index));
+                }
+
+                case Value::Type::Real: {
+                    return Value(sqlite3_column_double(statement, index));
+                }
+
+                case Value::Type::Boolean: {
+                    return Value(sqlite3_column_int(statement, index) != 0);
+                }
+
+                default: return Value();
+            }
+        }
+
+        /**
+         * Step through up to the given number of rows of results,
+         * storing their column values in the given batch.
+         *
+         * @param[in] columnTypes
+         *     These are the types of the columns to fetch.
+         *
+         * @param[in] maxRows
+         *     This is the most rows to step through.
+         *
+         * @param[out] batch
+         *     This is where to store the column values of the rows
+         *     stepped through.
+         *
+         * @return
+         *     The results of the last step are returned.
+         */
+        StepStatementResults StepBatch(
+            const std::vector< Value::Type >& columnTypes,
+            size_t maxRows,
+            SQLiteDatabase::ColumnBatch& batch
+        ) {
+            ResetBatch(batch, columnTypes, maxRows);
+            StepStatementResults results;
+            while (batch.rowCount < maxRows) {
+                results = Step();
+                if (results.done) {
+                    break;
+                }
+                if (cachedRows != nullptr) {
+                    const auto& row = cachedRows->rows[cachedRowIndex];
+                    for (size_t i = 0; i < batch.columns.size(); ++i) {
+                        AppendToBatchColumn(
+                            batch.columns[i],
+                            batch.rowCount,
+                            CachedColumnSource{
+                                (i < row.size()) ? row[i] : nullptr
+                            }
+                        );
+                    }
+                } else {
+                    for (size_t i = 0; i < batch.columns.size(); ++i) {
+                        AppendToBatchColumn(
+                            batch.columns[i],
+                            batch.rowCount,
+                            StatementColumnSource{statement, (int)i}
+                        );
+                    }
+                }
+                ++batch.rowCount;
+            }
+            return results;
+        }
+
+        virtual void Reset() override {
+            (void)sqlite3_reset(statement);
+            started = false;
+            cachedRows = nullptr;
+            recordedRows = nullptr;
+        }
+
+        /**
+         * Count one more read of each table read by the statement,
+         * if hot tables are tracked.
+         */
+        void CountTableReads() {
+            if (tableReadCounts == nullptr) {
+                return;
+            }
+            for (const auto& table: countedTables) {
+                ++(*tableReadCounts)[table];
+            }
+        }
+
+        virtual StepStatementResults Step() override {
+            StepStatementResults results;
+            if (
+                (interruption != nullptr)
+                && !interruption->BeginCall()
+            ) {
+                results.done = true;
+                results.error = interruption->GetInterruptedError();
+                return results;
+            }
+            if (
+                cacheable
+                && !started
+            ) {
+                StartCachedQuery();
+            }
+            if (cachedRows != nullptr) {
+                results = StepCachedRows();
+                if (interruption != nullptr) {
+                    interruption->EndCall();
+                }
+                if (!started) {
+                    CountTableReads();
+                }
+                started = true;
+                return results;
+            }
+            if (!started) {
+                CountTableReads();
+            }
+            started = true;
+            const auto stepResult = sqlite3_step(statement);
+            if (interruption != nullptr) {
+                interruption->EndCall();
+            }
+            switch (stepResult) {
+                case SQLITE_DONE: {
+                    results.done = true;
+                    if (recordedRows != nullptr) {
+                        cache->Insert(
+                            recordedKey,
+                            recordedRows,
+                            access.tablesRead,
+                            recordedGeneration
+                        );
+                        recordedRows = nullptr;
+                    }
+                } break;
+
+                case SQLITE_ROW: {
+                    results.done = false;
+                    if (recordedRows != nullptr) {
+                        RecordRow();
+                    }
+                } break;
+
+                default: {
+                    results.done = true;
+                    if (
+                        (stepResult == SQLITE_INTERRUPT)
+                        && (interruption != nullptr)
+                    ) {
+                        results.error = interruption->GetInterruptedError();
+                    } else {
+                        results.error = GetLastDatabaseError(db);
+                    }
+                    recordedRows = nullptr;
+                } break;
+            }
+            if (
+                (cache != nullptr)
+                && !cacheable
+            ) {
+                InvalidateQueryCache(*cache, access, readOnly);
+            }
+            if (results.done) {
+                if (memoryMonitor != nullptr) {
+                    memoryMonitor->Check();
+                }
+            }
+            return results;
+        }
+    };
+
+    /**
+     * This holds the connections to the database which aren't being used
+     * by any read view, so that they can be reused by later read views
+     * rather than opening new ones, and keeps track of how many are.
+     */
+    struct ReaderPool {
+        // Properties
+
+        /**
+         * This is used to synchronize access to the pool.
+         */
+        std::mutex mutex;
+
+        /**
+         * These are the connections not being used by any read view.
+         */
+        std::vector< DatabaseConnection > idleReaders;
+
+        /**
+         * This is the number of connections being used by read views,
+         * or by statements built from them.
+         */
+        size_t leasedReaders = 0;
+
+        /**
+         * This is incremented each time the database is closed, so that
+         * connections opened before then aren't put back in the pool.
+         */
+        uint64_t generation = 0;
+
+        // Methods
+
+        /**
+         * Take a connection out of the pool, if there are any.
+         *
+         * @param[out] readerGeneration
+         *     This is where to store the generation of the pool,
+         *     to give back when the connection is returned.
+         *
+         * @return
+         *     The connection taken out of the pool is returned.
+         *
+         * @retval nullptr
+         *     This is returned if the pool is empty.
+         */
+        DatabaseConnection Take(uint64_t& readerGeneration) {
+            std::lock_guard< decltype(mutex) > lock(mutex);
+            readerGeneration = generation;
+            if (idleReaders.empty()) {
+                return nullptr;
+            }
+            auto reader = std::move(idleReaders.back());
+            idleReaders.pop_back();
+            return reader;
+        }
+
+        /**
+         * Count a connection as being used by a read view.
+         */
+        void Lease() {
+            std::lock_guard< decltype(mutex) > lock(mutex);
+            ++leasedReaders;
+        }
+
+        /**
+         * Stop counting a connection as being used by a read view, and
+         * put it back in the pool, unless the database was closed since
+         * the connection was taken or opened, or the pool is already
+         * full, in which case the connection is closed.
+         *
+         * @param[in] reader
+         *     This is the connection to put back in the pool,
+         *     or nullptr if it's to be closed.
+         *
+         * @param[in] readerGeneration
+         *     This is the generation of the pool when the connection
+         *     was taken or opened.
+         */
+        void Give(
+            DatabaseConnection&& reader,
+            uint64_t readerGeneration
+        ) {
+            std::lock_guard< decltype(mutex) > lock(mutex);
+            --leasedReaders;
+            if (
+                (reader != nullptr)
+                && (readerGeneration == generation)
+                && (idleReaders.size() < MAX_IDLE_READERS)
+            ) {
+                idleReaders.push_back(std::move(reader));
+            }
+        }
+
+        /**
+         * Return the number of connections being used by read views,
+         * or by statements built from them.
+         *
+         * @return
+         *     The number of connections being used by read views
+         *     is returned.
+         */
+        size_t GetLeasedCount() {
+            std::lock_guard< decltype(mutex) > lock(mutex);
+            return leasedReaders;
+        }
+
+        /**
+         * Close all connections in the pool, and keep any connections
+         * currently in use from being put back in it.
+         */
+        void Clear() {
+            std::lock_guard< decltype(mutex) > lock(mutex);
+            ++generation;
+            idleReaders.clear();
+        }
+    };
+
+    /**
+     * Lend the given connection, which has a read transaction open,
+     * to a read view.  Once the view and all statements built from it
+     * are destroyed, the read transaction is ended and the connection
+     * is given back to the pool.
+     *
+     * @param[in] pool
+     *     This is the pool to which to give back the connection.
+     *
+     * @param[in] reader
+     *     This is the connection to lend.
+     *
+     * @param[in] readerGeneration
+     *     This is the generation of the pool when the connection
+     *     was taken or opened.
+     *
+     * @param[in] interruption
+     *     This is used to bound and cancel calls made through
+     *     the connection while it's lent out.
+     *
+     * @return
+     *     The connection to use while it's lent out is returned.
+     */
+    DatabaseConnection LeaseReader(
+        const std::shared_ptr< ReaderPool >& pool,
+        DatabaseConnection reader,
+        uint64_t readerGeneration,
+        const std::shared_ptr< Interruption >& interruption
+    ) {
+        pool->Lease();
+        interruption->Attach(reader.get());
+        const auto readerRaw = reader.get();
+        return DatabaseConnection(
+            readerRaw,
+            [pool, reader, readerGeneration, interruption](sqlite3* readerRaw) mutable {
+                sqlite3_progress_handler(readerRaw, 0, NULL, NULL);
+                if (sqlite3_exec(readerRaw, "COMMIT", NULL, NULL, NULL) != SQLITE_OK) {
+                    reader = nullptr;
+                }
+                pool->Give(std::move(reader), readerGeneration);
+            }
+        );
+    }
+
+    /**
+     * This is the implementation of a read view of the database,
+     * which holds a read transaction open on its own connection.
+     */
+    struct SQLiteReadView
+        : public SQLiteDatabase::ReadView
+    {
+        // Properties
+
+        /**
+         * This is the connection holding the read transaction which pins
+         * the view's state of the database.  It's shared with statements
+         * built from the view, and the read transaction lasts until the
+         * view and all of those statements are destroyed.
+         */
+        DatabaseConnection reader;
+
+        /**
+         * This bounds and cancels calls made through the view,
+         * following the deadlines and cancellation of the database.
+         */
+        std::shared_ptr< Interruption > interruption;
+
+        // SQLiteDatabase::ReadView
+
+        virtual BuildStatementResults BuildStatement(
+            const std::string& statement
+        ) override {
+            BuildStatementResults results;
+            sqlite3_stmt* statementRaw;
+            if (
+                sqlite3_prepare_v2(
+                    reader.get(),
+                    statement.c_str(),
+                    (int)(statement.length() + 1), // sqlite wants count to include the null
+                    &statementRaw,
+                    NULL
+                ) == SQLITE_OK
+            ) {
+                const auto managedStatement = std::make_shared< SQliteStatement >(
+                    statementRaw,
+                    reader
+                );
+                managedStatement->interruption = interruption;
+                results.statement = managedStatement;
+            } else {
+                results.error = GetLastDatabaseError(reader);
+            }
+            return results;
+        }
+    };
+
+}
+
+namespace DatabaseAbstractions {
+
+    const std::string SQLiteDatabase::CANCELED_ERROR = "canceled";
+    const std::string SQLiteDatabase::DEADLINE_EXCEEDED_ERROR = "deadline exceeded";
+
+    // Here we implement what we specified we would have in our interface.
+    // This contains our private properties.
+    struct SQLiteDatabase::Impl {
+        // Properties
+
+        std::string filePath;
+        OpenOptions openOptions;
+        DatabaseConnection db;
+
+        /**
+         * This indicates whether or not the database was opened through
+         * the io_uring-backed virtual file system.
+         */
+        bool usingIoUring = false;
+
+#if defined(SQLITE_ENABLE_SESSION) && defined(SQLITE_ENABLE_PREUPDATE_HOOK)
+        /**
+         * This is used to record changes made to the database,
+         * while a changeset is being recorded.
+         */
+        Session session;
+#endif /* SQLITE_ENABLE_SESSION && SQLITE_ENABLE_PREUPDATE_HOOK */
+
+        /**
+         * This is the cache of query results, if enabled.
+         */
+        std::shared_ptr< QueryResultCache > cache;
+
+        /**
+         * This indicates whether or not snapshots are compacted.
+         */
+        bool compactSnapshots = false;
+
+        /**
+         * This holds statistics about reclaiming unused space
+         * in the database.
+         */
+        CompactionStatistics compactionStatistics;
+
+        /**
+         * This indicates whether or not the checkpoint scheduler
+         * should be running while the database is open.
+         */
+        bool checkpointSchedulerEnabled = false;
+
+        /**
+         * These control how the checkpoint scheduler operates.
+         */
+        CheckpointOptions checkpointOptions;
+
+        /**
+         * This does checkpoints of the database in the background,
+         * if the checkpoint scheduler is enabled.
+         */
+        CheckpointScheduler checkpointScheduler;
+
+        /**
+         * These control how the cache is warmed up after the
+         * database is opened.
+         */
+        WarmUpOptions warmUpOptions;
+
+        /**
+         * These count the number of times statements were run which
+         * read each table, since the database was opened.
+         */
+        std::shared_ptr< std::map< std::string, size_t > > tableReadCounts = (
+            std::make_shared< std::map< std::string, size_t > >()
+        );
+
+        /**
+         * These are the names of the tables to warm up first, in order
+         * of priority, the next time the database is opened.
+         */
+        std::vector< std::string > hotTables;
+
+        /**
+         * This warms up the cache in the background after the
+         * database is opened.
+         */
+        PageCacheWarmer pageCacheWarmer;
+
+        /**
+         * These are the SQL functions implemented in C++ which are
+         * registered each time the database is opened.
+         */
+        std::vector< std::shared_ptr< const UserFunction > > userFunctions;
+
+        /**
+         * These are the virtual tables implemented in C++ which are
+         * registered each time the database is opened, keyed by name.
+         */
+        std::map< std::string, std::shared_ptr< VirtualTable > > virtualTables;
+
+        /**
+         * This holds the deadlines which bound how long calls which
+         * run statements may take, and is used to cancel them.
+         */
+        std::shared_ptr< Interruption > interruption = std::make_shared< Interruption >();
+
+        /**
+         * This measures the memory used by SQLite and the database,
+         * and reports when memory pressure rises.
+         */
+        std::shared_ptr< MemoryMonitor > memoryMonitor = std::make_shared< MemoryMonitor >();
+
+        /**
+         * This keeps the statistics used by SQLite's query planner
+         * up to date, if enabled.
+         */
+        std::shared_ptr< AutoOptimizer > autoOptimizer = std::make_shared< AutoOptimizer >();
+
+        /**
+         * This indicates whether or not the database is known to be
+         * in write-ahead log mode.
+         */
+        bool walMode = false;
+
+        /**
+         * This holds the connections to the database which can be
+         * reused by read views.
+         */
+        std::shared_ptr< ReaderPool > readerPool = std::make_shared< ReaderPool >();
+
+        // Lifecycle
+
+        ~Impl() noexcept {
+            DetachHooks();
+        }
+
+        Impl() = default;
+        Impl(const Impl&) = delete;
+        Impl(Impl&&) = delete;
+        Impl& operator=(const Impl&) = delete;
+        Impl& operator=(Impl&&) = delete;
+
+        // Methods
+
+        /**
+         * Determine whether or not the given table is a virtual table
+         * implemented in C++.
+         *
+         * @param[in] table
+         *     This is the name of the table to check.
+         *
+         * @return
+         *     An indication of whether or not the given table is a virtual
+         *     table implemented in C++ is returned.
+         */
+        bool IsVirtualTable(const std::string& table) const {
+            return virtualTables.find(table) != virtualTables.end();
+        }
+
+        /**
+         * Determine whether or not a statement reads any virtual table
+         * implemented in C++, whose contents can change without the
+         * database knowing about it.
+         *
+         * @param[in] access
+         *     This holds information about what the statement does
+         *     to the database.
+         *
+         * @return
+         *     An indication of whether or not the statement reads any
+         *     virtual table implemented in C++ is returned.
+         */
+        bool ReadsVirtualTable(const StatementAccess& access) const {
+            for (const auto& table: access.tablesRead) {
+                if (IsVirtualTable(table)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /**
+         * Register the given SQL function implemented in C++, now if
+         * the database is open, and each time the database is opened.
+         *
+         * @param[in] function
+         *     This is the definition of the function to register.
+         *
+         * @return
+         *     An error message is returned if the function could not be
+         *     registered.  Otherwise, an empty string is returned.
+         */
+        std::string AddUserFunction(const std::shared_ptr< const UserFunction >& function) {
+            if (db != nullptr) {
+                const auto error = RegisterUserFunction(db.get(), function);
+                if (!error.empty()) {
+                    return error;
+                }
+            }
+            if (cache != nullptr) {
+                cache->InvalidateAll();
+            }
+            for (auto& userFunction: userFunctions) {
+                if (
+                    (userFunction->name == function->name)
+                    && (userFunction->argumentCount == function->argumentCount)
+                ) {
+                    userFunction = function;
+                    return "";
+                }
+            }
+            userFunctions.push_back(function);
+            return "";
+        }
+
+        /**
+         * Return the names of the tables read by the most statements
+         * run since the database was opened, in order from most to least.
+         *
+         * @return
+         *     The names of the tables read by the most statements
+         *     run are returned.
+         */
+        std::vector< std::string > RankTablesByReads() const {
+            std::vector< std::pair< std::string, size_t > > counts(
+                tableReadCounts->begin(),
+                tableReadCounts->end()
+            );
+            std::stable_sort(
+                counts.begin(),
+                counts.end(),
+                [](
+                    const std::pair< std::string, size_t >& lhs,
+                    const std::pair< std::string, size_t >& rhs
+                ){
+                    return lhs.second > rhs.second;
+                }
+            );
+            std::vector< std::string > tables;
+            for (const auto& count: counts) {
+                tables.push_back(count.first);
+            }
+            return tables;
+        }
+
+        /**
+         * Determine whether or not statements being built need to
+         * be examined to see what they do to the database.
+         *
+         * @return
+         *     An indication of whether or not statements being built
+         *     need to be examined is returned.
+         */
+        bool NeedStatementAccess() const {
+            return (
+                (cache != nullptr)
+                || (
+                    (warmUpOptions.byteBudget > 0)
+                    && warmUpOptions.trackHotTables
+                )
+            );
+        }
+
+        /**
+         * Execute the given SQL statement, which produces a single
+         * integer, such as a pragma, and return the integer.
+         *
+         * @param[in] statement
+         *     This is the SQL statement to execute.
+         *
+         * @return
+         *     The integer produced by the statement is returned,
+         *     or zero if the statement failed.
+         */
+        intmax_t QueryInteger(const std::string& statement) {
+            sqlite3_stmt* statementRaw;
+            if (
+                sqlite3_prepare_v2(
+                    db.get(),
+                    statement.c_str(),
+                    (int)(statement.length() + 1),
+                    &statementRaw,
+                    NULL
+                ) != SQLITE_OK
+            ) {
+                return 0;
+            }
+            intmax_t result = 0;
+            if (sqlite3_step(statementRaw) == SQLITE_ROW) {
+                result = (intmax_t)sqlite3_column_int64(statementRaw, 0);
+            }
+            (void)sqlite3_finalize(statementRaw);
+            return result;
+        }
+
+        /**
+         * Return the number of bytes currently held in free
+         * pages in the database.
+         *
+         * @return
+         *     The number of bytes currently held in free pages
+         *     in the database is returned.
+         */
+        size_t GetFreeBytes() {
+            return (size_t)(
+                QueryInteger("PRAGMA freelist_count")
+                * QueryInteger("PRAGMA page_size")
+            );
+        }
+
+        /**
+         * Make a compacted copy of the database and return its
+         * serialization.  The copy is made and compacted in memory,
+         * so that nothing is left behind if the process stops partway
+         * through, and snapshots made at the same time don't collide.
+         *
+         * @param[out] snapshot
+         *     This is where to store the serialization of the
+         *     compacted copy of the database.
+         *
+         * @return
+         *     An indication of whether or not the compacted copy
+         *     was made successfully is returned.
+         */
+        bool CreateCompactedSnapshot(Blob& snapshot) {
+            sqlite3_int64 size;
+            const auto serialization = sqlite3_serialize(db.get(), "main", &size, 0);
+            if (serialization == nullptr) {
+                return false;
+            }
+
+            // Bytes 18 and 19 of the database header are the file format
+            // versions, which are 2 for write-ahead log mode.  An in-memory
+            // database can't use a write-ahead log, so the copy is put in
+            // rollback journal mode while it's compacted, and the versions
+            // are put back in its serialization after.
+            uint8_t fileFormat[2] = {1, 1};
+            if (size >= 100) {
+                fileFormat[0] = serialization[18];
+                fileFormat[1] = serialization[19];
+                serialization[18] = serialization[19] = 1;
+            }
+            sqlite3* compactedDb;
+            if (sqlite3_open(":memory:", &compactedDb) != SQLITE_OK) {
+                (void)sqlite3_close(compactedDb);
+                sqlite3_free(serialization);
+                return false;
+            }
+            if (
+                (
+                    sqlite3_deserialize(
+                        compactedDb,
+                        "main",
+                        serialization,
+                        size,
+                        size,
+                        SQLITE_DESERIALIZE_FREEONCLOSE | SQLITE_DESERIALIZE_RESIZEABLE
+                    ) != SQLITE_OK
+                )
+                || (
+                    sqlite3_exec(
+                        compactedDb,
+                        "PRAGMA temp_store = MEMORY; VACUUM",
+                        NULL,
+                        NULL,
+                        NULL
+                    ) != SQLITE_OK
+                )
+            ) {
+                (void)sqlite3_close(compactedDb);
+                return false;
+            }
+            sqlite3_int64 compactedSize;
+            const auto compactedSerialization = sqlite3_serialize(
+                compactedDb,
+                "main",
+                &compactedSize,
+                0
+            );
+            if (compactedSerialization != nullptr) {
+                snapshot.assign(
+                    compactedSerialization,
+                    compactedSerialization + compactedSize
+                );
+                sqlite3_free(compactedSerialization);
+                if (snapshot.size() >= 100) {
+                    snapshot[18] = fileFormat[0];
+                    snapshot[19] = fileFormat[1];
+                }
+            }
+            (void)sqlite3_close(compactedDb);
+            return (compactedSerialization != nullptr);
+        }
+
+        /**
+         * This is the function called by SQLite whenever a row is
+         * inserted, updated, or deleted in a table of the database.
+         *
+         * @param[in] context
+         *     This points to the Impl of the database.
+         *
+         * @param[in] operation
+         *     This is the SQLite code indicating the kind of change.
+         *
+         * @param[in] databaseName
+         *     This is the name of the database which changed.
+         *
+         * @param[in] table
+         *     This is the name of the table which changed.
+         *
+         * @param[in] rowid
+         *     This is the rowid of the row which changed.
+         */
+        static void OnUpdate(
+            void* context,
+            int operation,
+            const char* databaseName,
+            const char* table,
+            sqlite3_int64 rowid
+        ) {
+            (void)operation;
+            (void)databaseName;
+            (void)rowid;
+            const auto impl = (Impl*)context;
+            if (impl->cache != nullptr) {
+                impl->cache->InvalidateTable(table);
+            }
+            impl->autoOptimizer->OnRowChanged(table);
+        }
+
+        /**
+         * This is the function called by SQLite whenever a transaction
+         * is rolled back.
+         *
+         * @param[in] context
+         *     This points to the Impl of the database.
+         */
+        static void OnRollback(void* context) {
+            const auto impl = (Impl*)context;
+            if (impl->cache != nullptr) {
+                impl->cache->InvalidateAll();
+            }
+            impl->autoOptimizer->OnRollback();
+        }
+
+        /**
+         * This is the function called by SQLite whenever a transaction
+         * is about to be committed.
+         *
+         * @param[in] context
+         *     This points to the Impl of the database.
+         *
+         * @return
+         *     Zero is returned, to let the transaction be committed.
+         */
+        static int OnCommit(void* context) {
+            const auto impl = (Impl*)context;
+            impl->autoOptimizer->OnCommit();
+            return 0;
+        }
+
+        /**
+         * This is the function called by SQLite whenever a transaction
+         * is committed while the database is in write-ahead log mode.
+         *
+         * @param[in] context
+         *     This points to the Impl of the database.
+         *
+         * @param[in] dbRaw
+         *     This is the database connection which committed.
+         *
+         * @param[in] databaseName
+         *     This is the name of the database which changed.
+         *
+         * @param[in] walFrames
+         *     This is the number of frames in the write-ahead log.
+         *
+         * @return
+         *     The SQLite result code is returned.
+         */
+        static int OnWalCommit(
+            void* context,
+            sqlite3* dbRaw,
+            const char* databaseName,
+            int walFrames
+        ) {
+            (void)dbRaw;
+            (void)databaseName;
+            const auto impl = (Impl*)context;
+            impl->checkpointScheduler.OnCommit((size_t)walFrames);
+            return SQLITE_OK;
+        }
+
+        /**
+         * Put the database in write-ahead log mode, if it isn't already.
+         *
+         * @return
+         *     An indication of whether or not the database is in
+         *     write-ahead log mode is returned.
+         */
+        bool EnableWalMode() {
+            if (walMode) {
+                return true;
+            }
+            sqlite3_stmt* statementRaw;
+            if (
+                sqlite3_prepare_v2(
+                    db.get(),
+                    "PRAGMA journal_mode = WAL",
+                    -1,
+                    &statementRaw,
+                    NULL
+                ) != SQLITE_OK
+            ) {
+                return false;
+            }
+            if (sqlite3_step(statementRaw) == SQLITE_ROW) {
+                const auto journalMode = (const char*)sqlite3_column_text(statementRaw, 0);
+                walMode = (
+                    (journalMode != nullptr)
+                    && (strcmp(journalMode, "wal") == 0)
+                );
+            }
+            (void)sqlite3_finalize(statementRaw);
+            return walMode;
+        }
+
+        /**
+         * Put the database in write-ahead log mode, turn off SQLite's
+         * automatic checkpoints, and start the checkpoint scheduler.
+         *
+         * @return
+         *     An indication of whether or not the checkpoint scheduler
+         *     was started successfully is returned.
+         */
+        bool StartCheckpointScheduler() {
+            if (!EnableWalMode()) {
+                return false;
+            }
+            if (
+                !checkpointScheduler.Start(
+                    filePath,
+                    checkpointOptions,
+                    (size_t)QueryInteger("PRAGMA page_size")
+                )
             ) {
-                BindParameter(index, *value);
+                return false;
             }
+            (void)sqlite3_wal_hook(db.get(), OnWalCommit, this);
+            return true;
         }
 
-        virtual Value FetchColumn(int index, Value::Type type) override {
-            if (sqlite3_column_type(statement, index) == SQLITE_NULL) {
-                return Value(nullptr);
+        /**
+         * Open a new connection to the database for use by read views,
+         * with the same SQL functions as the main connection.
+         *
+         * @return
+         *     The new connection is returned.
+         *
+         * @retval nullptr
+         *     This is returned if the connection could not be opened.
+         */
+        DatabaseConnection OpenReader() {
+            sqlite3* readerRaw;
+            if (
+                sqlite3_open_v2(
+                    filePath.c_str(),
+                    &readerRaw,
+                    SQLITE_OPEN_READWRITE,
+                    usingIoUring ? RegisterUringVfs() : nullptr
+                ) != SQLITE_OK
+            ) {
+                (void)sqlite3_close(readerRaw);
+                return nullptr;
             }
-            switch (type) {
-                case Value::Type::Text: {
-                    return Value(
-                        std::string(
-                            (const char*)sqlite3_column_text(statement, index),
-                            (size_t)sqlite3_column_bytes(statement, index)
-                        )
-                    );
+            DatabaseConnection reader(
+                readerRaw,
+                [](sqlite3* readerRaw){
+                    (void)sqlite3_close(readerRaw);
                 }
+            );
+            (void)sqlite3_exec(readerRaw, "PRAGMA query_only = ON", NULL, NULL, NULL);
+            RegisterVectorFunctions(readerRaw);
+            for (const auto& userFunction: userFunctions) {
+                (void)RegisterUserFunction(readerRaw, userFunction);
+            }
+            return reader;
+        }
 
-                case Value::Type::Integer: {
-                    return Value((intmax_t)sqlite3_column_int64(statement, index));
+        /**
+         * Start a read transaction on the given connection, pinned to
+         * the latest state of the database committed through the main
+         * connection.
+         *
+         * @param[in] reader
+         *     This is the connection on which to start the transaction.
+         *
+         * @return
+         *     An indication of whether or not the read transaction
+         *     was started successfully is returned.
+         */
+        bool BeginRead(sqlite3* reader) {
+#ifdef SQLITE_ENABLE_SNAPSHOT
+            // Pin the reader to exactly what the main connection sees,
+            // which requires the main connection to have a read
+            // transaction open while the snapshot is taken.
+            sqlite3_snapshot* snapshot = nullptr;
+            if (sqlite3_get_autocommit(db.get()) != 0) {
+                if (
+                    sqlite3_exec(
+                        db.get(),
+                        "BEGIN; SELECT COUNT(*) FROM sqlite_master",
+                        NULL,
+                        NULL,
+                        NULL
+                    ) == SQLITE_OK
+                ) {
+                    (void)sqlite3_snapshot_get(db.get(), "main", &snapshot);
                 }
-
-                case Value::Type::Real: {
-                    return Value(sqlite3_column_double(statement, index));
+                (void)sqlite3_exec(db.get(), "COMMIT", NULL, NULL, NULL);
+            }
+            if (sqlite3_exec(reader, "BEGIN", NULL, NULL, NULL) != SQLITE_OK) {
+                if (snapshot != nullptr) {
+                    sqlite3_snapshot_free(snapshot);
                 }
-
-                case Value::Type::Boolean: {
-                    return Value(sqlite3_column_int(statement, index) != 0);
+                return false;
+            }
+            if (snapshot != nullptr) {
+                const auto openResult = sqlite3_snapshot_open(reader, "main", snapshot);
+                sqlite3_snapshot_free(snapshot);
+                if (openResult == SQLITE_OK) {
+                    return true;
                 }
-
-                default: return Value();
             }
+#else /* not SQLITE_ENABLE_SNAPSHOT */
+            if (sqlite3_exec(reader, "BEGIN", NULL, NULL, NULL) != SQLITE_OK) {
+                return false;
+            }
+#endif /* SQLITE_ENABLE_SNAPSHOT */
+            // A deferred transaction only pins the state of the database
+            // once something is read, so read something now.
+            if (
+                sqlite3_exec(
+                    reader,
+                    "SELECT COUNT(*) FROM sqlite_master",
+                    NULL,
+                    NULL,
+                    NULL
+                ) != SQLITE_OK
+            ) {
+                (void)sqlite3_exec(reader, "ROLLBACK", NULL, NULL, NULL);
+                return false;
+            }
+            return true;
         }
 
-        virtual void Reset() override {
-            (void)sqlite3_reset(statement);
+        /**
+         * Close the database connection, releasing everything
+         * which refers to it.
+         *
+         * @param[in] optimize
+         *     This indicates whether or not to refresh planner statistics
+         *     first, if they're kept up to date automatically.
+         */
+        void Close(bool optimize = true) {
+            if (
+                optimize
+                && autoOptimizer->enabled
+            ) {
+                autoOptimizer->Optimize();
+            }
+            autoOptimizer->SetConnection(nullptr);
+            memoryMonitor->SetConnection(nullptr);
+            readerPool->Clear();
+            walMode = false;
+            pageCacheWarmer.Stop();
+            if (!tableReadCounts->empty()) {
+                hotTables = RankTablesByReads();
+                tableReadCounts->clear();
+            }
+            checkpointScheduler.Stop();
+            DropSession();
+            if (cache != nullptr) {
+                cache->SetConnection(nullptr);
+            }
+            DetachHooks();
+            db = nullptr;
         }
 
-        virtual StepStatementResults Step() override {
-            StepStatementResults results;
-            switch (sqlite3_step(statement)) {
-                case SQLITE_DONE: {
-                    results.done = true;
-                } break;
-
-                case SQLITE_ROW: {
-                    results.done = false;
-                } break;
-
-                default: {
-                    results.done = true;
-                    results.error = GetLastDatabaseError(db);
-                } break;
+        /**
+         * Remove the functions which SQLite calls back with a pointer
+         * to this object, since statements may keep the database
+         * connection open after this object is gone.
+         */
+        void DetachHooks() {
+            if (db == nullptr) {
+                return;
             }
-            return results;
+            const auto dbRaw = db.get();
+            (void)sqlite3_update_hook(dbRaw, NULL, NULL);
+            (void)sqlite3_rollback_hook(dbRaw, NULL, NULL);
+            (void)sqlite3_commit_hook(dbRaw, NULL, NULL);
+            (void)sqlite3_wal_autocheckpoint(dbRaw, DEFAULT_WAL_AUTOCHECKPOINT);
         }
-    };
-
-}
-
-namespace DatabaseAbstractions {
-
-    // Here we implement what we specified we would have in our interface.
-    // This contains our private properties.
-    struct SQLiteDatabase::Impl {
-        // Properties
-
-        std::string filePath;
-        DatabaseConnection db;
-
-        // Methods
 
+        /**
+         * Stop recording changes made to the database, if a changeset
+         * is being recorded.  This needs to be done before the
+         * database connection is closed.
+         */
+        void DropSession() {
+#if defined(SQLITE_ENABLE_SESSION) && defined(SQLITE_ENABLE_PREUPDATE_HOOK)
+            session = nullptr;
+#endif /* SQLITE_ENABLE_SESSION && SQLITE_ENABLE_PREUPDATE_HOOK */
+        }
     };
 
-    SQLiteDatabase::~SQLiteDatabase() noexcept = default;
+    SQLiteDatabase::~SQLiteDatabase() noexcept {
+        // The instance may have been moved from, leaving it with no Impl.
+        if (
+            (impl_ != nullptr)
+            && impl_->autoOptimizer->enabled
+        ) {
+            impl_->autoOptimizer->Optimize();
+        }
+    }
+
     SQLiteDatabase::SQLiteDatabase(SQLiteDatabase&&) noexcept = default;
     SQLiteDatabase& SQLiteDatabase::operator=(SQLiteDatabase&&) noexcept = default;
 
@@ -216,9 +2826,31 @@ namespace DatabaseAbstractions {
     }
 
     bool SQLiteDatabase::Open(const std::string& filePath) {
+        return Open(filePath, OpenOptions());
+    }
+
+    bool SQLiteDatabase::Open(
+        const std::string& filePath,
+        const OpenOptions& options
+    ) {
+        impl_->Close();
         impl_->filePath = filePath;
+        impl_->openOptions = options;
+        const char* vfsName = (
+            options.useIoUring
+            ? RegisterUringVfs()
+            : nullptr
+        );
+        impl_->usingIoUring = (vfsName != nullptr);
         sqlite3* dbRaw;
-        if (sqlite3_open(filePath.c_str(), &dbRaw) != SQLITE_OK) {
+        if (
+            sqlite3_open_v2(
+                filePath.c_str(),
+                &dbRaw,
+                SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE,
+                vfsName
+            ) != SQLITE_OK
+        ) {
             (void)sqlite3_close(dbRaw);
             return false;
         }
@@ -228,65 +2860,594 @@ namespace DatabaseAbstractions {
                 (void)sqlite3_close(dbRaw);
             }
         );
+        (void)sqlite3_update_hook(dbRaw, Impl::OnUpdate, impl_.get());
+        (void)sqlite3_rollback_hook(dbRaw, Impl::OnRollback, impl_.get());
+        (void)sqlite3_commit_hook(dbRaw, Impl::OnCommit, impl_.get());
+        impl_->interruption->Attach(dbRaw);
+        impl_->memoryMonitor->SetConnection(dbRaw);
+        impl_->autoOptimizer->SetConnection(dbRaw);
+        RegisterVectorFunctions(dbRaw);
+        for (const auto& userFunction: impl_->userFunctions) {
+            (void)RegisterUserFunction(dbRaw, userFunction);
+        }
+        for (const auto& virtualTable: impl_->virtualTables) {
+            (void)RegisterVirtualTable(dbRaw, virtualTable.first, virtualTable.second);
+        }
+        if (
+            options.incrementalVacuum
+            && (impl_->QueryInteger("PRAGMA page_count") == 0)
+        ) {
+            (void)sqlite3_exec(dbRaw, "PRAGMA auto_vacuum = INCREMENTAL", NULL, NULL, NULL);
+        }
+        if (
+            impl_->checkpointSchedulerEnabled
+            && !impl_->StartCheckpointScheduler()
+        ) {
+            impl_->checkpointSchedulerEnabled = false;
+        }
+        if (impl_->warmUpOptions.byteBudget > 0) {
+            impl_->pageCacheWarmer.Start(
+                filePath,
+                impl_->hotTables,
+                impl_->warmUpOptions.byteBudget,
+                dbRaw
+            );
+        }
+        if (impl_->cache != nullptr) {
+            impl_->cache->SetConnection(impl_->db);
+        }
+        return true;
+    }
+
+    bool SQLiteDatabase::IsUsingIoUring() const {
+        return impl_->usingIoUring;
+    }
+
+    bool SQLiteDatabase::BeginChangeset() {
+        impl_->DropSession();
+#if defined(SQLITE_ENABLE_SESSION) && defined(SQLITE_ENABLE_PREUPDATE_HOOK)
+        sqlite3_session* sessionRaw;
+        if (
+            sqlite3session_create(
+                impl_->db.get(),
+                "main",
+                &sessionRaw
+            ) != SQLITE_OK
+        ) {
+            return false;
+        }
+        Session session(
+            sessionRaw,
+            [](sqlite3_session* sessionRaw){
+                sqlite3session_delete(sessionRaw);
+            }
+        );
+        if (sqlite3session_attach(sessionRaw, NULL) != SQLITE_OK) {
+            return false;
+        }
+        impl_->session = std::move(session);
+        return true;
+#else /* not SQLITE_ENABLE_SESSION && SQLITE_ENABLE_PREUPDATE_HOOK */
+        return false;
+#endif /* SQLITE_ENABLE_SESSION && SQLITE_ENABLE_PREUPDATE_HOOK */
+    }
+
+    Blob SQLiteDatabase::EndChangeset() {
+        Blob changeset;
+#if defined(SQLITE_ENABLE_SESSION) && defined(SQLITE_ENABLE_PREUPDATE_HOOK)
+        if (impl_->session == nullptr) {
+            return changeset;
+        }
+        int size;
+        void* changesetRaw;
+        if (
+            sqlite3session_changeset(
+                impl_->session.get(),
+                &size,
+                &changesetRaw
+            ) == SQLITE_OK
+        ) {
+            changeset.assign(
+                (const uint8_t*)changesetRaw,
+                (const uint8_t*)changesetRaw + size
+            );
+            sqlite3_free(changesetRaw);
+        }
+        impl_->DropSession();
+#endif /* SQLITE_ENABLE_SESSION && SQLITE_ENABLE_PREUPDATE_HOOK */
+        return changeset;
+    }
+
+    std::string SQLiteDatabase::ApplyChangeset(
+        const Blob& changeset,
+        ChangesetConflictDelegate conflictDelegate
+    ) {
+#if defined(SQLITE_ENABLE_SESSION) && defined(SQLITE_ENABLE_PREUPDATE_HOOK)
+        ApplyChangesetContext context;
+        context.conflictDelegate = std::move(conflictDelegate);
+        const auto result = sqlite3changeset_apply(
+            impl_->db.get(),
+            (int)changeset.size(),
+            (void*)changeset.data(),
+            NULL,
+            OnChangesetConflict,
+            &context
+        );
+        if (impl_->cache != nullptr) {
+            impl_->cache->InvalidateAll();
+        }
+        if (result == SQLITE_OK) {
+            return "";
+        } else if (result == SQLITE_ABORT) {
+            return "Changeset application aborted due to conflict";
+        } else {
+            return GetLastDatabaseError(impl_->db);
+        }
+#else /* not SQLITE_ENABLE_SESSION && SQLITE_ENABLE_PREUPDATE_HOOK */
+        (void)changeset;
+        (void)conflictDelegate;
+        return "SQLite session extension not available";
+#endif /* SQLITE_ENABLE_SESSION && SQLITE_ENABLE_PREUPDATE_HOOK */
+    }
+
+    Blob SQLiteDatabase::InvertChangeset(const Blob& changeset) {
+        Blob inverse;
+#if defined(SQLITE_ENABLE_SESSION) && defined(SQLITE_ENABLE_PREUPDATE_HOOK)
+        int size;
+        void* inverseRaw;
+        if (
+            sqlite3changeset_invert(
+                (int)changeset.size(),
+                changeset.data(),
+                &size,
+                &inverseRaw
+            ) == SQLITE_OK
+        ) {
+            inverse.assign(
+                (const uint8_t*)inverseRaw,
+                (const uint8_t*)inverseRaw + size
+            );
+            sqlite3_free(inverseRaw);
+        }
+#else /* not SQLITE_ENABLE_SESSION && SQLITE_ENABLE_PREUPDATE_HOOK */
+        (void)changeset;
+#endif /* SQLITE_ENABLE_SESSION && SQLITE_ENABLE_PREUPDATE_HOOK */
+        return inverse;
+    }
+
+    Blob SQLiteDatabase::ConcatenateChangesets(const std::vector< Blob >& changesets) {
+        Blob combined;
+#if defined(SQLITE_ENABLE_SESSION) && defined(SQLITE_ENABLE_PREUPDATE_HOOK)
+        for (const auto& changeset: changesets) {
+            int size;
+            void* combinedRaw;
+            if (
+                sqlite3changeset_concat(
+                    (int)combined.size(),
+                    (void*)combined.data(),
+                    (int)changeset.size(),
+                    (void*)changeset.data(),
+                    &size,
+                    &combinedRaw
+                ) != SQLITE_OK
+            ) {
+                return Blob();
+            }
+            combined.assign(
+                (const uint8_t*)combinedRaw,
+                (const uint8_t*)combinedRaw + size
+            );
+            sqlite3_free(combinedRaw);
+        }
+#else /* not SQLITE_ENABLE_SESSION && SQLITE_ENABLE_PREUPDATE_HOOK */
+        (void)changesets;
+#endif /* SQLITE_ENABLE_SESSION && SQLITE_ENABLE_PREUPDATE_HOOK */
+        return combined;
+    }
+
+    void SQLiteDatabase::EnableQueryCache(size_t memoryBudget) {
+        if (memoryBudget == 0) {
+            if (impl_->cache != nullptr) {
+                impl_->cache->SetConnection(nullptr);
+                impl_->cache = nullptr;
+                impl_->memoryMonitor->SetQueryCache(nullptr);
+            }
+            return;
+        }
+        if (impl_->cache != nullptr) {
+            impl_->cache->SetConnection(nullptr);
+        }
+        impl_->cache = std::make_shared< QueryResultCache >(memoryBudget);
+        impl_->cache->SetConnection(impl_->db);
+        impl_->memoryMonitor->SetQueryCache(impl_->cache);
+    }
+
+    auto SQLiteDatabase::GetQueryCacheStatistics() const -> QueryCacheStatistics {
+        if (impl_->cache == nullptr) {
+            return QueryCacheStatistics();
+        }
+        return impl_->cache->GetStatistics();
+    }
+
+    size_t SQLiteDatabase::ReclaimFreePages(size_t byteBudget) {
+        const auto pageSize = (size_t)impl_->QueryInteger("PRAGMA page_size");
+        if (
+            (pageSize == 0)
+            || (byteBudget < pageSize)
+        ) {
+            return 0;
+        }
+        const auto freeBytesBefore = impl_->GetFreeBytes();
+        const auto vacuumStatement = (
+            "PRAGMA incremental_vacuum("
+            + std::to_string(byteBudget / pageSize)
+            + ")"
+        );
+        (void)sqlite3_exec(impl_->db.get(), vacuumStatement.c_str(), NULL, NULL, NULL);
+        const auto freeBytesAfter = impl_->GetFreeBytes();
+        const auto bytesReclaimed = (
+            (freeBytesAfter < freeBytesBefore)
+            ? freeBytesBefore - freeBytesAfter
+            : 0
+        );
+        impl_->compactionStatistics.bytesReclaimed += bytesReclaimed;
+        return bytesReclaimed;
+    }
+
+    void SQLiteDatabase::SetCompactSnapshots(bool compactSnapshots) {
+        impl_->compactSnapshots = compactSnapshots;
+    }
+
+    auto SQLiteDatabase::GetCompactionStatistics() const -> CompactionStatistics {
+        auto statistics = impl_->compactionStatistics;
+        statistics.freeBytes = impl_->GetFreeBytes();
+        return statistics;
+    }
+
+    bool SQLiteDatabase::StartCheckpointScheduler(const CheckpointOptions& options) {
+        StopCheckpointScheduler();
+        impl_->checkpointOptions = options;
+        if (!impl_->StartCheckpointScheduler()) {
+            StopCheckpointScheduler();
+            return false;
+        }
+        impl_->checkpointSchedulerEnabled = true;
         return true;
     }
 
+    void SQLiteDatabase::StopCheckpointScheduler() {
+        impl_->checkpointSchedulerEnabled = false;
+        impl_->checkpointScheduler.Stop();
+        if (impl_->db != nullptr) {
+            (void)sqlite3_wal_autocheckpoint(impl_->db.get(), DEFAULT_WAL_AUTOCHECKPOINT);
+        }
+    }
+
+    auto SQLiteDatabase::GetCheckpointStatistics() const -> CheckpointStatistics {
+        return impl_->checkpointScheduler.GetStatistics();
+    }
+
+    void SQLiteDatabase::EnableWarmUp(const WarmUpOptions& options) {
+        impl_->warmUpOptions = options;
+    }
+
+    void SQLiteDatabase::SetHotTables(const std::vector< std::string >& tables) {
+        impl_->hotTables = tables;
+        impl_->tableReadCounts->clear();
+    }
+
+    std::vector< std::string > SQLiteDatabase::GetHotTables() const {
+        if (impl_->tableReadCounts->empty()) {
+            return impl_->hotTables;
+        }
+        return impl_->RankTablesByReads();
+    }
+
+    void SQLiteDatabase::WaitForWarmUp() {
+        impl_->pageCacheWarmer.Wait();
+    }
+
+    auto SQLiteDatabase::GetWarmUpStatistics() const -> WarmUpStatistics {
+        return impl_->pageCacheWarmer.GetStatistics();
+    }
+
+    void SQLiteDatabase::EnableAutoOptimize(const OptimizeOptions& options) {
+        impl_->autoOptimizer->enabled = true;
+        impl_->autoOptimizer->options = options;
+        impl_->autoOptimizer->ResetChanges();
+    }
+
+    void SQLiteDatabase::DisableAutoOptimize() {
+        impl_->autoOptimizer->enabled = false;
+        impl_->autoOptimizer->ResetChanges();
+    }
+
+    void SQLiteDatabase::Optimize() {
+        impl_->autoOptimizer->Optimize();
+    }
+
+    bool SQLiteDatabase::IsOptimizeDue() const {
+        return impl_->autoOptimizer->due;
+    }
+
+    auto SQLiteDatabase::GetOptimizeStatistics() const -> OptimizeStatistics {
+        return impl_->autoOptimizer->statistics;
+    }
+
+    std::string SQLiteDatabase::CreateScalarFunction(
+        const std::string& name,
+        int argumentCount,
+        ScalarFunction function
+    ) {
+        const auto userFunction = std::make_shared< UserFunction >();
+        userFunction->name = name;
+        userFunction->argumentCount = argumentCount;
+        userFunction->scalar = std::move(function);
+        return impl_->AddUserFunction(userFunction);
+    }
+
+    std::string SQLiteDatabase::CreateAggregateFunction(
+        const std::string& name,
+        int argumentCount,
+        AggregateFactory factory
+    ) {
+        const auto userFunction = std::make_shared< UserFunction >();
+        userFunction->name = name;
+        userFunction->argumentCount = argumentCount;
+        userFunction->aggregate = std::move(factory);
+        return impl_->AddUserFunction(userFunction);
+    }
+
+    std::string SQLiteDatabase::CreateWindowFunction(
+        const std::string& name,
+        int argumentCount,
+        AggregateFactory factory
+    ) {
+        const auto userFunction = std::make_shared< UserFunction >();
+        userFunction->name = name;
+        userFunction->argumentCount = argumentCount;
+        userFunction->aggregate = std::move(factory);
+        userFunction->window = true;
+        return impl_->AddUserFunction(userFunction);
+    }
+
+    void SQLiteDatabase::SetTimeout(std::chrono::milliseconds timeout) {
+        std::lock_guard< std::mutex > lock(impl_->interruption->mutex);
+        impl_->interruption->timeout = timeout;
+    }
+
+    void SQLiteDatabase::SetDeadline(std::chrono::steady_clock::time_point deadline) {
+        std::lock_guard< std::mutex > lock(impl_->interruption->mutex);
+        impl_->interruption->hasDeadline = true;
+        impl_->interruption->deadline = deadline;
+    }
+
+    void SQLiteDatabase::ClearDeadline() {
+        std::lock_guard< std::mutex > lock(impl_->interruption->mutex);
+        impl_->interruption->hasDeadline = false;
+    }
+
+    void SQLiteDatabase::Cancel() {
+        impl_->interruption->Cancel();
+    }
+
+    std::string SQLiteDatabase::CreateVirtualTable(
+        const std::string& name,
+        std::shared_ptr< VirtualTable > table
+    ) {
+        if (impl_->db != nullptr) {
+            const auto error = RegisterVirtualTable(impl_->db.get(), name, table);
+            if (!error.empty()) {
+                return error;
+            }
+        }
+        impl_->virtualTables[name] = std::move(table);
+        return "";
+    }
+
     BuildStatementResults SQLiteDatabase::BuildStatement(
         const std::string& statement
     ) {
         BuildStatementResults results;
         sqlite3_stmt* statementRaw;
-        if (
-            sqlite3_prepare_v2(
-                impl_->db.get(),
-                statement.c_str(),
-                (int)(statement.length() + 1), // sqlite wants count to include the null
-                &statementRaw,
-                NULL
-            )
-            == SQLITE_OK
-        ) {
+        StatementAccess access;
+        const auto needStatementAccess = impl_->NeedStatementAccess();
+        if (needStatementAccess) {
+            (void)sqlite3_set_authorizer(impl_->db.get(), OnAuthorize, &access);
+        }
+        const auto prepareResult = sqlite3_prepare_v2(
+            impl_->db.get(),
+            statement.c_str(),
+            (int)(statement.length() + 1), // sqlite wants count to include the null
+            &statementRaw,
+            NULL
+        );
+        if (needStatementAccess) {
+            (void)sqlite3_set_authorizer(impl_->db.get(), NULL, NULL);
+        }
+        if (prepareResult == SQLITE_OK) {
             auto managedStatement = std::make_shared< SQliteStatement >(
                 statementRaw,
                 impl_->db
             );
+            if (
+                (impl_->warmUpOptions.byteBudget > 0)
+                && impl_->warmUpOptions.trackHotTables
+            ) {
+                for (const auto& table: access.tablesRead) {
+                    if (
+                        (table.compare(0, 7, "sqlite_") != 0)
+                        && !impl_->IsVirtualTable(table)
+                    ) {
+                        managedStatement->countedTables.push_back(table);
+                    }
+                }
+                managedStatement->tableReadCounts = impl_->tableReadCounts;
+            }
+            managedStatement->interruption = impl_->interruption;
+            managedStatement->memoryMonitor = impl_->memoryMonitor;
+            if (impl_->cache != nullptr) {
+                managedStatement->cache = impl_->cache;
+                managedStatement->readOnly = (sqlite3_stmt_readonly(statementRaw) != 0);
+                managedStatement->cacheable = (
+                    managedStatement->readOnly
+                    && !access.changesEverything
+                    && !access.nondeterministic
+                    && !impl_->ReadsVirtualTable(access)
+                    && (sqlite3_column_count(statementRaw) > 0)
+                );
+                managedStatement->access = std::move(access);
+            }
             results.statement = std::move(managedStatement);
         } else {
             results.error = GetLastDatabaseError(impl_->db);
         }
+        impl_->memoryMonitor->Check();
         return results;
     }
 
     std::string SQLiteDatabase::ExecuteStatement(const std::string& statement) {
-        char* errmsg;
+        return ExecuteStatement(statement, std::chrono::milliseconds(0));
+    }
+
+    std::string SQLiteDatabase::ExecuteStatement(
+        const std::string& statement,
+        std::chrono::milliseconds timeout
+    ) {
+        if (!impl_->interruption->BeginCall(timeout)) {
+            return impl_->interruption->GetInterruptedError();
+        }
+        char* errmsg = NULL;
+        StatementAccess access;
+        if (impl_->cache != nullptr) {
+            (void)sqlite3_set_authorizer(impl_->db.get(), OnAuthorize, &access);
+        }
+        const auto result = sqlite3_exec(
+            impl_->db.get(),
+            statement.c_str(),
+            NULL,
+            NULL,
+            &errmsg
+        );
+        impl_->interruption->EndCall();
+        if (impl_->cache != nullptr) {
+            (void)sqlite3_set_authorizer(impl_->db.get(), NULL, NULL);
+            InvalidateQueryCache(*impl_->cache, access, true);
+        }
+        std::string error;
+        if (result == SQLITE_INTERRUPT) {
+            error = impl_->interruption->GetInterruptedError();
+        } else if (result != SQLITE_OK) {
+            // Errors other than SQLITE_ERROR, such as running out of
+            // memory under the hard heap limit, may not come with
+            // a message of their own.
+            error = (
+                (errmsg == NULL)
+                ? sqlite3_errstr(result)
+                : errmsg
+            );
+        }
+        sqlite3_free(errmsg);
+        impl_->memoryMonitor->Check();
+        return error;
+    }
+
+    auto SQLiteDatabase::GetMemoryUsage() const -> MemoryUsage {
+        return impl_->memoryMonitor->Measure();
+    }
+
+    void SQLiteDatabase::SetMemoryLimits(
+        const MemoryLimits& limits,
+        MemoryPressureDelegate onPressure
+    ) {
+        impl_->memoryMonitor->SetLimits(limits, std::move(onPressure));
+    }
+
+    StepStatementResults SQLiteDatabase::StepBatch(
+        PreparedStatement& statement,
+        const std::vector< Value::Type >& columnTypes,
+        size_t maxRows,
+        ColumnBatch& batch
+    ) {
+        const auto sqliteStatement = dynamic_cast< SQliteStatement* >(&statement);
+        if (sqliteStatement == nullptr) {
+            ResetBatch(batch, columnTypes, 0);
+            StepStatementResults results;
+            results.done = true;
+            results.error = "statement not built by SQLiteDatabase";
+            return results;
+        }
+        return sqliteStatement->StepBatch(columnTypes, maxRows, batch);
+    }
+
+    auto SQLiteDatabase::CreateReadView() -> std::shared_ptr< ReadView > {
         if (
-            sqlite3_exec(
-                impl_->db.get(),
-                statement.c_str(),
-                NULL,
-                NULL,
-                &errmsg
-            ) == SQLITE_ERROR
+            (impl_->db == nullptr)
+            || !impl_->EnableWalMode()
         ) {
-            std::string error(errmsg);
-            sqlite3_free(errmsg);
-            return error;
-        } else {
-            return "";
+            return nullptr;
+        }
+        uint64_t readerGeneration;
+        auto reader = impl_->readerPool->Take(readerGeneration);
+        if (reader == nullptr) {
+            reader = impl_->OpenReader();
+            if (reader == nullptr) {
+                return nullptr;
+            }
+        }
+        if (!impl_->BeginRead(reader.get())) {
+            return nullptr;
         }
+        const auto view = std::make_shared< SQLiteReadView >();
+        view->interruption = std::make_shared< Interruption >();
+        view->interruption->Follow(impl_->interruption);
+        view->reader = LeaseReader(
+            impl_->readerPool,
+            std::move(reader),
+            readerGeneration,
+            view->interruption
+        );
+        return view;
     }
 
     Blob SQLiteDatabase::CreateSnapshot() {
         sqlite3_int64 size;
+        if (impl_->compactSnapshots) {
+            Blob snapshot;
+            if (impl_->CreateCompactedSnapshot(snapshot)) {
+                size = (sqlite3_int64)(
+                    impl_->QueryInteger("PRAGMA page_count")
+                    * impl_->QueryInteger("PRAGMA page_size")
+                );
+                if ((size_t)size > snapshot.size()) {
+                    impl_->compactionStatistics.snapshotBytesOmitted += (size_t)size - snapshot.size();
+                }
+                const SnapshotBytesHeld snapshotBytesHeld(impl_->memoryMonitor, snapshot.size());
+                impl_->memoryMonitor->Check();
+                return snapshot;
+            }
+        }
         const auto serialization = sqlite3_serialize(impl_->db.get(), "main", &size, 0);
-        return Blob(
+        Blob snapshot(
             serialization,
             serialization + size
         );
+        const SnapshotBytesHeld snapshotBytesHeld(impl_->memoryMonitor, snapshot.size());
+        impl_->memoryMonitor->Check();
+        sqlite3_free(serialization);
+        return snapshot;
     }
 
     std::string SQLiteDatabase::InstallSnapshot(const Blob& blob) {
-        impl_->db = nullptr;
+        // A read view's connection would replay its write-ahead log over
+        // the installed snapshot, so the snapshot can't be installed
+        // while any are in use.
+        if (impl_->readerPool->GetLeasedCount() > 0) {
+            return "Unable to install snapshot while read views are in use";
+        }
+        const SnapshotBytesHeld snapshotBytesHeld(impl_->memoryMonitor, blob.size());
+        impl_->memoryMonitor->Check();
+        impl_->Close(false);
         SystemAbstractions::File dbFile(impl_->filePath);
         if (!dbFile.OpenReadWrite()) {
             return "Unable to open the database file for writing";
@@ -298,9 +3459,12 @@ namespace DatabaseAbstractions {
             return "Unable to set the end of the database file";
         }
         dbFile.Close();
-        if (!Open(impl_->filePath)) {
+        if (!Open(impl_->filePath, impl_->openOptions)) {
             return "Unable to open database after installing snapshot";
         }
+        if (impl_->autoOptimizer->enabled) {
+            impl_->autoOptimizer->AnalyzeUnanalyzedTables();
+        }
         return "";
     }
 
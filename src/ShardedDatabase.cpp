@@ -0,0 +1,576 @@
+/**
+ * @file ShardedDatabase.cpp
+ *
+ * This module contains the implementation of the
+ * DatabaseAbstractions::ShardedDatabase class.
+ */
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <math.h>
+#include <mutex>
+#include <SQLiteAbstractions/ShardedDatabase.hpp>
+#include <stdint.h>
+#include <thread>
+
+namespace {
+
+    using DatabaseAbstractions::ShardedDatabase;
+    using DatabaseAbstractions::SQLiteDatabase;
+    using DatabaseAbstractions::Value;
+
+    /**
+     * This is the starting value of the FNV-1a hash used to
+     * partition keys among shards.
+     */
+    constexpr uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL;
+
+    /**
+     * This is the multiplier of the FNV-1a hash used to
+     * partition keys among shards.
+     */
+    constexpr uint64_t FNV_PRIME = 1099511628211ULL;
+
+    /**
+     * Return a string which represents the given key, such that
+     * keys considered equal by SQL are represented the same way.
+     *
+     * @param[in] key
+     *     This is the key to represent.
+     *
+     * @return
+     *     A string representing the key is returned.
+     */
+    std::string MakeKeyString(const Value& key) {
+        switch (key.GetType()) {
+            case Value::Type::Text: {
+                return "T" + (const std::string&)key;
+            }
+
+            case Value::Type::Integer: {
+                return "I" + std::to_string((intmax_t)key);
+            }
+
+            case Value::Type::Real: {
+                const auto keyAsDouble = (double)key;
+                if (isnan(keyAsDouble)) {
+                    // SQLite stores NaN as NULL.
+                    return "N";
+                }
+                if (
+                    (keyAsDouble >= (double)INTMAX_MIN)
+                    && (keyAsDouble < -(double)INTMAX_MIN)
+                ) {
+                    const auto keyAsInteger = (intmax_t)keyAsDouble;
+                    if ((double)keyAsInteger == keyAsDouble) {
+                        return "I" + std::to_string(keyAsInteger);
+                    }
+                }
+                std::string keyString("R");
+                keyString.append((const char*)&keyAsDouble, sizeof(keyAsDouble));
+                return keyString;
+            }
+
+            case Value::Type::Boolean: {
+                return (bool)key ? "I1" : "I0";
+            }
+
+            default: {
+                return "N";
+            }
+        }
+    }
+
+    /**
+     * Bind the given values to the parameters of the given statement.
+     *
+     * @param[in] statement
+     *     This is the statement whose parameters to bind.
+     *
+     * @param[in] parameters
+     *     These are the values to bind to the parameters.
+     */
+    void BindParameters(
+        DatabaseAbstractions::PreparedStatement& statement,
+        const std::vector< Value >& parameters
+    ) {
+        for (size_t i = 0; i < parameters.size(); ++i) {
+            statement.BindParameter((int)i, parameters[i]);
+        }
+    }
+
+    /**
+     * Execute the given SQL statements on the given database.
+     *
+     * @param[in] database
+     *     This is the database on which to execute the statements.
+     *
+     * @param[in] statement
+     *     This is the text of the SQL statements to execute.
+     *
+     * @param[in] parameters
+     *     These are the values to bind to the parameters of the statement.
+     *
+     * @return
+     *     An error message is returned if the statements could not
+     *     be executed.  Otherwise, an empty string is returned.
+     */
+    std::string Execute(
+        SQLiteDatabase& database,
+        const std::string& statement,
+        const std::vector< Value >& parameters
+    ) {
+        if (parameters.empty()) {
+            return database.ExecuteStatement(statement);
+        }
+        const auto buildResults = database.BuildStatement(statement);
+        if (buildResults.statement == nullptr) {
+            return buildResults.error;
+        }
+        BindParameters(*buildResults.statement, parameters);
+        for (;;) {
+            const auto stepResults = buildResults.statement->Step();
+            if (stepResults.done) {
+                return stepResults.error;
+            }
+        }
+    }
+
+    /**
+     * Run the given query on the given database.
+     *
+     * @param[in] database
+     *     This is the database on which to run the query.
+     *
+     * @param[in] statement
+     *     This is the text of the query.
+     *
+     * @param[in] columnTypes
+     *     These are the types of the columns produced by the query.
+     *
+     * @param[in] parameters
+     *     These are the values to bind to the parameters of the query.
+     *
+     * @return
+     *     The results of the query are returned.
+     */
+    ShardedDatabase::QueryResults Query(
+        SQLiteDatabase& database,
+        const std::string& statement,
+        const std::vector< Value::Type >& columnTypes,
+        const std::vector< Value >& parameters
+    ) {
+        ShardedDatabase::QueryResults results;
+        const auto buildResults = database.BuildStatement(statement);
+        if (buildResults.statement == nullptr) {
+            results.error = buildResults.error;
+            return results;
+        }
+        BindParameters(*buildResults.statement, parameters);
+        for (;;) {
+            const auto stepResults = buildResults.statement->Step();
+            if (stepResults.done) {
+                results.error = stepResults.error;
+                break;
+            }
+            ShardedDatabase::Row row;
+            row.reserve(columnTypes.size());
+            for (size_t i = 0; i < columnTypes.size(); ++i) {
+                row.push_back(buildResults.statement->FetchColumn((int)i, columnTypes[i]));
+            }
+            results.rows.push_back(std::move(row));
+        }
+        return results;
+    }
+
+    /**
+     * Return the given error message, annotated with the index of the
+     * shard which reported it.
+     *
+     * @param[in] shard
+     *     This is the index of the shard which reported the error.
+     *
+     * @param[in] error
+     *     This is the error message reported by the shard.
+     *
+     * @return
+     *     The annotated error message is returned.
+     */
+    std::string MakeShardError(size_t shard, const std::string& error) {
+        return "shard " + std::to_string(shard) + ": " + error;
+    }
+
+    /**
+     * Return an error message which names every shard which
+     * reported an error, along with the error it reported.
+     *
+     * @param[in] errors
+     *     These are the error messages reported by the shards,
+     *     in order of shard, with an empty string for each shard
+     *     which succeeded.
+     *
+     * @return
+     *     The combined error message is returned, or an empty
+     *     string if no shard reported an error.
+     */
+    std::string MakeShardErrors(const std::vector< std::string >& errors) {
+        std::string combinedError;
+        for (size_t i = 0; i < errors.size(); ++i) {
+            if (errors[i].empty()) {
+                continue;
+            }
+            if (!combinedError.empty()) {
+                combinedError += "; ";
+            }
+            combinedError += MakeShardError(i, errors[i]);
+        }
+        return combinedError;
+    }
+
+    /**
+     * This holds the database of one shard, along with the thread
+     * which does all work on it.
+     */
+    struct Shard {
+        // Properties
+
+        /**
+         * This is the database of the shard.
+         */
+        SQLiteDatabase database;
+
+        /**
+         * This is the thread which does all work on the database.
+         */
+        std::thread worker;
+
+        /**
+         * This is used to synchronize access to the properties below.
+         */
+        std::mutex mutex;
+
+        /**
+         * This is used to wake up the thread when there is work to do.
+         */
+        std::condition_variable wakeCondition;
+
+        /**
+         * This is the work waiting to be done by the thread.
+         */
+        std::deque< std::function< void() > > tasks;
+
+        /**
+         * This indicates whether or not the thread should stop.
+         */
+        bool stop = false;
+
+        // Methods
+
+        /**
+         * This is the instance constructor.  It starts the thread.
+         */
+        Shard() {
+            worker = std::thread(&Shard::Worker, this);
+        }
+
+        /**
+         * This is the instance destructor.  It stops the thread, after
+         * it finishes any work already given to it.
+         */
+        ~Shard() noexcept {
+            {
+                std::lock_guard< std::mutex > lock(mutex);
+                stop = true;
+                wakeCondition.notify_all();
+            }
+            worker.join();
+        }
+
+        /**
+         * Give the thread the given function to run on the database,
+         * returning a future which becomes ready when the function
+         * has been run.
+         *
+         * @param[in] task
+         *     This is the function to run.
+         *
+         * @return
+         *     A future which becomes ready when the function has been
+         *     run, and which holds any exception it throws, is returned.
+         */
+        std::future< void > Post(std::function< void(SQLiteDatabase& database) > task) {
+            const auto promise = std::make_shared< std::promise< void > >();
+            auto future = promise->get_future();
+            std::lock_guard< std::mutex > lock(mutex);
+            tasks.push_back(
+                [this, promise, task]{
+                    try {
+                        task(database);
+                        promise->set_value();
+                    } catch (...) {
+                        promise->set_exception(std::current_exception());
+                    }
+                }
+            );
+            wakeCondition.notify_all();
+            return future;
+        }
+
+        /**
+         * This is the body of the thread.
+         */
+        void Worker() {
+            std::unique_lock< std::mutex > lock(mutex);
+            for (;;) {
+                wakeCondition.wait(
+                    lock,
+                    [this]{
+                        return stop || !tasks.empty();
+                    }
+                );
+                if (tasks.empty()) {
+                    break;
+                }
+                auto task = std::move(tasks.front());
+                tasks.pop_front();
+                lock.unlock();
+                task();
+                lock.lock();
+            }
+        }
+    };
+
+}
+
+namespace DatabaseAbstractions {
+
+    /**
+     * This contains the private properties of a ShardedDatabase instance.
+     */
+    struct ShardedDatabase::Impl {
+        // Properties
+
+        /**
+         * These are the shards of the database.
+         */
+        std::vector< std::unique_ptr< Shard > > shards;
+
+        // Methods
+
+        /**
+         * Run the given function on the threads of all shards in
+         * parallel, and wait for all of them to return.
+         *
+         * @param[in] task
+         *     This is the function to run.
+         */
+        void RunOnAllShards(
+            const std::function< void(size_t shard, SQLiteDatabase& database) >& task
+        ) {
+            std::vector< std::future< void > > futures;
+            for (size_t i = 0; i < shards.size(); ++i) {
+                futures.push_back(
+                    shards[i]->Post(
+                        [i, &task](SQLiteDatabase& database){
+                            task(i, database);
+                        }
+                    )
+                );
+            }
+            for (auto& future: futures) {
+                future.wait();
+            }
+            for (auto& future: futures) {
+                future.get();
+            }
+        }
+    };
+
+    ShardedDatabase::~ShardedDatabase() noexcept = default;
+    ShardedDatabase::ShardedDatabase(ShardedDatabase&&) noexcept = default;
+    ShardedDatabase& ShardedDatabase::operator=(ShardedDatabase&&) noexcept = default;
+
+    ShardedDatabase::ShardedDatabase()
+        : impl_(new Impl())
+    {
+    }
+
+    bool ShardedDatabase::Open(const std::vector< std::string >& filePaths) {
+        Close();
+        for (size_t i = 0; i < filePaths.size(); ++i) {
+            impl_->shards.emplace_back(new Shard());
+        }
+        std::vector< char > opened(filePaths.size(), 0);
+        impl_->RunOnAllShards(
+            [&filePaths, &opened](size_t shard, SQLiteDatabase& database){
+                opened[shard] = database.Open(filePaths[shard]) ? 1 : 0;
+            }
+        );
+        if (std::find(opened.begin(), opened.end(), 0) != opened.end()) {
+            Close();
+            return false;
+        }
+        return !impl_->shards.empty();
+    }
+
+    void ShardedDatabase::Close() {
+        impl_->shards.clear();
+    }
+
+    size_t ShardedDatabase::GetShardCount() const {
+        return impl_->shards.size();
+    }
+
+    size_t ShardedDatabase::GetShardForKey(const Value& key) const {
+        if (impl_->shards.empty()) {
+            return 0;
+        }
+        uint64_t hash = FNV_OFFSET_BASIS;
+        for (auto c: MakeKeyString(key)) {
+            hash ^= (uint8_t)c;
+            hash *= FNV_PRIME;
+        }
+        return (size_t)(hash % impl_->shards.size());
+    }
+
+    bool ShardedDatabase::RunOnShard(
+        size_t shard,
+        const std::function< void(SQLiteDatabase& database) >& task
+    ) {
+        if (shard >= impl_->shards.size()) {
+            return false;
+        }
+        impl_->shards[shard]->Post(task).get();
+        return true;
+    }
+
+    void ShardedDatabase::RunOnAllShards(
+        const std::function< void(size_t shard, SQLiteDatabase& database) >& task
+    ) {
+        impl_->RunOnAllShards(task);
+    }
+
+    std::string ShardedDatabase::ExecuteForKey(
+        const Value& key,
+        const std::string& statement,
+        const std::vector< Value >& parameters
+    ) {
+        if (impl_->shards.empty()) {
+            return "database not open";
+        }
+        std::string error;
+        (void)RunOnShard(
+            GetShardForKey(key),
+            [&error, &statement, &parameters](SQLiteDatabase& database){
+                error = Execute(database, statement, parameters);
+            }
+        );
+        return error;
+    }
+
+    std::string ShardedDatabase::ExecuteOnAllShards(const std::string& statement) {
+        if (impl_->shards.empty()) {
+            return "database not open";
+        }
+        std::vector< std::string > errors(impl_->shards.size());
+        impl_->RunOnAllShards(
+            [&errors, &statement](size_t shard, SQLiteDatabase& database){
+                errors[shard] = database.ExecuteStatement(statement);
+            }
+        );
+        return MakeShardErrors(errors);
+    }
+
+    auto ShardedDatabase::QueryForKey(
+        const Value& key,
+        const std::string& statement,
+        const std::vector< Value::Type >& columnTypes,
+        const std::vector< Value >& parameters
+    ) -> QueryResults {
+        QueryResults results;
+        if (impl_->shards.empty()) {
+            results.error = "database not open";
+            return results;
+        }
+        (void)RunOnShard(
+            GetShardForKey(key),
+            [&results, &statement, &columnTypes, &parameters](SQLiteDatabase& database){
+                results = Query(database, statement, columnTypes, parameters);
+            }
+        );
+        return results;
+    }
+
+    auto ShardedDatabase::QueryAllShards(
+        const std::string& statement,
+        const std::vector< Value::Type >& columnTypes,
+        const std::vector< Value >& parameters,
+        RowOrder order
+    ) -> QueryResults {
+        QueryResults results;
+        if (impl_->shards.empty()) {
+            results.error = "database not open";
+            return results;
+        }
+        std::vector< QueryResults > shardResults(impl_->shards.size());
+        impl_->RunOnAllShards(
+            [&shardResults, &statement, &columnTypes, &parameters](
+                size_t shard,
+                SQLiteDatabase& database
+            ){
+                shardResults[shard] = Query(database, statement, columnTypes, parameters);
+            }
+        );
+        for (size_t i = 0; i < shardResults.size(); ++i) {
+            if (!shardResults[i].error.empty()) {
+                results.error = MakeShardError(i, shardResults[i].error);
+                results.rows.clear();
+                return results;
+            }
+            const auto middle = results.rows.size();
+            results.rows.insert(
+                results.rows.end(),
+                std::make_move_iterator(shardResults[i].rows.begin()),
+                std::make_move_iterator(shardResults[i].rows.end())
+            );
+            if (order != nullptr) {
+                std::inplace_merge(
+                    results.rows.begin(),
+                    results.rows.begin() + middle,
+                    results.rows.end(),
+                    order
+                );
+            }
+        }
+        return results;
+    }
+
+    std::vector< Blob > ShardedDatabase::CreateSnapshots() {
+        std::vector< Blob > snapshots(impl_->shards.size());
+        impl_->RunOnAllShards(
+            [&snapshots](size_t shard, SQLiteDatabase& database){
+                snapshots[shard] = database.CreateSnapshot();
+            }
+        );
+        return snapshots;
+    }
+
+    std::string ShardedDatabase::InstallSnapshots(const std::vector< Blob >& snapshots) {
+        if (snapshots.size() != impl_->shards.size()) {
+            return (
+                "expected " + std::to_string(impl_->shards.size())
+                + " snapshots, got " + std::to_string(snapshots.size())
+            );
+        }
+        std::vector< std::string > errors(impl_->shards.size());
+        impl_->RunOnAllShards(
+            [&errors, &snapshots](size_t shard, SQLiteDatabase& database){
+                errors[shard] = database.InstallSnapshot(snapshots[shard]);
+            }
+        );
+        return MakeShardErrors(errors);
+    }
+
+}
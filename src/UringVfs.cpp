@@ -0,0 +1,1440 @@
+/**
+ * @file UringVfs.cpp
+ *
+ * This module contains the implementation of the io_uring-backed
+ * SQLite virtual file system (VFS).
+ */
+
+#include "UringVfs.hpp"
+
+#include <sqlite3.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define SQLITE_ABSTRACTIONS_HAVE_IO_URING
+#endif
+#endif
+
+#ifdef SQLITE_ABSTRACTIONS_HAVE_IO_URING
+
+#include <algorithm>
+#include <atomic>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <set>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+    /**
+     * This is the name under which the VFS is registered with SQLite.
+     */
+    constexpr const char* VFS_NAME = "io_uring";
+
+    /**
+     * This is the number of entries requested for the submission
+     * queue of the io_uring.
+     */
+    constexpr unsigned RING_ENTRIES = 64;
+
+    /**
+     * This is the number of writes to a file which may be held back
+     * before they're submitted together.
+     */
+    constexpr size_t MAX_PENDING_WRITES = 256;
+
+    /**
+     * This is the number of bytes of writes to a file which may be
+     * held back before they're submitted together.
+     */
+    constexpr size_t MAX_PENDING_BYTES = 4 * 1024 * 1024;
+
+    /**
+     * This is the fewest separate runs of writes to a file worth
+     * submitting through the io_uring.  Fewer are done directly, since
+     * handing them off to the kernel costs more than doing them in
+     * parallel saves.
+     */
+    constexpr size_t MIN_RING_WRITES = 4;
+
+    /**
+     * This is the size of the header SQLite writes ahead of each
+     * page in the write-ahead log.
+     */
+    constexpr int WAL_FRAME_HEADER_SIZE = 24;
+
+    /**
+     * This is the number of sequential reads of the database after
+     * which further pages are prefetched.
+     */
+    constexpr int SEQUENTIAL_READS_BEFORE_PREFETCH = 2;
+
+    /**
+     * This is the number of bytes of the database prefetched at a time.
+     */
+    constexpr size_t PREFETCH_SIZE = 256 * 1024;
+
+    /**
+     * This is the number of bytes read by each request submitted
+     * to prefetch pages, so that the device sees several requests
+     * at once.
+     */
+    constexpr size_t PREFETCH_CHUNK_SIZE = 32 * 1024;
+
+    /**
+     * This holds one file operation to submit through the io_uring.
+     */
+    struct Operation {
+        enum class Type {
+            Read,
+            Write,
+            Sync,
+        };
+
+        Type type = Type::Write;
+        int fd = -1;
+        void* buffer = nullptr;
+        size_t length = 0;
+        off_t offset = 0;
+        bool dataOnly = false;
+        int result = 0;
+    };
+
+    /**
+     * This wraps an io_uring instance, through which batches of file
+     * operations are submitted and waited on together.
+     */
+    class Ring {
+        // Lifecycle
+    public:
+        ~Ring() noexcept {
+            if (sqes != MAP_FAILED) {
+                (void)munmap(sqes, sqesSize);
+            }
+            if (
+                (cqRing != MAP_FAILED)
+                && (cqRing != sqRing)
+            ) {
+                (void)munmap(cqRing, cqRingSize);
+            }
+            if (sqRing != MAP_FAILED) {
+                (void)munmap(sqRing, sqRingSize);
+            }
+            if (fd >= 0) {
+                (void)close(fd);
+            }
+        }
+
+        // Methods
+    public:
+        /**
+         * Set up the io_uring.
+         *
+         * @return
+         *     An indication of whether or not the io_uring
+         *     was set up successfully is returned.
+         */
+        bool Initialize() {
+            io_uring_params params;
+            memset(&params, 0, sizeof(params));
+            fd = (int)syscall(__NR_io_uring_setup, RING_ENTRIES, &params);
+            if (fd < 0) {
+                return false;
+            }
+            sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+            cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            const bool singleMmap = ((params.features & IORING_FEAT_SINGLE_MMAP) != 0);
+            if (singleMmap) {
+                sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+            }
+            sqRing = mmap(
+                NULL, sqRingSize,
+                PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                fd, IORING_OFF_SQ_RING
+            );
+            if (sqRing == MAP_FAILED) {
+                return false;
+            }
+            if (singleMmap) {
+                cqRing = sqRing;
+            } else {
+                cqRing = mmap(
+                    NULL, cqRingSize,
+                    PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    fd, IORING_OFF_CQ_RING
+                );
+                if (cqRing == MAP_FAILED) {
+                    return false;
+                }
+            }
+            sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+            sqes = mmap(
+                NULL, sqesSize,
+                PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                fd, IORING_OFF_SQES
+            );
+            if (sqes == MAP_FAILED) {
+                return false;
+            }
+            const auto sqBase = (char*)sqRing;
+            sqTail = (unsigned*)(sqBase + params.sq_off.tail);
+            sqMask = (unsigned*)(sqBase + params.sq_off.ring_mask);
+            sqArray = (unsigned*)(sqBase + params.sq_off.array);
+            const auto cqBase = (char*)cqRing;
+            cqHead = (unsigned*)(cqBase + params.cq_off.head);
+            cqTail = (unsigned*)(cqBase + params.cq_off.tail);
+            cqMask = (unsigned*)(cqBase + params.cq_off.ring_mask);
+            cqes = (io_uring_cqe*)(cqBase + params.cq_off.cqes);
+            sqEntries = params.sq_entries;
+            return true;
+        }
+
+        /**
+         * Submit the given operations and wait for all of them to
+         * complete.  Each sync operation waits for all operations
+         * submitted before it to complete first.
+         *
+         * @param[in,out] operations
+         *     These are the operations to submit.  The result of
+         *     each operation is stored in it.
+         *
+         * @return
+         *     An indication of whether or not the operations were
+         *     submitted successfully is returned.  If not, the operations
+         *     should be done in some other way.
+         */
+        bool Execute(std::vector< Operation >& operations) {
+            std::lock_guard< std::mutex > lock(mutex);
+            if (broken) {
+                return false;
+            }
+            std::vector< iovec > iovecs(operations.size());
+            size_t next = 0;
+            while (next < operations.size()) {
+                const auto count = std::min((size_t)sqEntries, operations.size() - next);
+                auto tail = *sqTail;
+                const auto mask = *sqMask;
+                for (size_t i = 0; i < count; ++i) {
+                    auto& operation = operations[next + i];
+                    const auto index = tail & mask;
+                    auto sqe = (io_uring_sqe*)sqes + index;
+                    memset(sqe, 0, sizeof(*sqe));
+                    sqe->fd = operation.fd;
+                    sqe->user_data = next + i;
+                    switch (operation.type) {
+                        case Operation::Type::Read:
+                        case Operation::Type::Write: {
+                            iovecs[next + i].iov_base = operation.buffer;
+                            iovecs[next + i].iov_len = operation.length;
+                            sqe->opcode = (
+                                (operation.type == Operation::Type::Read)
+                                ? IORING_OP_READV
+                                : IORING_OP_WRITEV
+                            );
+                            sqe->addr = (uint64_t)(uintptr_t)&iovecs[next + i];
+                            sqe->len = 1;
+                            sqe->off = (uint64_t)operation.offset;
+                        } break;
+
+                        case Operation::Type::Sync: {
+                            sqe->opcode = IORING_OP_FSYNC;
+                            sqe->flags = IOSQE_IO_DRAIN;
+                            sqe->fsync_flags = (
+                                operation.dataOnly
+                                ? IORING_FSYNC_DATASYNC
+                                : 0
+                            );
+                        } break;
+                    }
+                    sqArray[index] = index;
+                    ++tail;
+                }
+                __atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+                size_t submitted = 0;
+                size_t reaped = 0;
+                while (reaped < count) {
+                    const auto result = syscall(
+                        __NR_io_uring_enter,
+                        fd,
+                        (unsigned)(count - submitted),
+                        1U,
+                        IORING_ENTER_GETEVENTS,
+                        NULL,
+                        0
+                    );
+                    if (result < 0) {
+                        if (errno == EINTR) {
+                            continue;
+                        }
+                        broken = true;
+                        return false;
+                    }
+                    submitted += (size_t)result;
+                    auto head = *cqHead;
+                    while (head != __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+                        const auto& cqe = cqes[head & *cqMask];
+                        if (cqe.user_data < operations.size()) {
+                            operations[(size_t)cqe.user_data].result = cqe.res;
+                        }
+                        ++head;
+                        ++reaped;
+                    }
+                    __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+                }
+                next += count;
+            }
+            return true;
+        }
+
+        // Properties
+    private:
+        int fd = -1;
+        void* sqRing = MAP_FAILED;
+        size_t sqRingSize = 0;
+        void* cqRing = MAP_FAILED;
+        size_t cqRingSize = 0;
+        void* sqes = MAP_FAILED;
+        size_t sqesSize = 0;
+        unsigned* sqTail = nullptr;
+        unsigned* sqMask = nullptr;
+        unsigned* sqArray = nullptr;
+        unsigned* cqHead = nullptr;
+        unsigned* cqTail = nullptr;
+        unsigned* cqMask = nullptr;
+        io_uring_cqe* cqes = nullptr;
+        unsigned sqEntries = 0;
+        bool broken = false;
+        std::mutex mutex;
+    };
+
+    /**
+     * This is the io_uring shared by all files opened through the VFS.
+     */
+    Ring* ring = nullptr;
+
+    /**
+     * This is the VFS wrapped by this one.
+     */
+    sqlite3_vfs* defaultVfs = nullptr;
+
+    /**
+     * This holds a write to a file which hasn't been submitted yet.
+     */
+    struct PendingWrite {
+        sqlite3_int64 offset = 0;
+        std::vector< uint8_t > data;
+    };
+
+    /**
+     * This identifies a file by the device and inode on which it's stored.
+     */
+    typedef std::pair< dev_t, ino_t > FileId;
+
+    /**
+     * This holds the state of a file opened through the VFS.
+     */
+    struct FileState
+        : public std::enable_shared_from_this< FileState >
+    {
+        std::mutex mutex;
+        sqlite3_file* real = nullptr;
+        int fd = -1;
+        bool ownsFd = false;
+        bool sharesFd = false;
+        FileId fileId;
+        bool useRing = false;
+        bool isMainDb = false;
+        bool isJournal = false;
+        bool isWal = false;
+        bool needsRealSync = false;
+        bool flushAfterNextWrite = false;
+        bool closed = false;
+        std::vector< PendingWrite > pendingWrites;
+        size_t pendingBytes = 0;
+        std::vector< uint8_t > prefetchBuffer;
+        sqlite3_int64 prefetchOffset = 0;
+        size_t prefetchLength = 0;
+        sqlite3_int64 lastReadEnd = -1;
+        int sequentialReads = 0;
+    };
+
+    /**
+     * This is the structure SQLite allocates for each file opened
+     * through the VFS.  The wrapped VFS's file structure follows it.
+     */
+    struct UringFile {
+        sqlite3_file base;
+        std::shared_ptr< FileState > state;
+    };
+
+    /**
+     * This is used to synchronize access to filesWithPendingWrites.
+     */
+    std::mutex pendingFilesMutex;
+
+    /**
+     * These are the files which have writes not yet submitted.
+     */
+    std::set< std::shared_ptr< FileState > > filesWithPendingWrites;
+
+    /**
+     * This is the result of the last flush of pending writes which
+     * had no way to report its failure to SQLite, such as one done by
+     * a shared-memory barrier.  It's reported by the next operation
+     * which can return an error.
+     */
+    std::atomic< int > deferredError{SQLITE_OK};
+
+    /**
+     * This holds the file descriptors opened by the VFS for a database
+     * file, shared by all connections to the file opened through the VFS.
+     */
+    struct SharedDescriptor {
+        /**
+         * This is the descriptor used to submit reads and writes.
+         */
+        int fd = -1;
+
+        /**
+         * This indicates whether or not fd was opened for writing.
+         */
+        bool writable = false;
+
+        /**
+         * This is the number of files opened through the VFS
+         * which use the descriptor.
+         */
+        size_t users = 0;
+
+        /**
+         * These are descriptors for the file which were replaced by
+         * a writable one while the file was still in use.
+         */
+        std::vector< int > retired;
+    };
+
+    /**
+     * This is used to synchronize access to sharedDescriptors
+     * and unusedDescriptors.
+     */
+    std::mutex sharedDescriptorsMutex;
+
+    /**
+     * These are the file descriptors opened by the VFS for database files
+     * which are in use, keyed by file.  Closing any descriptor of a file
+     * releases all POSIX advisory locks the process holds on that file,
+     * including the ones the wrapped VFS takes on behalf of connections,
+     * so these are only closed once no file opened through the VFS uses
+     * them and the process holds no locks on the file.
+     */
+    std::map< FileId, SharedDescriptor > sharedDescriptors;
+
+    /**
+     * These are file descriptors for database files no longer used by
+     * any file opened through the VFS, which are kept open until the
+     * process holds no locks on the files, such as when connections
+     * not made through the VFS still have them open.
+     */
+    std::vector< int > unusedDescriptors;
+
+    /**
+     * Determine whether or not any lock is held on the file with
+     * the given descriptor, by this or any other process.
+     *
+     * Open file description locks conflict with POSIX advisory locks
+     * even when both are held by the same process, so asking whether
+     * one could be taken over the whole file finds the locks the
+     * wrapped VFS holds on behalf of any connection.
+     *
+     * @param[in] fd
+     *     This is the file descriptor of the file to check.
+     *
+     * @return
+     *     An indication of whether or not any lock is held on
+     *     the file is returned.
+     */
+    bool IsLocked(int fd) {
+#ifdef F_OFD_GETLK
+        struct flock lockInfo;
+        (void)memset(&lockInfo, 0, sizeof(lockInfo));
+        lockInfo.l_type = F_WRLCK;
+        lockInfo.l_whence = SEEK_SET;
+        lockInfo.l_start = 0;
+        lockInfo.l_len = 0;
+        if (fcntl(fd, F_OFD_GETLK, &lockInfo) != 0) {
+            return true;
+        }
+        return (lockInfo.l_type != F_UNLCK);
+#else /* !F_OFD_GETLK */
+        (void)fd;
+        return true;
+#endif /* F_OFD_GETLK */
+    }
+
+    /**
+     * Close the descriptors in unusedDescriptors of files on which
+     * no locks are held anymore.  sharedDescriptorsMutex must be
+     * held by the caller.
+     */
+    void CloseUnusedDescriptors() {
+        unusedDescriptors.erase(
+            std::remove_if(
+                unusedDescriptors.begin(),
+                unusedDescriptors.end(),
+                [](int fd){
+                    if (IsLocked(fd)) {
+                        return false;
+                    }
+                    (void)close(fd);
+                    return true;
+                }
+            ),
+            unusedDescriptors.end()
+        );
+    }
+
+    /**
+     * Return a file descriptor for the database file at the given path,
+     * for use in submitting reads and writes through the io_uring.
+     * Each descriptor returned must be given back, once it's no longer
+     * used, by calling ReleaseSharedDescriptor.
+     *
+     * @param[in] path
+     *     This is the path of the database file.
+     *
+     * @param[in] writable
+     *     This indicates whether or not the file will be written.
+     *
+     * @param[out] fileId
+     *     This is where to store the identity of the file, to be
+     *     passed to ReleaseSharedDescriptor.
+     *
+     * @return
+     *     The file descriptor of the file is returned.
+     *
+     * @retval -1
+     *     This is returned if the file could not be opened.
+     */
+    int GetSharedDescriptor(const char* path, bool writable, FileId& fileId) {
+        std::lock_guard< std::mutex > lock(sharedDescriptorsMutex);
+        CloseUnusedDescriptors();
+        struct stat pathInfo;
+        if (stat(path, &pathInfo) == 0) {
+            const auto descriptor = sharedDescriptors.find(
+                FileId(pathInfo.st_dev, pathInfo.st_ino)
+            );
+            if (
+                (descriptor != sharedDescriptors.end())
+                && (
+                    descriptor->second.writable
+                    || !writable
+                )
+            ) {
+                fileId = descriptor->first;
+                ++descriptor->second.users;
+                return descriptor->second.fd;
+            }
+        }
+        const auto fd = open(path, (writable ? O_RDWR : O_RDONLY) | O_CLOEXEC);
+        if (fd < 0) {
+            return -1;
+        }
+        struct stat fdInfo;
+        if (fstat(fd, &fdInfo) != 0) {
+            unusedDescriptors.push_back(fd);
+            return -1;
+        }
+        fileId = FileId(fdInfo.st_dev, fdInfo.st_ino);
+        auto& descriptor = sharedDescriptors[fileId];
+        if (descriptor.fd >= 0) {
+            descriptor.retired.push_back(descriptor.fd);
+        }
+        descriptor.fd = fd;
+        descriptor.writable = writable;
+        ++descriptor.users;
+        return fd;
+    }
+
+    /**
+     * Give back a file descriptor returned by GetSharedDescriptor,
+     * closing the descriptors of the file once no file opened through
+     * the VFS uses them and no locks are held on the file.
+     *
+     * @param[in] fileId
+     *     This is the identity of the file, as given by
+     *     GetSharedDescriptor.
+     */
+    void ReleaseSharedDescriptor(const FileId& fileId) {
+        std::lock_guard< std::mutex > lock(sharedDescriptorsMutex);
+        const auto descriptor = sharedDescriptors.find(fileId);
+        if (descriptor == sharedDescriptors.end()) {
+            return;
+        }
+        if (--descriptor->second.users == 0) {
+            unusedDescriptors.push_back(descriptor->second.fd);
+            unusedDescriptors.insert(
+                unusedDescriptors.end(),
+                descriptor->second.retired.begin(),
+                descriptor->second.retired.end()
+            );
+            (void)sharedDescriptors.erase(descriptor);
+        }
+        CloseUnusedDescriptors();
+    }
+
+    /**
+     * Return and clear the result of the last flush of pending writes
+     * which couldn't be reported when it happened.
+     *
+     * @return
+     *     The SQLite result code of the flush is returned.
+     */
+    int TakeDeferredError() {
+        if (deferredError.load() == SQLITE_OK) {
+            return SQLITE_OK;
+        }
+        return deferredError.exchange(SQLITE_OK);
+    }
+
+    /**
+     * Write the given data to a file, without the io_uring.
+     *
+     * @param[in] fd
+     *     This is the file descriptor of the file.
+     *
+     * @param[in] data
+     *     This points to the data to write.
+     *
+     * @param[in] length
+     *     This is the number of bytes to write.
+     *
+     * @param[in] offset
+     *     This is the offset into the file at which to write.
+     *
+     * @return
+     *     An indication of whether or not the data was
+     *     written successfully is returned.
+     */
+    bool WriteDirectly(
+        int fd,
+        const uint8_t* data,
+        size_t length,
+        off_t offset
+    ) {
+        while (length > 0) {
+            const auto written = pwrite(fd, data, length, offset);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            data += written;
+            length -= (size_t)written;
+            offset += written;
+        }
+        return true;
+    }
+
+    /**
+     * Submit all pending writes to the given file, optionally followed
+     * by a sync, and wait for them to complete.  The caller must hold
+     * the file's mutex.
+     *
+     * @param[in] state
+     *     This is the state of the file.
+     *
+     * @param[in] sync
+     *     This indicates whether or not to sync the file after writing.
+     *
+     * @param[in] dataOnly
+     *     This indicates whether or not only the file's data,
+     *     and not its metadata, needs to be synced.
+     *
+     * @return
+     *     The SQLite result code is returned.
+     */
+    int Flush(
+        FileState& state,
+        bool sync,
+        bool dataOnly
+    ) {
+        if (
+            state.pendingWrites.empty()
+            && !sync
+        ) {
+            return SQLITE_OK;
+        }
+        std::vector< Operation > operations;
+        operations.reserve(state.pendingWrites.size() + 1);
+        for (auto& pendingWrite: state.pendingWrites) {
+            Operation operation;
+            operation.type = Operation::Type::Write;
+            operation.fd = state.fd;
+            operation.buffer = pendingWrite.data.data();
+            operation.length = pendingWrite.data.size();
+            operation.offset = (off_t)pendingWrite.offset;
+            operations.push_back(operation);
+        }
+        if (sync) {
+            Operation operation;
+            operation.type = Operation::Type::Sync;
+            operation.fd = state.fd;
+            operation.dataOnly = dataOnly;
+            operations.push_back(operation);
+        }
+        const bool submitted = (
+            (state.pendingWrites.size() >= MIN_RING_WRITES)
+            && ring->Execute(operations)
+        );
+        int result = SQLITE_OK;
+        for (auto& operation: operations) {
+            if (operation.type == Operation::Type::Write) {
+                const auto written = (submitted ? operation.result : 0);
+                if (written < 0) {
+                    result = SQLITE_IOERR_WRITE;
+                } else if (
+                    ((size_t)written < operation.length)
+                    && !WriteDirectly(
+                        state.fd,
+                        (const uint8_t*)operation.buffer + written,
+                        operation.length - (size_t)written,
+                        operation.offset + written
+                    )
+                ) {
+                    result = SQLITE_IOERR_WRITE;
+                }
+            } else if (submitted) {
+                if (operation.result < 0) {
+                    result = SQLITE_IOERR_FSYNC;
+                }
+            } else {
+                const auto syncResult = (
+                    dataOnly
+                    ? fdatasync(state.fd)
+                    : fsync(state.fd)
+                );
+                if (syncResult != 0) {
+                    result = SQLITE_IOERR_FSYNC;
+                }
+            }
+        }
+        if (!state.pendingWrites.empty()) {
+            state.pendingWrites.clear();
+            state.pendingBytes = 0;
+            std::lock_guard< std::mutex > lock(pendingFilesMutex);
+            (void)filesWithPendingWrites.erase(state.shared_from_this());
+        }
+        return result;
+    }
+
+    /**
+     * Submit all pending writes to all files opened through the VFS,
+     * and wait for them to complete.  This is done before SQLite lets
+     * other connections see changes, so that they never read data which
+     * hasn't actually been written yet.
+     *
+     * @return
+     *     The SQLite result code is returned.
+     */
+    int FlushAll() {
+        std::set< std::shared_ptr< FileState > > files;
+        {
+            std::lock_guard< std::mutex > lock(pendingFilesMutex);
+            files = filesWithPendingWrites;
+        }
+        int result = SQLITE_OK;
+        for (const auto& file: files) {
+            std::lock_guard< std::mutex > lock(file->mutex);
+            if (file->closed) {
+                continue;
+            }
+            const auto flushResult = Flush(*file, false, false);
+            if (flushResult != SQLITE_OK) {
+                result = flushResult;
+            }
+        }
+        return result;
+    }
+
+    /**
+     * Forget any pages prefetched from the given file, since
+     * they may no longer match what's in the file.
+     *
+     * @param[in] state
+     *     This is the state of the file.
+     */
+    void DiscardPrefetch(FileState& state) {
+        state.prefetchLength = 0;
+    }
+
+    /**
+     * Read a batch of pages from the database, starting at the
+     * given offset, into the prefetch buffer.
+     *
+     * @param[in] state
+     *     This is the state of the file.
+     *
+     * @param[in] offset
+     *     This is the offset into the file at which to start reading.
+     */
+    void Prefetch(
+        FileState& state,
+        sqlite3_int64 offset
+    ) {
+        state.prefetchBuffer.resize(PREFETCH_SIZE);
+        state.prefetchOffset = offset;
+        state.prefetchLength = 0;
+        std::vector< Operation > operations;
+        for (size_t chunk = 0; chunk < PREFETCH_SIZE; chunk += PREFETCH_CHUNK_SIZE) {
+            Operation operation;
+            operation.type = Operation::Type::Read;
+            operation.fd = state.fd;
+            operation.buffer = state.prefetchBuffer.data() + chunk;
+            operation.length = PREFETCH_CHUNK_SIZE;
+            operation.offset = (off_t)(offset + (sqlite3_int64)chunk);
+            operations.push_back(operation);
+        }
+        if (!ring->Execute(operations)) {
+            return;
+        }
+        for (const auto& operation: operations) {
+            if (operation.result <= 0) {
+                break;
+            }
+            state.prefetchLength += (size_t)operation.result;
+            if ((size_t)operation.result < operation.length) {
+                break;
+            }
+        }
+    }
+
+    /**
+     * Return the state of the given file opened through the VFS.
+     *
+     * @param[in] file
+     *     This is the file opened through the VFS.
+     *
+     * @return
+     *     The state of the file is returned.
+     */
+    FileState& GetState(sqlite3_file* file) {
+        return *((UringFile*)file)->state;
+    }
+
+    int UringClose(sqlite3_file* file) {
+        const auto uringFile = (UringFile*)file;
+        auto state = uringFile->state;
+        int result = SQLITE_OK;
+        {
+            std::lock_guard< std::mutex > lock(state->mutex);
+            if (state->useRing) {
+                result = Flush(*state, false, false);
+            }
+            const auto closeResult = state->real->pMethods->xClose(state->real);
+            if (result == SQLITE_OK) {
+                result = closeResult;
+            }
+            if (state->ownsFd) {
+                (void)close(state->fd);
+            }
+            if (state->sharesFd) {
+                ReleaseSharedDescriptor(state->fileId);
+            }
+            state->closed = true;
+        }
+        uringFile->state.~shared_ptr();
+        return result;
+    }
+
+    int UringRead(sqlite3_file* file, void* buffer, int amount, sqlite3_int64 offset) {
+        auto& state = GetState(file);
+        if (!state.useRing) {
+            return state.real->pMethods->xRead(state.real, buffer, amount, offset);
+        }
+        std::lock_guard< std::mutex > lock(state.mutex);
+        const auto flushResult = Flush(state, false, false);
+        if (flushResult != SQLITE_OK) {
+            return flushResult;
+        }
+        if (state.isMainDb) {
+            if (offset == state.lastReadEnd) {
+                ++state.sequentialReads;
+            } else {
+                state.sequentialReads = 0;
+            }
+            state.lastReadEnd = offset + amount;
+            const auto prefetched = [&]{
+                return (
+                    (offset >= state.prefetchOffset)
+                    && (
+                        offset + amount
+                        <= state.prefetchOffset + (sqlite3_int64)state.prefetchLength
+                    )
+                );
+            };
+            if (
+                !prefetched()
+                && (state.sequentialReads >= SEQUENTIAL_READS_BEFORE_PREFETCH)
+                && ((size_t)amount <= PREFETCH_SIZE)
+            ) {
+                Prefetch(state, offset);
+            }
+            if (prefetched()) {
+                memcpy(
+                    buffer,
+                    state.prefetchBuffer.data() + (offset - state.prefetchOffset),
+                    (size_t)amount
+                );
+                return SQLITE_OK;
+            }
+        }
+        return state.real->pMethods->xRead(state.real, buffer, amount, offset);
+    }
+
+    /**
+     * Hold back the given write to a file, to be submitted later along
+     * with others.  The caller must hold the file's mutex.
+     *
+     * @param[in] state
+     *     This is the state of the file.
+     *
+     * @param[in] data
+     *     This points to the data to write.
+     *
+     * @param[in] length
+     *     This is the number of bytes to write.
+     *
+     * @param[in] offset
+     *     This is the offset into the file at which to write.
+     *
+     * @return
+     *     The SQLite result code is returned.
+     */
+    int QueueWrite(
+        FileState& state,
+        const uint8_t* data,
+        size_t length,
+        sqlite3_int64 offset
+    ) {
+        const auto end = offset + (sqlite3_int64)length;
+        for (auto& pendingWrite: state.pendingWrites) {
+            const auto pendingEnd = pendingWrite.offset + (sqlite3_int64)pendingWrite.data.size();
+            if (
+                (offset >= pendingEnd)
+                || (end <= pendingWrite.offset)
+            ) {
+                continue;
+            }
+            if (
+                (offset >= pendingWrite.offset)
+                && (end <= pendingEnd)
+            ) {
+                memcpy(
+                    pendingWrite.data.data() + (offset - pendingWrite.offset),
+                    data,
+                    length
+                );
+                return SQLITE_OK;
+            }
+
+            // Writes submitted together may be done in any order, so
+            // the ones this write overlaps need to be done first.
+            const auto flushResult = Flush(state, false, false);
+            if (flushResult != SQLITE_OK) {
+                return flushResult;
+            }
+            break;
+        }
+        if (
+            !state.pendingWrites.empty()
+            && (
+                state.pendingWrites.back().offset
+                + (sqlite3_int64)state.pendingWrites.back().data.size()
+                == offset
+            )
+        ) {
+            auto& pendingData = state.pendingWrites.back().data;
+            pendingData.insert(pendingData.end(), data, data + length);
+        } else {
+            PendingWrite pendingWrite;
+            pendingWrite.offset = offset;
+            pendingWrite.data.assign(data, data + length);
+            state.pendingWrites.push_back(std::move(pendingWrite));
+            if (state.pendingWrites.size() == 1) {
+                std::lock_guard< std::mutex > pendingFilesLock(pendingFilesMutex);
+                (void)filesWithPendingWrites.insert(state.shared_from_this());
+            }
+        }
+        state.pendingBytes += length;
+        if (
+            (state.pendingWrites.size() >= MAX_PENDING_WRITES)
+            || (state.pendingBytes >= MAX_PENDING_BYTES)
+        ) {
+            return Flush(state, false, false);
+        }
+        return SQLITE_OK;
+    }
+
+    int UringWrite(sqlite3_file* file, const void* buffer, int amount, sqlite3_int64 offset) {
+        auto& state = GetState(file);
+        if (!state.useRing) {
+            return state.real->pMethods->xWrite(state.real, buffer, amount, offset);
+        }
+        if (
+            state.isJournal
+            && (offset == 0)
+        ) {
+            // SQLite rewrites the journal header when a transaction
+            // starts, and in PERSIST journal mode, also to commit one.
+            // Do it right away, after any writes held back from the last
+            // transaction, so that a failure is reported to SQLite rather
+            // than found later, once the commit can no longer be undone.
+            const auto flushResult = FlushAll();
+            if (flushResult != SQLITE_OK) {
+                return flushResult;
+            }
+            std::lock_guard< std::mutex > lock(state.mutex);
+            return (
+                WriteDirectly(state.fd, (const uint8_t*)buffer, (size_t)amount, (off_t)offset)
+                ? SQLITE_OK
+                : SQLITE_IOERR_WRITE
+            );
+        }
+        std::lock_guard< std::mutex > lock(state.mutex);
+        DiscardPrefetch(state);
+        const auto result = QueueWrite(state, (const uint8_t*)buffer, (size_t)amount, offset);
+        if (result != SQLITE_OK) {
+            return result;
+        }
+        if (state.flushAfterNextWrite) {
+            // This write holds the last page of a transaction committed
+            // to the write-ahead log.  Submit the transaction now, since
+            // SQLite may make it visible to other connections without
+            // syncing the log first, and can't be told of a failure after.
+            state.flushAfterNextWrite = false;
+            return Flush(state, false, false);
+        }
+        if (
+            state.isWal
+            && (amount == WAL_FRAME_HEADER_SIZE)
+        ) {
+            // Only commit frames have a nonzero database size
+            // in the second field of their header.
+            const auto header = (const uint8_t*)buffer;
+            state.flushAfterNextWrite = (
+                (header[4] | header[5] | header[6] | header[7]) != 0
+            );
+        }
+        return SQLITE_OK;
+    }
+
+    int UringTruncate(sqlite3_file* file, sqlite3_int64 size) {
+        auto& state = GetState(file);
+        if (state.useRing) {
+            // Truncating the journal commits a transaction in TRUNCATE
+            // journal mode, so writes to the database must be done first.
+            const auto flushResult = FlushAll();
+            if (flushResult != SQLITE_OK) {
+                return flushResult;
+            }
+        }
+        std::lock_guard< std::mutex > lock(state.mutex);
+        DiscardPrefetch(state);
+        return state.real->pMethods->xTruncate(state.real, size);
+    }
+
+    int UringSync(sqlite3_file* file, int flags) {
+        auto& state = GetState(file);
+        const auto deferredResult = TakeDeferredError();
+        if (deferredResult != SQLITE_OK) {
+            return deferredResult;
+        }
+        if (!state.useRing) {
+            return state.real->pMethods->xSync(state.real, flags);
+        }
+        std::lock_guard< std::mutex > lock(state.mutex);
+        const auto result = Flush(
+            state,
+            true,
+            ((flags & SQLITE_SYNC_DATAONLY) != 0)
+        );
+        if (result != SQLITE_OK) {
+            return result;
+        }
+        if (state.needsRealSync) {
+            // The wrapped VFS also syncs the directory the first time a
+            // journal or write-ahead log is synced, so that the file
+            // itself is sure to survive a crash.
+            state.needsRealSync = false;
+            return state.real->pMethods->xSync(state.real, flags);
+        }
+        return SQLITE_OK;
+    }
+
+    int UringFileSize(sqlite3_file* file, sqlite3_int64* size) {
+        auto& state = GetState(file);
+        std::lock_guard< std::mutex > lock(state.mutex);
+        if (state.useRing) {
+            const auto flushResult = Flush(state, false, false);
+            if (flushResult != SQLITE_OK) {
+                return flushResult;
+            }
+        }
+        return state.real->pMethods->xFileSize(state.real, size);
+    }
+
+    int UringLock(sqlite3_file* file, int lockType) {
+        auto& state = GetState(file);
+        const auto deferredResult = TakeDeferredError();
+        if (deferredResult != SQLITE_OK) {
+            return deferredResult;
+        }
+        {
+            std::lock_guard< std::mutex > lock(state.mutex);
+            DiscardPrefetch(state);
+        }
+        return state.real->pMethods->xLock(state.real, lockType);
+    }
+
+    int UringUnlock(sqlite3_file* file, int lockType) {
+        auto& state = GetState(file);
+        const auto flushResult = FlushAll();
+        if (flushResult != SQLITE_OK) {
+            return flushResult;
+        }
+        {
+            std::lock_guard< std::mutex > lock(state.mutex);
+            DiscardPrefetch(state);
+        }
+        return state.real->pMethods->xUnlock(state.real, lockType);
+    }
+
+    int UringCheckReservedLock(sqlite3_file* file, int* reserved) {
+        auto& state = GetState(file);
+        return state.real->pMethods->xCheckReservedLock(state.real, reserved);
+    }
+
+    int UringFileControl(sqlite3_file* file, int op, void* arg) {
+        auto& state = GetState(file);
+        if (state.useRing) {
+            std::lock_guard< std::mutex > lock(state.mutex);
+            const auto flushResult = Flush(state, false, false);
+            if (flushResult != SQLITE_OK) {
+                return flushResult;
+            }
+        }
+        return state.real->pMethods->xFileControl(state.real, op, arg);
+    }
+
+    int UringSectorSize(sqlite3_file* file) {
+        auto& state = GetState(file);
+        return state.real->pMethods->xSectorSize(state.real);
+    }
+
+    int UringDeviceCharacteristics(sqlite3_file* file) {
+        auto& state = GetState(file);
+        return state.real->pMethods->xDeviceCharacteristics(state.real);
+    }
+
+    int UringShmMap(sqlite3_file* file, int region, int regionSize, int extend, void volatile** address) {
+        auto& state = GetState(file);
+        if (state.real->pMethods->iVersion < 2) {
+            return SQLITE_IOERR_SHMMAP;
+        }
+        return state.real->pMethods->xShmMap(state.real, region, regionSize, extend, address);
+    }
+
+    int UringShmLock(sqlite3_file* file, int offset, int n, int flags) {
+        auto& state = GetState(file);
+        if (state.real->pMethods->iVersion < 2) {
+            return SQLITE_IOERR_SHMLOCK;
+        }
+        if ((flags & SQLITE_SHM_UNLOCK) != 0) {
+            const auto flushResult = FlushAll();
+            if (flushResult != SQLITE_OK) {
+                return flushResult;
+            }
+        } else {
+            const auto deferredResult = TakeDeferredError();
+            if (deferredResult != SQLITE_OK) {
+                return deferredResult;
+            }
+        }
+        {
+            std::lock_guard< std::mutex > lock(state.mutex);
+            DiscardPrefetch(state);
+        }
+        return state.real->pMethods->xShmLock(state.real, offset, n, flags);
+    }
+
+    void UringShmBarrier(sqlite3_file* file) {
+        auto& state = GetState(file);
+        const auto flushResult = FlushAll();
+        if (flushResult != SQLITE_OK) {
+            // There's no way to report the failure here, so report it
+            // from the next lock or sync instead.
+            deferredError = flushResult;
+        }
+        if (state.real->pMethods->iVersion >= 2) {
+            state.real->pMethods->xShmBarrier(state.real);
+        }
+    }
+
+    int UringShmUnmap(sqlite3_file* file, int deleteFlag) {
+        auto& state = GetState(file);
+        if (state.real->pMethods->iVersion < 2) {
+            return SQLITE_OK;
+        }
+        return state.real->pMethods->xShmUnmap(state.real, deleteFlag);
+    }
+
+    int UringFetch(sqlite3_file* file, sqlite3_int64 offset, int amount, void** pointer) {
+        auto& state = GetState(file);
+        if (state.real->pMethods->iVersion < 3) {
+            *pointer = nullptr;
+            return SQLITE_OK;
+        }
+        if (state.useRing) {
+            std::lock_guard< std::mutex > lock(state.mutex);
+            const auto flushResult = Flush(state, false, false);
+            if (flushResult != SQLITE_OK) {
+                return flushResult;
+            }
+        }
+        return state.real->pMethods->xFetch(state.real, offset, amount, pointer);
+    }
+
+    int UringUnfetch(sqlite3_file* file, sqlite3_int64 offset, void* pointer) {
+        auto& state = GetState(file);
+        if (state.real->pMethods->iVersion < 3) {
+            return SQLITE_OK;
+        }
+        return state.real->pMethods->xUnfetch(state.real, offset, pointer);
+    }
+
+    const sqlite3_io_methods URING_IO_METHODS = {
+        3,
+        UringClose,
+        UringRead,
+        UringWrite,
+        UringTruncate,
+        UringSync,
+        UringFileSize,
+        UringLock,
+        UringUnlock,
+        UringCheckReservedLock,
+        UringFileControl,
+        UringSectorSize,
+        UringDeviceCharacteristics,
+        UringShmMap,
+        UringShmLock,
+        UringShmBarrier,
+        UringShmUnmap,
+        UringFetch,
+        UringUnfetch,
+    };
+
+    int UringOpen(sqlite3_vfs* vfs, const char* path, sqlite3_file* file, int flags, int* outFlags) {
+        (void)vfs;
+        const auto uringFile = (UringFile*)file;
+        const auto real = (sqlite3_file*)((char*)file + sizeof(UringFile));
+        uringFile->base.pMethods = nullptr;
+        const auto result = defaultVfs->xOpen(defaultVfs, path, real, flags, outFlags);
+        if (result != SQLITE_OK) {
+            return result;
+        }
+        (void)new (&uringFile->state) std::shared_ptr< FileState >(std::make_shared< FileState >());
+        auto& state = *uringFile->state;
+        state.real = real;
+        const auto batchable = (
+            (flags & (SQLITE_OPEN_MAIN_DB | SQLITE_OPEN_MAIN_JOURNAL | SQLITE_OPEN_WAL)) != 0
+        );
+        if (
+            batchable
+            && (path != nullptr)
+            && (strncmp(defaultVfs->zName, "unix", 4) == 0)
+        ) {
+            // The wrapped VFS keeps its file descriptors to itself, so
+            // open the file again to submit operations on it.  The unix
+            // VFS takes POSIX advisory locks only on the database file,
+            // and those are released when any descriptor of the file is
+            // closed, so the descriptor for it is shared, and kept open
+            // while the file is in use.
+            const auto writable = ((flags & SQLITE_OPEN_READWRITE) != 0);
+            state.isMainDb = ((flags & SQLITE_OPEN_MAIN_DB) != 0);
+            state.isJournal = ((flags & SQLITE_OPEN_MAIN_JOURNAL) != 0);
+            state.isWal = ((flags & SQLITE_OPEN_WAL) != 0);
+            if (state.isMainDb) {
+                state.fd = GetSharedDescriptor(path, writable, state.fileId);
+                state.sharesFd = (state.fd >= 0);
+            } else {
+                state.fd = open(path, (writable ? O_RDWR : O_RDONLY) | O_CLOEXEC);
+                state.ownsFd = (state.fd >= 0);
+            }
+            state.useRing = (state.fd >= 0);
+            state.needsRealSync = !state.isMainDb;
+        }
+        uringFile->base.pMethods = &URING_IO_METHODS;
+        return SQLITE_OK;
+    }
+
+    int UringDelete(sqlite3_vfs* vfs, const char* path, int syncDirectory) {
+        (void)vfs;
+
+        // Deleting the journal commits a transaction in DELETE journal
+        // mode, so writes to the database must be done first.
+        const auto flushResult = FlushAll();
+        if (flushResult != SQLITE_OK) {
+            return flushResult;
+        }
+        return defaultVfs->xDelete(defaultVfs, path, syncDirectory);
+    }
+
+    int UringAccess(sqlite3_vfs* vfs, const char* path, int flags, int* result) {
+        (void)vfs;
+        return defaultVfs->xAccess(defaultVfs, path, flags, result);
+    }
+
+    int UringFullPathname(sqlite3_vfs* vfs, const char* path, int outSize, char* out) {
+        (void)vfs;
+        return defaultVfs->xFullPathname(defaultVfs, path, outSize, out);
+    }
+
+    void* UringDlOpen(sqlite3_vfs* vfs, const char* path) {
+        (void)vfs;
+        return defaultVfs->xDlOpen(defaultVfs, path);
+    }
+
+    void UringDlError(sqlite3_vfs* vfs, int size, char* message) {
+        (void)vfs;
+        defaultVfs->xDlError(defaultVfs, size, message);
+    }
+
+    void (*UringDlSym(sqlite3_vfs* vfs, void* handle, const char* symbol))(void) {
+        (void)vfs;
+        return defaultVfs->xDlSym(defaultVfs, handle, symbol);
+    }
+
+    void UringDlClose(sqlite3_vfs* vfs, void* handle) {
+        (void)vfs;
+        defaultVfs->xDlClose(defaultVfs, handle);
+    }
+
+    int UringRandomness(sqlite3_vfs* vfs, int size, char* out) {
+        (void)vfs;
+        return defaultVfs->xRandomness(defaultVfs, size, out);
+    }
+
+    int UringSleep(sqlite3_vfs* vfs, int microseconds) {
+        (void)vfs;
+        return defaultVfs->xSleep(defaultVfs, microseconds);
+    }
+
+    int UringCurrentTime(sqlite3_vfs* vfs, double* now) {
+        (void)vfs;
+        return defaultVfs->xCurrentTime(defaultVfs, now);
+    }
+
+    int UringGetLastError(sqlite3_vfs* vfs, int size, char* message) {
+        (void)vfs;
+        return defaultVfs->xGetLastError(defaultVfs, size, message);
+    }
+
+    int UringCurrentTimeInt64(sqlite3_vfs* vfs, sqlite3_int64* now) {
+        (void)vfs;
+        if (
+            (defaultVfs->iVersion < 2)
+            || (defaultVfs->xCurrentTimeInt64 == nullptr)
+        ) {
+            double nowAsDouble;
+            const auto result = defaultVfs->xCurrentTime(defaultVfs, &nowAsDouble);
+            *now = (sqlite3_int64)(nowAsDouble * 86400000.0);
+            return result;
+        }
+        return defaultVfs->xCurrentTimeInt64(defaultVfs, now);
+    }
+
+    /**
+     * This is the VFS registered with SQLite.
+     */
+    sqlite3_vfs uringVfs;
+
+    /**
+     * Set up the io_uring and register the VFS with SQLite.
+     *
+     * @return
+     *     The name of the VFS is returned.
+     *
+     * @retval nullptr
+     *     This is returned if the VFS could not be registered.
+     */
+    const char* Register() {
+        defaultVfs = sqlite3_vfs_find(NULL);
+        if (defaultVfs == nullptr) {
+            return nullptr;
+        }
+        std::unique_ptr< Ring > newRing(new Ring());
+        if (!newRing->Initialize()) {
+            return nullptr;
+        }
+        memset(&uringVfs, 0, sizeof(uringVfs));
+        uringVfs.iVersion = 2;
+        uringVfs.szOsFile = (int)sizeof(UringFile) + defaultVfs->szOsFile;
+        uringVfs.mxPathname = defaultVfs->mxPathname;
+        uringVfs.zName = VFS_NAME;
+        uringVfs.xOpen = UringOpen;
+        uringVfs.xDelete = UringDelete;
+        uringVfs.xAccess = UringAccess;
+        uringVfs.xFullPathname = UringFullPathname;
+        uringVfs.xDlOpen = UringDlOpen;
+        uringVfs.xDlError = UringDlError;
+        uringVfs.xDlSym = UringDlSym;
+        uringVfs.xDlClose = UringDlClose;
+        uringVfs.xRandomness = UringRandomness;
+        uringVfs.xSleep = UringSleep;
+        uringVfs.xCurrentTime = UringCurrentTime;
+        uringVfs.xGetLastError = UringGetLastError;
+        uringVfs.xCurrentTimeInt64 = UringCurrentTimeInt64;
+        if (sqlite3_vfs_register(&uringVfs, 0) != SQLITE_OK) {
+            return nullptr;
+        }
+        ring = newRing.release();
+        return VFS_NAME;
+    }
+
+}
+
+namespace DatabaseAbstractions {
+
+    const char* RegisterUringVfs() {
+        static const char* const name = Register();
+        return name;
+    }
+
+}
+
+#else /* not SQLITE_ABSTRACTIONS_HAVE_IO_URING */
+
+namespace DatabaseAbstractions {
+
+    const char* RegisterUringVfs() {
+        return nullptr;
+    }
+
+}
+
+#endif /* SQLITE_ABSTRACTIONS_HAVE_IO_URING */
@@ -0,0 +1,31 @@
+#pragma once
+
+/**
+ * @file UringVfs.hpp
+ *
+ * This module declares the function which registers the io_uring-backed
+ * SQLite virtual file system (VFS).
+ */
+
+namespace DatabaseAbstractions {
+
+    /**
+     * Register with SQLite, if not already registered, a virtual file
+     * system (VFS) which wraps the default one.  It batches writes to the
+     * database, rollback journal, and write-ahead log, submitting them
+     * together through io_uring along with any sync which follows them.
+     * It also prefetches database pages in large batches when they're
+     * read sequentially, such as during table scans and snapshots.
+     * All other operations are passed through to the default VFS.
+     *
+     * @return
+     *     The name of the VFS to give SQLite when opening a database
+     *     is returned.
+     *
+     * @retval nullptr
+     *     This is returned if io_uring isn't available, in which case
+     *     the default VFS should be used.
+     */
+    const char* RegisterUringVfs();
+
+}
@@ -0,0 +1,438 @@
+/**
+ * @file UserFunctions.cpp
+ *
+ * This module contains the implementation of the functions which register
+ * SQL functions implemented in C++ with SQLite, along with the classes
+ * used to pass arguments to them and get results from them.
+ */
+
+#include "UserFunctions.hpp"
+
+#include <exception>
+
+namespace {
+
+    using DatabaseAbstractions::SQLiteDatabase;
+    using DatabaseAbstractions::UserFunction;
+
+    /**
+     * This is the type of data SQLite holds for each SQL function
+     * implemented in C++.
+     */
+    using UserFunctionReference = std::shared_ptr< const UserFunction >;
+
+    /**
+     * This is the error message reported when an SQL function implemented
+     * in C++ throws an exception which isn't a standard exception.
+     */
+    constexpr const char* UNKNOWN_EXCEPTION_MESSAGE = "unknown exception thrown by function";
+
+    /**
+     * Return the definition of the SQL function being called.
+     *
+     * @param[in] context
+     *     This is the SQLite context of the function call.
+     *
+     * @return
+     *     The definition of the SQL function being called is returned.
+     */
+    const UserFunction& GetUserFunction(sqlite3_context* context) {
+        return **(const UserFunctionReference*)sqlite3_user_data(context);
+    }
+
+    /**
+     * Return the state of the group of rows being aggregated by
+     * the aggregate function being called, making it if necessary.
+     *
+     * @param[in] context
+     *     This is the SQLite context of the function call.
+     *
+     * @return
+     *     The state of the group of rows being aggregated is returned.
+     *
+     * @retval nullptr
+     *     This is returned if the state could not be made, in which
+     *     case an error has been set as the result of the function.
+     */
+    SQLiteDatabase::Aggregate* GetAggregate(sqlite3_context* context) {
+        const auto slot = (SQLiteDatabase::Aggregate**)sqlite3_aggregate_context(
+            context,
+            sizeof(SQLiteDatabase::Aggregate*)
+        );
+        if (slot == nullptr) {
+            sqlite3_result_error_nomem(context);
+            return nullptr;
+        }
+        if (*slot == nullptr) {
+            *slot = GetUserFunction(context).aggregate().release();
+            if (*slot == nullptr) {
+                sqlite3_result_error(context, "unable to make aggregate state", -1);
+            }
+        }
+        return *slot;
+    }
+
+    /**
+     * Call the given function, reporting any exception it throws as
+     * an error result of the SQL function being called, since exceptions
+     * must not propagate through SQLite.
+     *
+     * @param[in] context
+     *     This is the SQLite context of the function call.
+     *
+     * @param[in] function
+     *     This is the function to call.
+     */
+    template< typename F > void CallGuarded(
+        sqlite3_context* context,
+        F function
+    ) {
+        try {
+            function();
+        } catch (const std::exception& e) {
+            sqlite3_result_error(context, e.what(), -1);
+        } catch (...) {
+            sqlite3_result_error(context, UNKNOWN_EXCEPTION_MESSAGE, -1);
+        }
+    }
+
+    /**
+     * This is called by SQLite to compute the result of a scalar
+     * SQL function implemented in C++.
+     *
+     * @param[in] context
+     *     This is the SQLite context of the function call.
+     *
+     * @param[in] argc
+     *     This is the number of arguments passed to the function.
+     *
+     * @param[in] argv
+     *     These are the arguments passed to the function.
+     */
+    void OnScalar(sqlite3_context* context, int argc, sqlite3_value** argv) {
+        CallGuarded(
+            context,
+            [context, argc, argv]{
+                const SQLiteDatabase::FunctionArguments arguments(argc, argv);
+                SQLiteDatabase::FunctionResult result(context);
+                GetUserFunction(context).scalar(arguments, result);
+            }
+        );
+    }
+
+    /**
+     * This is called by SQLite to add a row to the group or window of
+     * rows being aggregated by an aggregate SQL function implemented in C++.
+     *
+     * @param[in] context
+     *     This is the SQLite context of the function call.
+     *
+     * @param[in] argc
+     *     This is the number of arguments passed to the function.
+     *
+     * @param[in] argv
+     *     These are the arguments passed to the function.
+     */
+    void OnStep(sqlite3_context* context, int argc, sqlite3_value** argv) {
+        CallGuarded(
+            context,
+            [context, argc, argv]{
+                const auto aggregate = GetAggregate(context);
+                if (aggregate != nullptr) {
+                    aggregate->Step(SQLiteDatabase::FunctionArguments(argc, argv));
+                }
+            }
+        );
+    }
+
+    /**
+     * This is called by SQLite to remove a row from the window of
+     * rows being aggregated by a window SQL function implemented in C++.
+     *
+     * @param[in] context
+     *     This is the SQLite context of the function call.
+     *
+     * @param[in] argc
+     *     This is the number of arguments passed to the function.
+     *
+     * @param[in] argv
+     *     These are the arguments passed to the function.
+     */
+    void OnInverse(sqlite3_context* context, int argc, sqlite3_value** argv) {
+        CallGuarded(
+            context,
+            [context, argc, argv]{
+                const auto aggregate = GetAggregate(context);
+                if (aggregate != nullptr) {
+                    aggregate->Inverse(SQLiteDatabase::FunctionArguments(argc, argv));
+                }
+            }
+        );
+    }
+
+    /**
+     * This is called by SQLite to compute the current result of a window
+     * SQL function implemented in C++.
+     *
+     * @param[in] context
+     *     This is the SQLite context of the function call.
+     */
+    void OnValue(sqlite3_context* context) {
+        CallGuarded(
+            context,
+            [context]{
+                const auto aggregate = GetAggregate(context);
+                if (aggregate != nullptr) {
+                    SQLiteDatabase::FunctionResult result(context);
+                    aggregate->GetResult(result);
+                }
+            }
+        );
+    }
+
+    /**
+     * This is called by SQLite to compute the final result of an
+     * aggregate or window SQL function implemented in C++, and
+     * to free the state of the group of rows aggregated.
+     *
+     * @param[in] context
+     *     This is the SQLite context of the function call.
+     */
+    void OnFinal(sqlite3_context* context) {
+        const auto slot = (SQLiteDatabase::Aggregate**)sqlite3_aggregate_context(context, 0);
+        std::unique_ptr< SQLiteDatabase::Aggregate > aggregate;
+        if (slot != nullptr) {
+            aggregate.reset(*slot);
+            *slot = nullptr;
+        }
+        CallGuarded(
+            context,
+            [context, &aggregate]{
+                if (aggregate == nullptr) {
+                    // No rows were aggregated, so make empty state
+                    // to get the result for an empty group.
+                    aggregate = GetUserFunction(context).aggregate();
+                }
+                if (aggregate == nullptr) {
+                    sqlite3_result_error(context, "unable to make aggregate state", -1);
+                    return;
+                }
+                SQLiteDatabase::FunctionResult result(context);
+                aggregate->GetResult(result);
+            }
+        );
+    }
+
+    /**
+     * This is called by SQLite to free the data it holds for an SQL
+     * function implemented in C++.
+     *
+     * @param[in] userData
+     *     This is the data SQLite holds for the function.
+     */
+    void OnDestroy(void* userData) {
+        delete (UserFunctionReference*)userData;
+    }
+
+}
+
+namespace DatabaseAbstractions {
+
+    SQLiteDatabase::FunctionArguments::FunctionArguments(
+        int count,
+        sqlite3_value** values
+    )
+        : count_(count)
+        , values_(values)
+    {
+    }
+
+    size_t SQLiteDatabase::FunctionArguments::GetCount() const {
+        return (size_t)count_;
+    }
+
+    bool SQLiteDatabase::FunctionArguments::IsNull(size_t index) const {
+        return (
+            (index >= (size_t)count_)
+            || (sqlite3_value_type(values_[index]) == SQLITE_NULL)
+        );
+    }
+
+    Value SQLiteDatabase::FunctionArguments::Get(
+        size_t index,
+        Value::Type type
+    ) const {
+        if (index >= (size_t)count_) {
+            return Value();
+        }
+        const auto value = values_[index];
+        if (sqlite3_value_type(value) == SQLITE_NULL) {
+            return Value(nullptr);
+        }
+        switch (type) {
+            case Value::Type::Text: {
+                const auto text = (const char*)sqlite3_value_text(value);
+                return Value(
+                    std::string(
+                        text,
+                        (size_t)sqlite3_value_bytes(value)
+                    )
+                );
+            }
+
+            case Value::Type::Integer: {
+                return Value((intmax_t)sqlite3_value_int64(value));
+            }
+
+            case Value::Type::Real: {
+                return Value(sqlite3_value_double(value));
+            }
+
+            case Value::Type::Boolean: {
+                return Value(sqlite3_value_int(value) != 0);
+            }
+
+            default: return Value();
+        }
+    }
+
+    size_t SQLiteDatabase::FunctionArguments::GetBlobSize(size_t index) const {
+        if (index >= (size_t)count_) {
+            return 0;
+        }
+        // The blob must be fetched before its size is measured, in case
+        // the value has to be converted to a blob first.
+        (void)sqlite3_value_blob(values_[index]);
+        return (size_t)sqlite3_value_bytes(values_[index]);
+    }
+
+    const uint8_t* SQLiteDatabase::FunctionArguments::GetBlob(size_t index) const {
+        if (index >= (size_t)count_) {
+            return nullptr;
+        }
+        return (const uint8_t*)sqlite3_value_blob(values_[index]);
+    }
+
+    SQLiteDatabase::FunctionResult::FunctionResult(sqlite3_context* context)
+        : context_(context)
+    {
+    }
+
+    void SQLiteDatabase::FunctionResult::Set(const Value& value) {
+        switch (value.GetType()) {
+            case Value::Type::Text: {
+                const auto& text = (const std::string&)value;
+                sqlite3_result_text64(
+                    context_,
+                    text.c_str(),
+                    (sqlite3_uint64)text.length(),
+                    SQLITE_TRANSIENT,
+                    SQLITE_UTF8
+                );
+            } break;
+
+            case Value::Type::Integer: {
+                sqlite3_result_int64(context_, (sqlite3_int64)(intmax_t)value);
+            } break;
+
+            case Value::Type::Real: {
+                sqlite3_result_double(context_, (double)value);
+            } break;
+
+            case Value::Type::Boolean: {
+                sqlite3_result_int(context_, (bool)value ? 1 : 0);
+            } break;
+
+            default: {
+                sqlite3_result_null(context_);
+            } break;
+        }
+    }
+
+    void SQLiteDatabase::FunctionResult::SetBlob(const uint8_t* data, size_t size) {
+        sqlite3_result_blob64(
+            context_,
+            (size == 0) ? (const void*)"" : data,
+            (sqlite3_uint64)size,
+            SQLITE_TRANSIENT
+        );
+    }
+
+    uint8_t* SQLiteDatabase::FunctionResult::AllocateBlob(size_t size) {
+        const auto db = sqlite3_context_db_handle(context_);
+        if (size > (size_t)sqlite3_limit(db, SQLITE_LIMIT_LENGTH, -1)) {
+            sqlite3_result_error_toobig(context_);
+            return nullptr;
+        }
+        const auto data = (uint8_t*)sqlite3_malloc64((sqlite3_uint64)((size == 0) ? 1 : size));
+        if (data == nullptr) {
+            sqlite3_result_error_nomem(context_);
+            return nullptr;
+        }
+        // SQLite takes ownership of the bytes rather than copying them,
+        // so they can still be filled in after the result is set.
+        sqlite3_result_blob64(context_, data, (sqlite3_uint64)size, sqlite3_free);
+        return data;
+    }
+
+    void SQLiteDatabase::FunctionResult::SetError(const std::string& message) {
+        sqlite3_result_error(context_, message.c_str(), (int)message.length());
+    }
+
+    std::string RegisterUserFunction(
+        sqlite3* db,
+        const std::shared_ptr< const UserFunction >& function
+    ) {
+        const auto flags = SQLITE_UTF8 | SQLITE_DETERMINISTIC;
+        const auto userData = new UserFunctionReference(function);
+        int result;
+        if (function->window) {
+#if SQLITE_VERSION_NUMBER >= 3025000
+            result = sqlite3_create_window_function(
+                db,
+                function->name.c_str(),
+                function->argumentCount,
+                flags,
+                userData,
+                OnStep,
+                OnFinal,
+                OnValue,
+                OnInverse,
+                OnDestroy
+            );
+#else /* SQLITE_VERSION_NUMBER < 3025000 */
+            OnDestroy(userData);
+            return "window functions require SQLite 3.25.0 or later";
+#endif /* SQLITE_VERSION_NUMBER */
+        } else if (function->aggregate) {
+            result = sqlite3_create_function_v2(
+                db,
+                function->name.c_str(),
+                function->argumentCount,
+                flags,
+                userData,
+                NULL,
+                OnStep,
+                OnFinal,
+                OnDestroy
+            );
+        } else {
+            result = sqlite3_create_function_v2(
+                db,
+                function->name.c_str(),
+                function->argumentCount,
+                flags,
+                userData,
+                OnScalar,
+                NULL,
+                NULL,
+                OnDestroy
+            );
+        }
+        if (result != SQLITE_OK) {
+            return sqlite3_errmsg(db);
+        }
+        return "";
+    }
+
+}
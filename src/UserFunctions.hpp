@@ -0,0 +1,71 @@
+#pragma once
+
+/**
+ * @file UserFunctions.hpp
+ *
+ * This module declares the functions which register SQL functions
+ * implemented in C++ with SQLite.
+ */
+
+#include <memory>
+#include <sqlite3.h>
+#include <SQLiteAbstractions/SQLiteDatabase.hpp>
+#include <string>
+
+namespace DatabaseAbstractions {
+
+    /**
+     * This holds the definition of an SQL function implemented in C++.
+     */
+    struct UserFunction {
+        /**
+         * This is the name of the function in SQL.
+         */
+        std::string name;
+
+        /**
+         * This is the number of arguments the function takes,
+         * or -1 if it takes any number of arguments.
+         */
+        int argumentCount = -1;
+
+        /**
+         * If the function is a scalar function, this is called to
+         * compute its result.
+         */
+        SQLiteDatabase::ScalarFunction scalar;
+
+        /**
+         * If the function is an aggregate function, this is called to
+         * make the state for each group of rows it aggregates.
+         */
+        SQLiteDatabase::AggregateFactory aggregate;
+
+        /**
+         * This indicates whether or not the aggregate function may
+         * also be used as a window function.
+         */
+        bool window = false;
+    };
+
+    /**
+     * Register the given SQL function implemented in C++ with the given
+     * database connection.
+     *
+     * @param[in] db
+     *     This is the database connection with which to register
+     *     the function.
+     *
+     * @param[in] function
+     *     This is the definition of the function to register.
+     *
+     * @return
+     *     An error message is returned if the function could not be
+     *     registered.  Otherwise, an empty string is returned.
+     */
+    std::string RegisterUserFunction(
+        sqlite3* db,
+        const std::shared_ptr< const UserFunction >& function
+    );
+
+}
@@ -0,0 +1,399 @@
+/**
+ * @file VectorFunctions.cpp
+ *
+ * This module contains the implementation of the built-in SQL functions
+ * operating on vectors of 32-bit floating-point values stored as blobs.
+ */
+
+#include "VectorFunctions.hpp"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define SQLITE_ABSTRACTIONS_VECTOR_AVX
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 1))
+#include <xmmintrin.h>
+#define SQLITE_ABSTRACTIONS_VECTOR_SSE
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define SQLITE_ABSTRACTIONS_VECTOR_NEON
+#endif
+
+namespace {
+
+    /**
+     * This is the number of bytes in each value of a vector.
+     */
+    constexpr size_t VALUE_SIZE = sizeof(float);
+
+    /**
+     * These are the flags given to SQLite when registering the
+     * built-in vector functions.
+     */
+#ifdef SQLITE_INNOCUOUS
+    constexpr int FUNCTION_FLAGS = SQLITE_UTF8 | SQLITE_DETERMINISTIC | SQLITE_INNOCUOUS;
+#else /* SQLITE_INNOCUOUS */
+    constexpr int FUNCTION_FLAGS = SQLITE_UTF8 | SQLITE_DETERMINISTIC;
+#endif /* SQLITE_INNOCUOUS */
+
+    /**
+     * Return the 32-bit floating-point value at the given location,
+     * which need not be aligned in memory.
+     *
+     * @param[in] data
+     *     This points to the value to return.
+     *
+     * @return
+     *     The value at the given location is returned.
+     */
+    float LoadValue(const uint8_t* data) {
+        float value;
+        (void)memcpy(&value, data, VALUE_SIZE);
+        return value;
+    }
+
+    // Each instruction set supported below provides the same small set of
+    // helpers used by the kernels: LoadLanes (load LANES values, which
+    // need not be aligned), SumLanes (add up all lanes), ZeroLanes,
+    // MultiplyAdd (sum + lhs * rhs, per lane), and Subtract.
+
+#if defined(SQLITE_ABSTRACTIONS_VECTOR_AVX)
+    /**
+     * This is the number of values processed together by the kernels.
+     */
+    constexpr size_t LANES = 8;
+
+    /**
+     * This is the type of register holding values processed together.
+     */
+    using Lanes = __m256;
+
+    Lanes LoadLanes(const uint8_t* data) {
+        return _mm256_loadu_ps((const float*)data);
+    }
+
+    float SumLanes(Lanes lanes) {
+        const auto halves = _mm_add_ps(
+            _mm256_castps256_ps128(lanes),
+            _mm256_extractf128_ps(lanes, 1)
+        );
+        const auto pairs = _mm_add_ps(halves, _mm_movehl_ps(halves, halves));
+        return _mm_cvtss_f32(_mm_add_ss(pairs, _mm_shuffle_ps(pairs, pairs, 1)));
+    }
+
+    Lanes ZeroLanes() {
+        return _mm256_setzero_ps();
+    }
+
+    Lanes MultiplyAdd(Lanes sum, Lanes lhs, Lanes rhs) {
+        return _mm256_add_ps(sum, _mm256_mul_ps(lhs, rhs));
+    }
+
+    Lanes Subtract(Lanes lhs, Lanes rhs) {
+        return _mm256_sub_ps(lhs, rhs);
+    }
+#elif defined(SQLITE_ABSTRACTIONS_VECTOR_SSE)
+    /**
+     * This is the number of values processed together by the kernels.
+     */
+    constexpr size_t LANES = 4;
+
+    /**
+     * This is the type of register holding values processed together.
+     */
+    using Lanes = __m128;
+
+    Lanes LoadLanes(const uint8_t* data) {
+        return _mm_loadu_ps((const float*)data);
+    }
+
+    float SumLanes(Lanes lanes) {
+        const auto pairs = _mm_add_ps(lanes, _mm_movehl_ps(lanes, lanes));
+        return _mm_cvtss_f32(_mm_add_ss(pairs, _mm_shuffle_ps(pairs, pairs, 1)));
+    }
+
+    Lanes ZeroLanes() {
+        return _mm_setzero_ps();
+    }
+
+    Lanes MultiplyAdd(Lanes sum, Lanes lhs, Lanes rhs) {
+        return _mm_add_ps(sum, _mm_mul_ps(lhs, rhs));
+    }
+
+    Lanes Subtract(Lanes lhs, Lanes rhs) {
+        return _mm_sub_ps(lhs, rhs);
+    }
+#elif defined(SQLITE_ABSTRACTIONS_VECTOR_NEON)
+    /**
+     * This is the number of values processed together by the kernels.
+     */
+    constexpr size_t LANES = 4;
+
+    /**
+     * This is the type of register holding values processed together.
+     */
+    using Lanes = float32x4_t;
+
+    Lanes LoadLanes(const uint8_t* data) {
+        return vreinterpretq_f32_u8(vld1q_u8(data));
+    }
+
+    float SumLanes(Lanes lanes) {
+        const auto pairs = vadd_f32(vget_low_f32(lanes), vget_high_f32(lanes));
+        return vget_lane_f32(vpadd_f32(pairs, pairs), 0);
+    }
+
+    Lanes ZeroLanes() {
+        return vdupq_n_f32(0.0f);
+    }
+
+    Lanes MultiplyAdd(Lanes sum, Lanes lhs, Lanes rhs) {
+        return vmlaq_f32(sum, lhs, rhs);
+    }
+
+    Lanes Subtract(Lanes lhs, Lanes rhs) {
+        return vsubq_f32(lhs, rhs);
+    }
+#endif
+
+    /**
+     * Check the arguments of a built-in function which takes two vectors,
+     * setting the result of the function if they aren't usable.
+     *
+     * @param[in] context
+     *     This is the SQLite context of the function call.
+     *
+     * @param[in] argv
+     *     These are the arguments passed to the function.
+     *
+     * @param[out] lhs
+     *     This is where to store a pointer to the first vector.
+     *
+     * @param[out] rhs
+     *     This is where to store a pointer to the second vector.
+     *
+     * @param[out] count
+     *     This is where to store the number of values in each vector.
+     *
+     * @return
+     *     An indication of whether or not the vectors are usable
+     *     is returned.
+     */
+    bool GetVectors(
+        sqlite3_context* context,
+        sqlite3_value** argv,
+        const uint8_t*& lhs,
+        const uint8_t*& rhs,
+        size_t& count
+    ) {
+        if (
+            (sqlite3_value_type(argv[0]) == SQLITE_NULL)
+            || (sqlite3_value_type(argv[1]) == SQLITE_NULL)
+        ) {
+            sqlite3_result_null(context);
+            return false;
+        }
+        lhs = (const uint8_t*)sqlite3_value_blob(argv[0]);
+        rhs = (const uint8_t*)sqlite3_value_blob(argv[1]);
+        const auto lhsSize = (size_t)sqlite3_value_bytes(argv[0]);
+        const auto rhsSize = (size_t)sqlite3_value_bytes(argv[1]);
+        if (
+            (lhsSize != rhsSize)
+            || ((lhsSize % VALUE_SIZE) != 0)
+        ) {
+            sqlite3_result_error(
+                context,
+                "vectors must be blobs of 32-bit floating-point values of equal length",
+                -1
+            );
+            return false;
+        }
+        count = lhsSize / VALUE_SIZE;
+        return true;
+    }
+
+    /**
+     * This is called by SQLite to compute the result of
+     * the float32_blob function.
+     *
+     * @param[in] context
+     *     This is the SQLite context of the function call.
+     *
+     * @param[in] argc
+     *     This is the number of arguments passed to the function.
+     *
+     * @param[in] argv
+     *     These are the arguments passed to the function.
+     */
+    void OnFloat32Blob(sqlite3_context* context, int argc, sqlite3_value** argv) {
+        (void)argc;
+        switch (sqlite3_value_type(argv[0])) {
+            case SQLITE_NULL:
+            case SQLITE_BLOB: {
+                sqlite3_result_value(context, argv[0]);
+                return;
+            }
+
+            default: break;
+        }
+        auto text = (const char*)sqlite3_value_text(argv[0]);
+        std::vector< float > values;
+        for (;;) {
+            while (
+                (*text == ' ')
+                || (*text == '\t')
+                || (*text == '\r')
+                || (*text == '\n')
+                || (*text == '[')
+                || (*text == ']')
+                || (*text == ',')
+            ) {
+                ++text;
+            }
+            if (*text == '\0') {
+                break;
+            }
+            char* end;
+            const auto value = strtod(text, &end);
+            if (end == text) {
+                sqlite3_result_error(context, "invalid number in vector", -1);
+                return;
+            }
+            values.push_back((float)value);
+            text = end;
+        }
+        sqlite3_result_blob64(
+            context,
+            values.empty() ? (const void*)"" : values.data(),
+            (sqlite3_uint64)(values.size() * VALUE_SIZE),
+            SQLITE_TRANSIENT
+        );
+    }
+
+    /**
+     * This is called by SQLite to compute the result of
+     * the dot_product function.
+     *
+     * @param[in] context
+     *     This is the SQLite context of the function call.
+     *
+     * @param[in] argc
+     *     This is the number of arguments passed to the function.
+     *
+     * @param[in] argv
+     *     These are the arguments passed to the function.
+     */
+    void OnDotProduct(sqlite3_context* context, int argc, sqlite3_value** argv) {
+        (void)argc;
+        const uint8_t* lhs;
+        const uint8_t* rhs;
+        size_t count;
+        if (GetVectors(context, argv, lhs, rhs, count)) {
+            sqlite3_result_double(
+                context,
+                (double)DatabaseAbstractions::DotProduct(lhs, rhs, count)
+            );
+        }
+    }
+
+    /**
+     * This is called by SQLite to compute the result of
+     * the l2_distance function.
+     *
+     * @param[in] context
+     *     This is the SQLite context of the function call.
+     *
+     * @param[in] argc
+     *     This is the number of arguments passed to the function.
+     *
+     * @param[in] argv
+     *     These are the arguments passed to the function.
+     */
+    void OnL2Distance(sqlite3_context* context, int argc, sqlite3_value** argv) {
+        (void)argc;
+        const uint8_t* lhs;
+        const uint8_t* rhs;
+        size_t count;
+        if (GetVectors(context, argv, lhs, rhs, count)) {
+            sqlite3_result_double(
+                context,
+                sqrt((double)DatabaseAbstractions::SquaredL2Distance(lhs, rhs, count))
+            );
+        }
+    }
+
+}
+
+namespace DatabaseAbstractions {
+
+    float DotProduct(const uint8_t* lhs, const uint8_t* rhs, size_t count) {
+        size_t i = 0;
+        float sum = 0.0f;
+#if defined(SQLITE_ABSTRACTIONS_VECTOR_AVX) || defined(SQLITE_ABSTRACTIONS_VECTOR_SSE) || defined(SQLITE_ABSTRACTIONS_VECTOR_NEON)
+        auto lanes = ZeroLanes();
+        for (; i + LANES <= count; i += LANES) {
+            lanes = MultiplyAdd(
+                lanes,
+                LoadLanes(lhs + i * VALUE_SIZE),
+                LoadLanes(rhs + i * VALUE_SIZE)
+            );
+        }
+        sum = SumLanes(lanes);
+#endif
+        for (; i < count; ++i) {
+            sum += LoadValue(lhs + i * VALUE_SIZE) * LoadValue(rhs + i * VALUE_SIZE);
+        }
+        return sum;
+    }
+
+    float SquaredL2Distance(const uint8_t* lhs, const uint8_t* rhs, size_t count) {
+        size_t i = 0;
+        float sum = 0.0f;
+#if defined(SQLITE_ABSTRACTIONS_VECTOR_AVX) || defined(SQLITE_ABSTRACTIONS_VECTOR_SSE) || defined(SQLITE_ABSTRACTIONS_VECTOR_NEON)
+        auto lanes = ZeroLanes();
+        for (; i + LANES <= count; i += LANES) {
+            const auto difference = Subtract(
+                LoadLanes(lhs + i * VALUE_SIZE),
+                LoadLanes(rhs + i * VALUE_SIZE)
+            );
+            lanes = MultiplyAdd(lanes, difference, difference);
+        }
+        sum = SumLanes(lanes);
+#endif
+        for (; i < count; ++i) {
+            const auto difference = LoadValue(lhs + i * VALUE_SIZE) - LoadValue(rhs + i * VALUE_SIZE);
+            sum += difference * difference;
+        }
+        return sum;
+    }
+
+    void RegisterVectorFunctions(sqlite3* db) {
+        static const struct {
+            const char* name;
+            int argumentCount;
+            void (*function)(sqlite3_context*, int, sqlite3_value**);
+        } functions[] = {
+            {"float32_blob", 1, OnFloat32Blob},
+            {"dot_product", 2, OnDotProduct},
+            {"l2_distance", 2, OnL2Distance},
+        };
+        for (const auto& function: functions) {
+            (void)sqlite3_create_function_v2(
+                db,
+                function.name,
+                function.argumentCount,
+                FUNCTION_FLAGS,
+                NULL,
+                function.function,
+                NULL,
+                NULL,
+                NULL
+            );
+        }
+    }
+
+}
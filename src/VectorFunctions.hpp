@@ -0,0 +1,68 @@
+#pragma once
+
+/**
+ * @file VectorFunctions.hpp
+ *
+ * This module declares the functions which register with SQLite the
+ * built-in SQL functions operating on vectors of 32-bit floating-point
+ * values stored as blobs.
+ */
+
+#include <sqlite3.h>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace DatabaseAbstractions {
+
+    /**
+     * Compute the dot product of two vectors of 32-bit floating-point
+     * values, which need not be aligned in memory.
+     *
+     * @param[in] lhs
+     *     This points to the first vector.
+     *
+     * @param[in] rhs
+     *     This points to the second vector.
+     *
+     * @param[in] count
+     *     This is the number of values in each vector.
+     *
+     * @return
+     *     The dot product of the two vectors is returned.
+     */
+    float DotProduct(const uint8_t* lhs, const uint8_t* rhs, size_t count);
+
+    /**
+     * Compute the square of the Euclidean distance between two vectors
+     * of 32-bit floating-point values, which need not be aligned in memory.
+     *
+     * @param[in] lhs
+     *     This points to the first vector.
+     *
+     * @param[in] rhs
+     *     This points to the second vector.
+     *
+     * @param[in] count
+     *     This is the number of values in each vector.
+     *
+     * @return
+     *     The square of the Euclidean distance between the two vectors
+     *     is returned.
+     */
+    float SquaredL2Distance(const uint8_t* lhs, const uint8_t* rhs, size_t count);
+
+    /**
+     * Register with the given database connection the built-in SQL
+     * functions which operate on vectors of 32-bit floating-point
+     * values stored as blobs:
+     * - float32_blob(text)
+     * - dot_product(a, b)
+     * - l2_distance(a, b)
+     *
+     * @param[in] db
+     *     This is the database connection with which to register
+     *     the functions.
+     */
+    void RegisterVectorFunctions(sqlite3* db);
+
+}
@@ -0,0 +1,523 @@
+/**
+ * @file VirtualTables.cpp
+ *
+ * This module contains the implementation of the function which registers
+ * virtual tables implemented in C++ with SQLite.
+ */
+
+#include "VirtualTables.hpp"
+
+#include <exception>
+#include <string.h>
+#include <vector>
+
+namespace {
+
+    using DatabaseAbstractions::SQLiteDatabase;
+
+    /**
+     * This is the type of data SQLite holds for each module
+     * registered for a virtual table implemented in C++.
+     */
+    using VirtualTableReference = std::shared_ptr< SQLiteDatabase::VirtualTable >;
+
+    /**
+     * This is the estimated cost given to SQLite for looking up
+     * rows by the value in a key column.
+     */
+    constexpr double KEY_LOOKUP_COST = 10.0;
+
+    /**
+     * This holds the state of a virtual table connected to a database.
+     */
+    struct Table
+        : public sqlite3_vtab
+    {
+        /**
+         * This is the table implemented in C++.
+         */
+        VirtualTableReference table;
+
+        /**
+         * These are the columns of the table.
+         */
+        std::vector< SQLiteDatabase::VirtualTableColumn > columns;
+    };
+
+    /**
+     * This holds the state of a cursor iterating through the rows
+     * of a virtual table.
+     */
+    struct Cursor
+        : public sqlite3_vtab_cursor
+    {
+        /**
+         * This is the cursor implemented in C++, if any.  If there is
+         * none, there are no rows to iterate.
+         */
+        std::unique_ptr< SQLiteDatabase::VirtualTableCursor > cursor;
+
+        /**
+         * This is the number of the current row.
+         */
+        sqlite3_int64 rowid = 0;
+    };
+
+    /**
+     * Return the text used to declare the given type of column
+     * to SQLite.
+     *
+     * @param[in] type
+     *     This is the type of the column.
+     *
+     * @return
+     *     The text used to declare the type of column is returned.
+     */
+    const char* GetDeclaredType(DatabaseAbstractions::Value::Type type) {
+        switch (type) {
+            case DatabaseAbstractions::Value::Type::Text: return " TEXT";
+            case DatabaseAbstractions::Value::Type::Integer: return " INTEGER";
+            case DatabaseAbstractions::Value::Type::Real: return " REAL";
+            case DatabaseAbstractions::Value::Type::Boolean: return " BOOLEAN";
+            default: return "";
+        }
+    }
+
+    /**
+     * Return the given identifier, quoted for use in an SQL statement.
+     *
+     * @param[in] identifier
+     *     This is the identifier to quote.
+     *
+     * @return
+     *     The quoted identifier is returned.
+     */
+    std::string QuoteIdentifier(const std::string& identifier) {
+        std::string quoted("\"");
+        for (auto c: identifier) {
+            if (c == '"') {
+                quoted.push_back('"');
+            }
+            quoted.push_back(c);
+        }
+        quoted.push_back('"');
+        return quoted;
+    }
+
+    /**
+     * Set the error message reported by SQLite for the given
+     * virtual table.
+     *
+     * @param[in] vtab
+     *     This is the virtual table for which to set the error message.
+     *
+     * @param[in] message
+     *     This is the error message to set.
+     */
+    void SetError(sqlite3_vtab* vtab, const char* message) {
+        sqlite3_free(vtab->zErrMsg);
+        vtab->zErrMsg = sqlite3_mprintf("%s", message);
+    }
+
+    /**
+     * Call the given function, reporting any exception it throws as
+     * an error of the given virtual table, since exceptions must not
+     * propagate through SQLite.
+     *
+     * @param[in] vtab
+     *     This is the virtual table for which to report any error.
+     *
+     * @param[in] function
+     *     This is the function to call.
+     *
+     * @return
+     *     The SQLite result code for the call is returned.
+     */
+    template< typename F > int CallGuarded(
+        sqlite3_vtab* vtab,
+        F function
+    ) {
+        try {
+            function();
+            return SQLITE_OK;
+        } catch (const std::exception& e) {
+            SetError(vtab, e.what());
+        } catch (...) {
+            SetError(vtab, "unknown exception thrown by virtual table");
+        }
+        return SQLITE_ERROR;
+    }
+
+    /**
+     * This is called by SQLite to connect a virtual table to a database.
+     *
+     * @param[in] db
+     *     This is the database connection.
+     *
+     * @param[in] aux
+     *     This is the data SQLite holds for the module.
+     *
+     * @param[in] argc
+     *     This is the number of module arguments.
+     *
+     * @param[in] argv
+     *     These are the module arguments.
+     *
+     * @param[out] vtab
+     *     This is where to store the state of the connected table.
+     *
+     * @param[out] errorMessage
+     *     This is where to store any error message.
+     *
+     * @return
+     *     The SQLite result code for the call is returned.
+     */
+    int OnConnect(
+        sqlite3* db,
+        void* aux,
+        int argc,
+        const char* const* argv,
+        sqlite3_vtab** vtab,
+        char** errorMessage
+    ) {
+        (void)argc;
+        (void)argv;
+        std::unique_ptr< Table > table(new Table());
+        table->table = *(const VirtualTableReference*)aux;
+        try {
+            table->columns = table->table->GetColumns();
+        } catch (const std::exception& e) {
+            *errorMessage = sqlite3_mprintf("%s", e.what());
+            return SQLITE_ERROR;
+        } catch (...) {
+            *errorMessage = sqlite3_mprintf("unknown exception thrown by virtual table");
+            return SQLITE_ERROR;
+        }
+        std::string schema = "CREATE TABLE x(";
+        bool first = true;
+        for (const auto& column: table->columns) {
+            if (!first) {
+                schema += ", ";
+            }
+            first = false;
+            schema += QuoteIdentifier(column.name);
+            schema += GetDeclaredType(column.type);
+        }
+        schema += ")";
+        const auto result = sqlite3_declare_vtab(db, schema.c_str());
+        if (result != SQLITE_OK) {
+            *errorMessage = sqlite3_mprintf("%s", sqlite3_errmsg(db));
+            return result;
+        }
+        *vtab = table.release();
+        return SQLITE_OK;
+    }
+
+    /**
+     * This is called by SQLite to disconnect a virtual table
+     * from a database.
+     *
+     * @param[in] vtab
+     *     This is the state of the connected table.
+     *
+     * @return
+     *     The SQLite result code for the call is returned.
+     */
+    int OnDisconnect(sqlite3_vtab* vtab) {
+        sqlite3_free(vtab->zErrMsg);
+        delete static_cast< Table* >(vtab);
+        return SQLITE_OK;
+    }
+
+    /**
+     * This is called by SQLite to find out how best to look up rows
+     * of a virtual table, given the constraints of a query.  If the
+     * query compares a key column to a value for equality, the rows
+     * are looked up by that value.  Otherwise, all rows are scanned.
+     *
+     * @param[in] vtab
+     *     This is the state of the connected table.
+     *
+     * @param[in,out] info
+     *     This holds the constraints of the query, and is where
+     *     to store the chosen plan.
+     *
+     * @return
+     *     The SQLite result code for the call is returned.
+     */
+    int OnBestIndex(sqlite3_vtab* vtab, sqlite3_index_info* info) {
+        const auto table = static_cast< Table* >(vtab);
+        size_t rowCount = 0;
+        const auto result = CallGuarded(
+            vtab,
+            [table, &rowCount]{
+                rowCount = table->table->EstimateRowCount();
+            }
+        );
+        if (result != SQLITE_OK) {
+            return result;
+        }
+        info->idxNum = 0;
+        info->estimatedCost = (double)rowCount;
+#if SQLITE_VERSION_NUMBER >= 3008002
+        info->estimatedRows = (sqlite3_int64)rowCount;
+#endif /* SQLITE_VERSION_NUMBER >= 3008002 */
+        for (int i = 0; i < info->nConstraint; ++i) {
+            const auto& constraint = info->aConstraint[i];
+            if (
+                !constraint.usable
+                || (constraint.op != SQLITE_INDEX_CONSTRAINT_EQ)
+                || (constraint.iColumn < 0)
+                || ((size_t)constraint.iColumn >= table->columns.size())
+                || !table->columns[constraint.iColumn].key
+            ) {
+                continue;
+            }
+            info->idxNum = constraint.iColumn + 1;
+            info->aConstraintUsage[i].argvIndex = 1;
+            info->aConstraintUsage[i].omit = 0;
+            info->estimatedCost = KEY_LOOKUP_COST;
+#if SQLITE_VERSION_NUMBER >= 3008002
+            info->estimatedRows = 1;
+#endif /* SQLITE_VERSION_NUMBER >= 3008002 */
+            break;
+        }
+        return SQLITE_OK;
+    }
+
+    /**
+     * This is called by SQLite to open a cursor for iterating through
+     * the rows of a virtual table.
+     *
+     * @param[in] vtab
+     *     This is the state of the connected table.
+     *
+     * @param[out] cursor
+     *     This is where to store the state of the cursor.
+     *
+     * @return
+     *     The SQLite result code for the call is returned.
+     */
+    int OnOpen(sqlite3_vtab* vtab, sqlite3_vtab_cursor** cursor) {
+        (void)vtab;
+        *cursor = new Cursor();
+        return SQLITE_OK;
+    }
+
+    /**
+     * This is called by SQLite to close a cursor.
+     *
+     * @param[in] cursor
+     *     This is the state of the cursor.
+     *
+     * @return
+     *     The SQLite result code for the call is returned.
+     */
+    int OnClose(sqlite3_vtab_cursor* cursor) {
+        delete static_cast< Cursor* >(cursor);
+        return SQLITE_OK;
+    }
+
+    /**
+     * This is called by SQLite to start iterating through the rows
+     * of a virtual table, using the plan chosen earlier.
+     *
+     * @param[in] cursor
+     *     This is the state of the cursor.
+     *
+     * @param[in] idxNum
+     *     This identifies the plan chosen.  If zero, all rows are scanned.
+     *     Otherwise, it's one more than the index of the key column
+     *     by which rows are looked up.
+     *
+     * @param[in] idxStr
+     *     This is not used.
+     *
+     * @param[in] argc
+     *     This is the number of values given for the plan.
+     *
+     * @param[in] argv
+     *     These are the values given for the plan.
+     *
+     * @return
+     *     The SQLite result code for the call is returned.
+     */
+    int OnFilter(
+        sqlite3_vtab_cursor* cursor,
+        int idxNum,
+        const char* idxStr,
+        int argc,
+        sqlite3_value** argv
+    ) {
+        (void)idxStr;
+        const auto tableCursor = static_cast< Cursor* >(cursor);
+        const auto table = static_cast< Table* >(cursor->pVtab);
+        tableCursor->cursor = nullptr;
+        tableCursor->rowid = 0;
+        return CallGuarded(
+            cursor->pVtab,
+            [tableCursor, table, idxNum, argc, argv]{
+                if (idxNum == 0) {
+                    tableCursor->cursor = table->table->Scan();
+                    return;
+                }
+                const auto column = (size_t)(idxNum - 1);
+                const SQLiteDatabase::FunctionArguments arguments(argc, argv);
+                if (arguments.IsNull(0)) {
+                    return;
+                }
+                tableCursor->cursor = table->table->Find(
+                    column,
+                    arguments.Get(0, table->columns[column].type)
+                );
+            }
+        );
+    }
+
+    /**
+     * This is called by SQLite to move a cursor to the next row.
+     *
+     * @param[in] cursor
+     *     This is the state of the cursor.
+     *
+     * @return
+     *     The SQLite result code for the call is returned.
+     */
+    int OnNext(sqlite3_vtab_cursor* cursor) {
+        const auto tableCursor = static_cast< Cursor* >(cursor);
+        ++tableCursor->rowid;
+        return CallGuarded(
+            cursor->pVtab,
+            [tableCursor]{
+                tableCursor->cursor->Next();
+            }
+        );
+    }
+
+    /**
+     * This is called by SQLite to find out if a cursor has moved
+     * past the last row.
+     *
+     * @param[in] cursor
+     *     This is the state of the cursor.
+     *
+     * @return
+     *     Nonzero is returned if the cursor has moved past the last row.
+     */
+    int OnEof(sqlite3_vtab_cursor* cursor) {
+        const auto tableCursor = static_cast< Cursor* >(cursor);
+        return (
+            (tableCursor->cursor == nullptr)
+            || tableCursor->cursor->IsAtEnd()
+        ) ? 1 : 0;
+    }
+
+    /**
+     * This is called by SQLite to get the value of a column
+     * in the current row of a cursor.
+     *
+     * @param[in] cursor
+     *     This is the state of the cursor.
+     *
+     * @param[in] context
+     *     This is the SQLite context used to provide the value.
+     *
+     * @param[in] column
+     *     This is the zero-based index of the column.
+     *
+     * @return
+     *     The SQLite result code for the call is returned.
+     */
+    int OnColumn(sqlite3_vtab_cursor* cursor, sqlite3_context* context, int column) {
+        const auto tableCursor = static_cast< Cursor* >(cursor);
+        return CallGuarded(
+            cursor->pVtab,
+            [tableCursor, context, column]{
+                SQLiteDatabase::FunctionResult result(context);
+                tableCursor->cursor->GetColumn((size_t)column, result);
+            }
+        );
+    }
+
+    /**
+     * This is called by SQLite to get the row number of the current row
+     * of a cursor.
+     *
+     * @param[in] cursor
+     *     This is the state of the cursor.
+     *
+     * @param[out] rowid
+     *     This is where to store the row number.
+     *
+     * @return
+     *     The SQLite result code for the call is returned.
+     */
+    int OnRowid(sqlite3_vtab_cursor* cursor, sqlite3_int64* rowid) {
+        *rowid = static_cast< Cursor* >(cursor)->rowid;
+        return SQLITE_OK;
+    }
+
+    /**
+     * This is called by SQLite to free the data it holds for a module
+     * registered for a virtual table implemented in C++.
+     *
+     * @param[in] aux
+     *     This is the data SQLite holds for the module.
+     */
+    void OnDestroyModule(void* aux) {
+        delete (VirtualTableReference*)aux;
+    }
+
+    /**
+     * Return the SQLite module for virtual tables implemented in C++.
+     * Since the module has no xCreate method, each table can only be
+     * used as an eponymous virtual table.
+     *
+     * @return
+     *     The SQLite module for virtual tables implemented in C++
+     *     is returned.
+     */
+    const sqlite3_module* GetModule() {
+        static const sqlite3_module module = []{
+            sqlite3_module module;
+            (void)memset(&module, 0, sizeof(module));
+            module.xConnect = OnConnect;
+            module.xBestIndex = OnBestIndex;
+            module.xDisconnect = OnDisconnect;
+            module.xDestroy = OnDisconnect;
+            module.xOpen = OnOpen;
+            module.xClose = OnClose;
+            module.xFilter = OnFilter;
+            module.xNext = OnNext;
+            module.xEof = OnEof;
+            module.xColumn = OnColumn;
+            module.xRowid = OnRowid;
+            return module;
+        }();
+        return &module;
+    }
+
+}
+
+namespace DatabaseAbstractions {
+
+    std::string RegisterVirtualTable(
+        sqlite3* db,
+        const std::string& name,
+        const std::shared_ptr< SQLiteDatabase::VirtualTable >& table
+    ) {
+        if (
+            sqlite3_create_module_v2(
+                db,
+                name.c_str(),
+                GetModule(),
+                new VirtualTableReference(table),
+                OnDestroyModule
+            ) != SQLITE_OK
+        ) {
+            return sqlite3_errmsg(db);
+        }
+        return "";
+    }
+
+}
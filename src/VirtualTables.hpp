@@ -0,0 +1,40 @@
+#pragma once
+
+/**
+ * @file VirtualTables.hpp
+ *
+ * This module declares the function which registers virtual tables
+ * implemented in C++ with SQLite.
+ */
+
+#include <memory>
+#include <sqlite3.h>
+#include <SQLiteAbstractions/SQLiteDatabase.hpp>
+#include <string>
+
+namespace DatabaseAbstractions {
+
+    /**
+     * Register the given table with the given database connection,
+     * as an eponymous virtual table with the given name.
+     *
+     * @param[in] db
+     *     This is the database connection with which to register the table.
+     *
+     * @param[in] name
+     *     This is the name of the table in SQL.
+     *
+     * @param[in] table
+     *     This is the table to register.
+     *
+     * @return
+     *     An error message is returned if the table could not be
+     *     registered.  Otherwise, an empty string is returned.
+     */
+    std::string RegisterVirtualTable(
+        sqlite3* db,
+        const std::string& name,
+        const std::shared_ptr< SQLiteDatabase::VirtualTable >& table
+    );
+
+}
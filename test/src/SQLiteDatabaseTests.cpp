@@ -5,15 +5,34 @@
  * SQLiteAbstractions class.
  */
 
+#include <chrono>
 #include <gtest/gtest.h>
+#include <SQLiteAbstractions/ContainerTable.hpp>
 #include <SQLiteAbstractions/SQLiteDatabase.hpp>
+#include <map>
+#include <math.h>
 #include <memory>
 #include <set>
 #include <sqlite3.h>
+#include <stdexcept>
 #include <SystemAbstractions/File.hpp>
+#include <thread>
+#include <tuple>
 #include <unordered_set>
 #include <vector>
 
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <dirent.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define SQLITE_ABSTRACTIONS_HAVE_IO_URING
+#endif
+#endif
+
 using namespace DatabaseAbstractions;
 
 /**
@@ -46,6 +65,13 @@ struct SQLiteDatabaseTests
     std::string comparisonDbFilePath;
     std::string startingSerialization;
 
+    /**
+     * These are the file descriptors opened by IsFileLocked.  They're
+     * kept open until the test is over, because closing one would
+     * release the locks the process holds on the file.
+     */
+    std::vector< int > lockProbeDescriptors;
+
     // Methods
 
     /**
@@ -185,6 +211,82 @@ struct SQLiteDatabaseTests
         VerifySerialization(startingSerialization);
     }
 
+    /**
+     * Return an indication of whether or not io_uring can be used
+     * on this system.
+     *
+     * @return
+     *     An indication of whether or not io_uring can be used
+     *     on this system is returned.
+     */
+    bool IsIoUringAvailable() {
+#ifdef SQLITE_ABSTRACTIONS_HAVE_IO_URING
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        const auto fd = (int)syscall(__NR_io_uring_setup, 1, &params);
+        if (fd < 0) {
+            return false;
+        }
+        (void)close(fd);
+        return true;
+#else /* not SQLITE_ABSTRACTIONS_HAVE_IO_URING */
+        return false;
+#endif /* SQLITE_ABSTRACTIONS_HAVE_IO_URING */
+    }
+
+    /**
+     * Return the number of file descriptors the process has open.
+     *
+     * @return
+     *     The number of file descriptors the process has open
+     *     is returned.
+     */
+    size_t CountOpenDescriptors() {
+        size_t count = 0;
+#ifdef SQLITE_ABSTRACTIONS_HAVE_IO_URING
+        const auto dir = opendir("/proc/self/fd");
+        if (dir == NULL) {
+            return 0;
+        }
+        while (readdir(dir) != NULL) {
+            ++count;
+        }
+        (void)closedir(dir);
+#endif /* SQLITE_ABSTRACTIONS_HAVE_IO_URING */
+        return count;
+    }
+
+    /**
+     * Determine whether or not any lock is held on the file
+     * at the given path, by this or any other process.
+     *
+     * @param[in] filePath
+     *     This is the path to the file to check.
+     *
+     * @return
+     *     An indication of whether or not any lock is held
+     *     on the file is returned.
+     */
+    bool IsFileLocked(const std::string& filePath) {
+#if defined(SQLITE_ABSTRACTIONS_HAVE_IO_URING) && defined(F_OFD_GETLK)
+        const auto fd = open(filePath.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        lockProbeDescriptors.push_back(fd);
+        struct flock lockInfo;
+        memset(&lockInfo, 0, sizeof(lockInfo));
+        lockInfo.l_type = F_WRLCK;
+        lockInfo.l_whence = SEEK_SET;
+        return (
+            (fcntl(fd, F_OFD_GETLK, &lockInfo) == 0)
+            && (lockInfo.l_type != F_UNLCK)
+        );
+#else /* not SQLITE_ABSTRACTIONS_HAVE_IO_URING or not F_OFD_GETLK */
+        return false;
+#endif /* SQLITE_ABSTRACTIONS_HAVE_IO_URING and F_OFD_GETLK */
+    }
+
     // ::testing::Test
 
     virtual void SetUp() override {
@@ -201,6 +303,11 @@ struct SQLiteDatabaseTests
     }
 
     virtual void TearDown() override {
+#ifdef SQLITE_ABSTRACTIONS_HAVE_IO_URING
+        for (const auto fd: lockProbeDescriptors) {
+            (void)close(fd);
+        }
+#endif /* SQLITE_ABSTRACTIONS_HAVE_IO_URING */
     }
 
 };
@@ -604,3 +711,1456 @@ TEST_F(SQLiteDatabaseTests, InstallSnapshot) {
     // Assert
     VerifySerialization(comparisonDb);
 }
+
+TEST_F(SQLiteDatabaseTests, Changeset_Record_And_Apply) {
+#if !defined(SQLITE_ENABLE_SESSION) || !defined(SQLITE_ENABLE_PREUPDATE_HOOK)
+    GTEST_SKIP() << "SQLite session extension not available";
+#endif /* not SQLITE_ENABLE_SESSION || not SQLITE_ENABLE_PREUPDATE_HOOK */
+
+    // Arrange
+    DatabaseConnection comparisonDb;
+    ReconstructDatabase(
+        comparisonDbFilePath,
+        defaultDbInitStatements,
+        comparisonDb
+    );
+    comparisonDb = nullptr;
+    SQLiteDatabase follower;
+    ASSERT_TRUE(follower.Open(comparisonDbFilePath));
+    ASSERT_TRUE(db.BeginChangeset());
+    (void)db.ExecuteStatement("INSERT INTO kv VALUES ('hello', 'world')");
+    (void)db.ExecuteStatement("UPDATE npcs SET job = 'Baker' WHERE entity = 2");
+    (void)db.ExecuteStatement("DELETE FROM kv WHERE key = 'spam'");
+    const auto changeset = db.EndChangeset();
+
+    // Act
+    const auto error = follower.ApplyChangeset(changeset);
+
+    // Assert
+    EXPECT_FALSE(changeset.empty());
+    EXPECT_TRUE(error.empty());
+    auto statement = follower.BuildStatement(
+        "SELECT value FROM kv WHERE key = 'hello'"
+    ).statement;
+    EXPECT_FALSE(statement->Step().done);
+    EXPECT_EQ("world", (const std::string&)statement->FetchColumn(0, Value::Type::Text));
+    statement = follower.BuildStatement(
+        "SELECT job FROM npcs WHERE entity = 2"
+    ).statement;
+    EXPECT_FALSE(statement->Step().done);
+    EXPECT_EQ("Baker", (const std::string&)statement->FetchColumn(0, Value::Type::Text));
+    statement = follower.BuildStatement(
+        "SELECT COUNT(*) FROM kv WHERE key = 'spam'"
+    ).statement;
+    EXPECT_FALSE(statement->Step().done);
+    EXPECT_EQ(0, (int)statement->FetchColumn(0, Value::Type::Integer));
+}
+
+TEST_F(SQLiteDatabaseTests, Changeset_Apply_Reports_Conflicts) {
+#if !defined(SQLITE_ENABLE_SESSION) || !defined(SQLITE_ENABLE_PREUPDATE_HOOK)
+    GTEST_SKIP() << "SQLite session extension not available";
+#endif /* not SQLITE_ENABLE_SESSION || not SQLITE_ENABLE_PREUPDATE_HOOK */
+
+    // Arrange
+    DatabaseConnection comparisonDb;
+    ReconstructDatabase(
+        comparisonDbFilePath,
+        defaultDbInitStatements,
+        comparisonDb,
+        {
+            "INSERT INTO kv VALUES ('hello', 'there')",
+        }
+    );
+    comparisonDb = nullptr;
+    SQLiteDatabase follower;
+    ASSERT_TRUE(follower.Open(comparisonDbFilePath));
+    ASSERT_TRUE(db.BeginChangeset());
+    (void)db.ExecuteStatement("INSERT INTO kv VALUES ('hello', 'world')");
+    const auto changeset = db.EndChangeset();
+    std::vector< SQLiteDatabase::ChangesetConflict > conflicts;
+
+    // Act
+    const auto error = follower.ApplyChangeset(
+        changeset,
+        [&](const SQLiteDatabase::ChangesetConflict& conflict){
+            conflicts.push_back(conflict);
+            return SQLiteDatabase::ChangesetConflictResolution::Omit;
+        }
+    );
+
+    // Assert
+    EXPECT_TRUE(error.empty());
+    ASSERT_EQ(1, conflicts.size());
+    EXPECT_EQ(SQLiteDatabase::ChangesetConflict::Type::Conflict, conflicts[0].type);
+    EXPECT_EQ(SQLiteDatabase::ChangesetConflict::Operation::Insert, conflicts[0].operation);
+    EXPECT_EQ("kv", conflicts[0].table);
+    auto statement = follower.BuildStatement(
+        "SELECT value FROM kv WHERE key = 'hello'"
+    ).statement;
+    EXPECT_FALSE(statement->Step().done);
+    EXPECT_EQ("there", (const std::string&)statement->FetchColumn(0, Value::Type::Text));
+}
+
+TEST_F(SQLiteDatabaseTests, Changeset_Invert_And_Concatenate) {
+#if !defined(SQLITE_ENABLE_SESSION) || !defined(SQLITE_ENABLE_PREUPDATE_HOOK)
+    GTEST_SKIP() << "SQLite session extension not available";
+#endif /* not SQLITE_ENABLE_SESSION || not SQLITE_ENABLE_PREUPDATE_HOOK */
+
+    // Arrange
+    ASSERT_TRUE(db.BeginChangeset());
+    (void)db.ExecuteStatement("INSERT INTO kv VALUES ('hello', 'world')");
+    const auto changeset1 = db.EndChangeset();
+    ASSERT_TRUE(db.BeginChangeset());
+    (void)db.ExecuteStatement("UPDATE npcs SET name = 'Bobby' WHERE entity = 2");
+    const auto changeset2 = db.EndChangeset();
+    const auto combined = SQLiteDatabase::ConcatenateChangesets({changeset1, changeset2});
+
+    // Act
+    const auto inverse = SQLiteDatabase::InvertChangeset(combined);
+    const auto error = db.ApplyChangeset(inverse);
+
+    // Assert
+    EXPECT_FALSE(combined.empty());
+    EXPECT_FALSE(inverse.empty());
+    EXPECT_TRUE(error.empty());
+    auto statement = db.BuildStatement(
+        "SELECT COUNT(*) FROM kv WHERE key = 'hello'"
+    ).statement;
+    EXPECT_FALSE(statement->Step().done);
+    EXPECT_EQ(0, (int)statement->FetchColumn(0, Value::Type::Integer));
+    statement = db.BuildStatement(
+        "SELECT name FROM npcs WHERE entity = 2"
+    ).statement;
+    EXPECT_FALSE(statement->Step().done);
+    EXPECT_EQ("Bob", (const std::string&)statement->FetchColumn(0, Value::Type::Text));
+}
+
+TEST_F(SQLiteDatabaseTests, QueryCache_Repeated_Query_Hits_Cache) {
+    // Arrange
+    db.EnableQueryCache(1024 * 1024);
+    auto statement = db.BuildStatement(
+        "SELECT quest FROM quests WHERE npc = ? ORDER BY quest"
+    ).statement;
+    statement->BindParameter(0, 1);
+    (void)statement->Step();
+    (void)statement->Step();
+    (void)statement->Step();
+    statement->Reset();
+
+    // Act
+    statement->BindParameter(0, 1);
+    const auto step1 = statement->Step();
+    const auto quest1 = statement->FetchColumn(0, Value::Type::Integer);
+    const auto step2 = statement->Step();
+    const auto quest2 = statement->FetchColumn(0, Value::Type::Integer);
+    const auto step3 = statement->Step();
+
+    // Assert
+    EXPECT_FALSE(step1.done);
+    EXPECT_EQ(42, (int)quest1);
+    EXPECT_FALSE(step2.done);
+    EXPECT_EQ(43, (int)quest2);
+    EXPECT_TRUE(step3.done);
+    const auto statistics = db.GetQueryCacheStatistics();
+    EXPECT_EQ(1, statistics.hits);
+    EXPECT_EQ(1, statistics.misses);
+    EXPECT_EQ(1, statistics.entries);
+}
+
+TEST_F(SQLiteDatabaseTests, QueryCache_Keyed_By_Parameter_Values) {
+    // Arrange
+    db.EnableQueryCache(1024 * 1024);
+    auto statement = db.BuildStatement(
+        "SELECT name FROM npcs WHERE entity = ?"
+    ).statement;
+    statement->BindParameter(0, 1);
+    (void)statement->Step();
+    (void)statement->Step();
+    statement->Reset();
+
+    // Act
+    statement->BindParameter(0, 2);
+    (void)statement->Step();
+    const auto name = statement->FetchColumn(0, Value::Type::Text);
+
+    // Assert
+    EXPECT_EQ("Bob", (const std::string&)name);
+    const auto statistics = db.GetQueryCacheStatistics();
+    EXPECT_EQ(0, statistics.hits);
+    EXPECT_EQ(2, statistics.misses);
+}
+
+TEST_F(SQLiteDatabaseTests, QueryCache_Invalidated_By_Table_Changes) {
+    // Arrange
+    db.EnableQueryCache(1024 * 1024);
+    auto npcQuery = db.BuildStatement(
+        "SELECT job FROM npcs WHERE entity = 2"
+    ).statement;
+    auto kvQuery = db.BuildStatement(
+        "SELECT value FROM kv WHERE key = 'foo'"
+    ).statement;
+    for (auto statement: {npcQuery, kvQuery}) {
+        (void)statement->Step();
+        (void)statement->Step();
+        statement->Reset();
+    }
+
+    // Act
+    auto update = db.BuildStatement(
+        "UPDATE npcs SET job = ? WHERE entity = 2"
+    ).statement;
+    update->BindParameter(0, "Baker");
+    (void)update->Step();
+    (void)npcQuery->Step();
+    const auto job = npcQuery->FetchColumn(0, Value::Type::Text);
+    (void)kvQuery->Step();
+    const auto value = kvQuery->FetchColumn(0, Value::Type::Text);
+
+    // Assert
+    EXPECT_EQ("Baker", (const std::string&)job);
+    EXPECT_EQ("bar", (const std::string&)value);
+    const auto statistics = db.GetQueryCacheStatistics();
+    EXPECT_EQ(1, statistics.hits);
+    EXPECT_EQ(3, statistics.misses);
+    EXPECT_EQ(1, statistics.invalidations);
+}
+
+TEST_F(SQLiteDatabaseTests, ReclaimFreePages_Incremental_Vacuum) {
+    // Arrange
+    SystemAbstractions::File(comparisonDbFilePath).Destroy();
+    SQLiteDatabase::OpenOptions options;
+    options.incrementalVacuum = true;
+    SQLiteDatabase compactedDb;
+    ASSERT_TRUE(compactedDb.Open(comparisonDbFilePath, options));
+    (void)compactedDb.ExecuteStatement("CREATE TABLE t (value TEXT)");
+    (void)compactedDb.ExecuteStatement(
+        "WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 100) "
+        "INSERT INTO t SELECT printf('%.2000c', 'x') FROM n"
+    );
+    (void)compactedDb.ExecuteStatement("DELETE FROM t");
+    const auto freeBytesBefore = compactedDb.GetCompactionStatistics().freeBytes;
+
+    // Act
+    const auto bytesReclaimed = compactedDb.ReclaimFreePages(16384);
+
+    // Assert
+    EXPECT_GT(freeBytesBefore, 16384);
+    EXPECT_EQ(16384, bytesReclaimed);
+    const auto statistics = compactedDb.GetCompactionStatistics();
+    EXPECT_EQ(freeBytesBefore - 16384, statistics.freeBytes);
+    EXPECT_EQ(16384, statistics.bytesReclaimed);
+}
+
+TEST_F(SQLiteDatabaseTests, CreateSnapshot_Compacted_In_Wal_Mode) {
+    // Arrange
+    ASSERT_TRUE(db.ExecuteStatement("PRAGMA journal_mode = WAL").empty());
+    (void)db.ExecuteStatement(
+        "WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 100) "
+        "INSERT INTO kv SELECT i, printf('%.2000c', 'x') FROM n"
+    );
+    (void)db.ExecuteStatement("DELETE FROM kv WHERE value LIKE 'x%'");
+    db.SetCompactSnapshots(true);
+
+    // Act
+    const auto compactedSnapshot = db.CreateSnapshot();
+
+    // Assert
+    ASSERT_GE(compactedSnapshot.size(), 100);
+    EXPECT_EQ(2, compactedSnapshot[18]);
+    EXPECT_EQ(2, compactedSnapshot[19]);
+    EXPECT_GT(db.GetCompactionStatistics().snapshotBytesOmitted, 0);
+    SQLiteDatabase follower;
+    ASSERT_TRUE(follower.Open(comparisonDbFilePath));
+    EXPECT_TRUE(follower.InstallSnapshot(compactedSnapshot).empty());
+    auto statement = follower.BuildStatement(
+        "SELECT COUNT(*) FROM kv"
+    ).statement;
+    EXPECT_FALSE(statement->Step().done);
+    EXPECT_EQ(2, (int)statement->FetchColumn(0, Value::Type::Integer));
+}
+
+TEST_F(SQLiteDatabaseTests, CreateSnapshot_Compacted) {
+    // Arrange
+    (void)db.ExecuteStatement(
+        "WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 100) "
+        "INSERT INTO kv SELECT i, printf('%.2000c', 'x') FROM n"
+    );
+    (void)db.ExecuteStatement("DELETE FROM kv WHERE value LIKE 'x%'");
+    const auto uncompactedSnapshot = db.CreateSnapshot();
+    db.SetCompactSnapshots(true);
+
+    // Act
+    const auto compactedSnapshot = db.CreateSnapshot();
+
+    // Assert
+    EXPECT_LT(compactedSnapshot.size(), uncompactedSnapshot.size());
+    EXPECT_EQ(
+        uncompactedSnapshot.size() - compactedSnapshot.size(),
+        db.GetCompactionStatistics().snapshotBytesOmitted
+    );
+    SQLiteDatabase follower;
+    ASSERT_TRUE(follower.Open(comparisonDbFilePath));
+    EXPECT_TRUE(follower.InstallSnapshot(compactedSnapshot).empty());
+    auto statement = follower.BuildStatement(
+        "SELECT value FROM kv WHERE key = 'foo'"
+    ).statement;
+    EXPECT_FALSE(statement->Step().done);
+    EXPECT_EQ("bar", (const std::string&)statement->FetchColumn(0, Value::Type::Text));
+}
+
+TEST_F(SQLiteDatabaseTests, CheckpointScheduler_Checkpoints_In_Background) {
+    // Arrange
+    SQLiteDatabase::CheckpointOptions options;
+    options.mode = SQLiteDatabase::CheckpointMode::Truncate;
+    options.frameThreshold = 1;
+    ASSERT_TRUE(db.StartCheckpointScheduler(options));
+
+    // Act
+    for (int i = 0; i < 10; ++i) {
+        auto statement = db.BuildStatement(
+            "INSERT INTO quests (npc, quest) VALUES (3, ?)"
+        ).statement;
+        statement->BindParameter(0, i);
+        ASSERT_TRUE(statement->Step().error.empty());
+    }
+    SQLiteDatabase::CheckpointStatistics statistics;
+    for (int i = 0; i < 100; ++i) {
+        statistics = db.GetCheckpointStatistics();
+        if (statistics.checkpoints > 0) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    db.StopCheckpointScheduler();
+
+    // Assert
+    EXPECT_GT(statistics.checkpoints, 0);
+    EXPECT_GT(statistics.framesCheckpointed, 0);
+    auto statement = db.BuildStatement(
+        "SELECT COUNT(*) FROM quests WHERE npc = 3"
+    ).statement;
+    EXPECT_FALSE(statement->Step().done);
+    EXPECT_EQ(10, (int)statement->FetchColumn(0, Value::Type::Integer));
+}
+
+TEST_F(SQLiteDatabaseTests, CheckpointScheduler_Back_Pressure) {
+    // Arrange
+    SQLiteDatabase::CheckpointOptions options;
+    options.interval = std::chrono::milliseconds(60000);
+    options.frameThreshold = 1000000;
+    options.walSizeLimit = 1;
+    ASSERT_TRUE(db.StartCheckpointScheduler(options));
+
+    // Act
+    const auto error = db.ExecuteStatement(
+        "INSERT INTO quests (npc, quest) VALUES (3, 1)"
+    );
+    const auto statistics = db.GetCheckpointStatistics();
+    db.StopCheckpointScheduler();
+
+    // Assert
+    EXPECT_TRUE(error.empty());
+    EXPECT_EQ(1, statistics.backPressureWaits);
+    EXPECT_EQ(1, statistics.checkpoints);
+}
+
+TEST_F(SQLiteDatabaseTests, UringVfs_Read_Write_And_Snapshot) {
+    // Arrange
+    SQLiteDatabase::OpenOptions options;
+    options.useIoUring = true;
+    SQLiteDatabase uringDb;
+    ASSERT_TRUE(uringDb.Open(defaultDbFilePath, options));
+    ASSERT_EQ(IsIoUringAvailable(), uringDb.IsUsingIoUring());
+    DatabaseConnection comparisonDb;
+    ReconstructDatabase(
+        comparisonDbFilePath,
+        defaultDbInitStatements,
+        comparisonDb,
+        {
+            "INSERT INTO quests (npc, quest) VALUES (1, 99)",
+            "INSERT INTO quests (npc, quest) VALUES (2, 76)",
+        }
+    );
+
+    // Act
+    EXPECT_TRUE(uringDb.ExecuteStatement("INSERT INTO quests (npc, quest) VALUES (1, 99)").empty());
+    EXPECT_TRUE(uringDb.ExecuteStatement("INSERT INTO quests (npc, quest) VALUES (2, 76)").empty());
+    const auto snapshot = uringDb.CreateSnapshot();
+
+    // Assert
+    VerifySerialization(comparisonDb);
+    const auto expectedSnapshot = SerializeDatabase(comparisonDb);
+    EXPECT_TRUE(Blob(expectedSnapshot.begin(), expectedSnapshot.end()) == snapshot);
+}
+
+TEST_F(SQLiteDatabaseTests, UringVfs_Commits_Seen_By_Other_Connections_In_Wal_Mode) {
+    // Arrange
+    SQLiteDatabase::OpenOptions options;
+    options.useIoUring = true;
+    SQLiteDatabase uringDb;
+    ASSERT_TRUE(uringDb.Open(defaultDbFilePath, options));
+    ASSERT_EQ(IsIoUringAvailable(), uringDb.IsUsingIoUring());
+    ASSERT_TRUE(uringDb.ExecuteStatement("PRAGMA journal_mode = WAL").empty());
+    ASSERT_TRUE(uringDb.ExecuteStatement("PRAGMA synchronous = NORMAL").empty());
+    DatabaseConnection otherDb;
+    OpenDatabase(defaultDbFilePath, otherDb);
+
+    // Act
+    std::vector< int > counts;
+    for (int i = 0; i < 3; ++i) {
+        EXPECT_TRUE(uringDb.ExecuteStatement("INSERT INTO quests (npc, quest) VALUES (3, 1)").empty());
+        sqlite3_stmt* statementRaw;
+        ASSERT_EQ(
+            SQLITE_OK,
+            sqlite3_prepare_v2(
+                otherDb.get(),
+                "SELECT COUNT(*) FROM quests WHERE npc = 3",
+                -1,
+                &statementRaw,
+                NULL
+            )
+        );
+        EXPECT_EQ(SQLITE_ROW, sqlite3_step(statementRaw));
+        counts.push_back(sqlite3_column_int(statementRaw, 0));
+        (void)sqlite3_finalize(statementRaw);
+    }
+
+    // Assert
+    EXPECT_EQ(std::vector< int >({1, 2, 3}), counts);
+}
+
+TEST_F(SQLiteDatabaseTests, UringVfs_Large_Scan_In_Wal_Mode) {
+    // Arrange
+    SQLiteDatabase::OpenOptions options;
+    options.useIoUring = true;
+    SQLiteDatabase uringDb;
+    ASSERT_TRUE(uringDb.Open(defaultDbFilePath, options));
+    ASSERT_EQ(IsIoUringAvailable(), uringDb.IsUsingIoUring());
+    SQLiteDatabase::CheckpointOptions checkpointOptions;
+    checkpointOptions.frameThreshold = 10;
+    ASSERT_TRUE(uringDb.StartCheckpointScheduler(checkpointOptions));
+    (void)uringDb.ExecuteStatement(
+        "WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 5000) "
+        "INSERT INTO kv SELECT i, printf('%.500c', 'x') FROM n"
+    );
+    uringDb.StopCheckpointScheduler();
+    (void)uringDb.ExecuteStatement("PRAGMA wal_checkpoint(TRUNCATE)");
+
+    // Act
+    auto statement = uringDb.BuildStatement(
+        "SELECT COUNT(*), SUM(LENGTH(value)) FROM kv"
+    ).statement;
+    const auto step = statement->Step();
+
+    // Assert
+    EXPECT_FALSE(step.done);
+    EXPECT_EQ(5002, (int)statement->FetchColumn(0, Value::Type::Integer));
+    EXPECT_EQ(5000 * 500 + 3, (int)statement->FetchColumn(1, Value::Type::Integer));
+}
+
+TEST_F(SQLiteDatabaseTests, UringVfs_Closes_Descriptors_Of_Closed_Files) {
+    // Arrange
+    SQLiteDatabase::OpenOptions options;
+    options.useIoUring = true;
+    {
+        SQLiteDatabase uringDb;
+        ASSERT_TRUE(uringDb.Open(defaultDbFilePath, options));
+    }
+    const auto descriptorsBefore = CountOpenDescriptors();
+
+    // Act
+    for (int i = 0; i < 20; ++i) {
+        const auto filePath = (
+            SystemAbstractions::File::GetExeParentDirectory()
+            + "/temp" + std::to_string(i) + ".db"
+        );
+        {
+            SQLiteDatabase uringDb;
+            ASSERT_TRUE(uringDb.Open(filePath, options));
+            ASSERT_TRUE(uringDb.ExecuteStatement("CREATE TABLE t (a INT); INSERT INTO t VALUES (1)").empty());
+        }
+        SystemAbstractions::File(filePath).Destroy();
+    }
+
+    // Assert
+    EXPECT_EQ(descriptorsBefore, CountOpenDescriptors());
+}
+
+TEST_F(SQLiteDatabaseTests, UringVfs_Close_Keeps_Locks_Of_Other_Connections) {
+    // Arrange
+    SQLiteDatabase::OpenOptions options;
+    options.useIoUring = true;
+    const auto descriptorsBefore = CountOpenDescriptors();
+    SQLiteDatabase plainDb;
+    ASSERT_TRUE(plainDb.Open(defaultDbFilePath));
+    const auto plainDescriptors = CountOpenDescriptors() - descriptorsBefore;
+    ASSERT_TRUE(plainDb.ExecuteStatement("BEGIN IMMEDIATE").empty());
+    ASSERT_TRUE(IsFileLocked(defaultDbFilePath));
+
+    // Act
+    {
+        SQLiteDatabase uringDb;
+        ASSERT_TRUE(uringDb.Open(defaultDbFilePath, options));
+        auto statement = uringDb.BuildStatement("SELECT COUNT(*) FROM npcs").statement;
+        ASSERT_FALSE(statement->Step().done);
+    }
+    const auto lockedAfterUringClose = IsFileLocked(defaultDbFilePath);
+    const auto probeDescriptors = lockProbeDescriptors.size();
+    ASSERT_TRUE(plainDb.ExecuteStatement("COMMIT").empty());
+    {
+        SQLiteDatabase uringDb;
+        ASSERT_TRUE(uringDb.Open(defaultDbFilePath, options));
+    }
+
+    // Assert
+    EXPECT_TRUE(lockedAfterUringClose);
+    EXPECT_EQ(descriptorsBefore + plainDescriptors + probeDescriptors, CountOpenDescriptors());
+}
+
+TEST_F(SQLiteDatabaseTests, WarmUp_After_Open) {
+    // Arrange
+    SQLiteDatabase::WarmUpOptions options;
+    options.byteBudget = 1024 * 1024;
+    SQLiteDatabase warmDb;
+    warmDb.EnableWarmUp(options);
+
+    // Act
+    ASSERT_TRUE(warmDb.Open(defaultDbFilePath));
+    warmDb.WaitForWarmUp();
+
+    // Assert
+    const auto statistics = warmDb.GetWarmUpStatistics();
+    EXPECT_TRUE(statistics.finished);
+    EXPECT_EQ(5, statistics.objectsWarmed); // 3 tables, 2 of which have indexes
+    EXPECT_GT(statistics.bytesWarmed, 0);
+    EXPECT_LE(statistics.bytesWarmed, options.byteBudget);
+}
+
+TEST_F(SQLiteDatabaseTests, WarmUp_Stops_At_Byte_Budget) {
+    // Arrange
+    ASSERT_EQ(
+        "",
+        db.ExecuteStatement(
+            "CREATE TABLE big (data BLOB);"
+            "WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 4096)"
+            " INSERT INTO big SELECT randomblob(1000) FROM n"
+        )
+    );
+    SQLiteDatabase::WarmUpOptions options;
+    options.byteBudget = 256 * 1024;
+    SQLiteDatabase warmDb;
+    warmDb.EnableWarmUp(options);
+    warmDb.SetHotTables({"big"});
+
+    // Act
+    ASSERT_TRUE(warmDb.Open(defaultDbFilePath));
+    warmDb.WaitForWarmUp();
+
+    // Assert
+    const auto statistics = warmDb.GetWarmUpStatistics();
+    EXPECT_TRUE(statistics.finished);
+    EXPECT_EQ(1, statistics.objectsWarmed);
+    EXPECT_GE(statistics.bytesWarmed, options.byteBudget);
+    EXPECT_LT(statistics.bytesWarmed, options.byteBudget + 64 * 1024);
+}
+
+TEST_F(SQLiteDatabaseTests, WarmUp_Gives_Way_To_Writes) {
+    // Arrange
+    ASSERT_EQ(
+        "",
+        db.ExecuteStatement(
+            "CREATE TABLE big (data BLOB);"
+            "WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 32768)"
+            " INSERT INTO big SELECT randomblob(1000) FROM n"
+        )
+    );
+    SQLiteDatabase::WarmUpOptions options;
+    options.byteBudget = 64 * 1024 * 1024;
+    SQLiteDatabase warmDb;
+    warmDb.EnableWarmUp(options);
+    warmDb.SetHotTables({"big"});
+
+    // Act
+    ASSERT_TRUE(warmDb.Open(defaultDbFilePath));
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    std::vector< std::string > errors;
+    int writesDuringWarmUp = 0;
+    for (int i = 0; i < 1000; ++i) {
+        const auto warmUpFinished = warmDb.GetWarmUpStatistics().finished;
+        auto statement = warmDb.BuildStatement("INSERT INTO quests VALUES (3, ?, 0)").statement;
+        statement->BindParameter(0, i);
+        const auto error = statement->Step().error;
+        if (!error.empty()) {
+            errors.push_back(error);
+        }
+        if (warmUpFinished) {
+            break;
+        }
+        ++writesDuringWarmUp;
+    }
+    warmDb.WaitForWarmUp();
+
+    // Assert
+    EXPECT_EQ(std::vector< std::string >(), errors);
+    EXPECT_GT(writesDuringWarmUp, 0);
+    EXPECT_TRUE(warmDb.GetWarmUpStatistics().finished);
+}
+
+TEST_F(SQLiteDatabaseTests, WarmUp_Hot_Tables_After_Install_Snapshot) {
+    // Arrange
+    SQLiteDatabase::WarmUpOptions options;
+    options.byteBudget = 1024 * 1024;
+    SQLiteDatabase warmDb;
+    warmDb.EnableWarmUp(options);
+    ASSERT_TRUE(warmDb.Open(defaultDbFilePath));
+    warmDb.WaitForWarmUp();
+    (void)warmDb.BuildStatement("SELECT name FROM npcs").statement->Step();
+    (void)warmDb.BuildStatement("SELECT job FROM npcs WHERE entity = 1").statement->Step();
+    (void)warmDb.BuildStatement("SELECT quest FROM quests").statement->Step();
+    for (int i = 0; i < 3; ++i) {
+        (void)warmDb.BuildStatement("SELECT value FROM kv");
+    }
+    const auto snapshot = warmDb.CreateSnapshot();
+
+    // Act
+    const auto hotTables = warmDb.GetHotTables();
+    warmDb.InstallSnapshot(snapshot);
+    warmDb.WaitForWarmUp();
+
+    // Assert
+    EXPECT_EQ(
+        std::vector< std::string >({"npcs", "quests"}),
+        hotTables
+    );
+    EXPECT_EQ(hotTables, warmDb.GetHotTables());
+    const auto statistics = warmDb.GetWarmUpStatistics();
+    EXPECT_TRUE(statistics.finished);
+    EXPECT_EQ(3, statistics.objectsWarmed); // npcs, its index, and quests
+}
+
+TEST_F(SQLiteDatabaseTests, Scalar_Function_With_Values_And_Blobs) {
+    // Arrange
+    EXPECT_TRUE(
+        db.CreateScalarFunction(
+            "greet",
+            2,
+            [](
+                const SQLiteDatabase::FunctionArguments& arguments,
+                SQLiteDatabase::FunctionResult& result
+            ){
+                const std::string name = arguments.Get(0, Value::Type::Text);
+                const std::string job = arguments.Get(1, Value::Type::Text);
+                if (arguments.IsNull(1)) {
+                    result.Set(Value(nullptr));
+                } else {
+                    result.Set(name + " the " + job);
+                }
+            }
+        ).empty()
+    );
+    EXPECT_TRUE(
+        db.CreateScalarFunction(
+            "reverse_blob",
+            1,
+            [](
+                const SQLiteDatabase::FunctionArguments& arguments,
+                SQLiteDatabase::FunctionResult& result
+            ){
+                const auto size = arguments.GetBlobSize(0);
+                const auto input = arguments.GetBlob(0);
+                const auto output = result.AllocateBlob(size);
+                if (output != nullptr) {
+                    for (size_t i = 0; i < size; ++i) {
+                        output[i] = input[size - i - 1];
+                    }
+                }
+            }
+        ).empty()
+    );
+    EXPECT_TRUE(
+        db.CreateScalarFunction(
+            "fail",
+            0,
+            [](
+                const SQLiteDatabase::FunctionArguments& arguments,
+                SQLiteDatabase::FunctionResult& result
+            ){
+                (void)arguments;
+                (void)result;
+                throw std::runtime_error("nope");
+            }
+        ).empty()
+    );
+
+    // Act
+    auto greeting = db.BuildStatement(
+        "SELECT greet(name, job) FROM npcs ORDER BY entity"
+    ).statement;
+    auto reversed = db.BuildStatement(
+        "SELECT hex(reverse_blob(X'0102AB'))"
+    ).statement;
+    const auto failure = db.ExecuteStatement("SELECT fail()");
+
+    // Assert
+    ASSERT_FALSE(greeting->Step().done);
+    EXPECT_EQ(Value("Alex the Armorer"), greeting->FetchColumn(0, Value::Type::Text));
+    ASSERT_FALSE(greeting->Step().done);
+    EXPECT_EQ(Value("Bob the Banker"), greeting->FetchColumn(0, Value::Type::Text));
+    ASSERT_FALSE(reversed->Step().done);
+    EXPECT_EQ(Value("AB0201"), reversed->FetchColumn(0, Value::Type::Text));
+    EXPECT_EQ("nope", failure);
+}
+
+TEST_F(SQLiteDatabaseTests, Aggregate_And_Window_Functions) {
+    // Arrange
+    struct Product
+        : public SQLiteDatabase::Aggregate
+    {
+        intmax_t product = 1;
+        virtual void Step(const SQLiteDatabase::FunctionArguments& arguments) override {
+            product *= (intmax_t)arguments.Get(0, Value::Type::Integer);
+        }
+        virtual void GetResult(SQLiteDatabase::FunctionResult& result) override {
+            result.Set(product);
+        }
+    };
+    struct Total
+        : public SQLiteDatabase::Aggregate
+    {
+        intmax_t total = 0;
+        virtual void Step(const SQLiteDatabase::FunctionArguments& arguments) override {
+            total += (intmax_t)arguments.Get(0, Value::Type::Integer);
+        }
+        virtual void Inverse(const SQLiteDatabase::FunctionArguments& arguments) override {
+            total -= (intmax_t)arguments.Get(0, Value::Type::Integer);
+        }
+        virtual void GetResult(SQLiteDatabase::FunctionResult& result) override {
+            result.Set(total);
+        }
+    };
+    EXPECT_TRUE(
+        db.CreateAggregateFunction(
+            "product",
+            1,
+            []{ return std::unique_ptr< SQLiteDatabase::Aggregate >(new Product()); }
+        ).empty()
+    );
+    EXPECT_TRUE(
+        db.CreateWindowFunction(
+            "total",
+            1,
+            []{ return std::unique_ptr< SQLiteDatabase::Aggregate >(new Total()); }
+        ).empty()
+    );
+    (void)db.InstallSnapshot(db.CreateSnapshot());
+
+    // Act
+    auto products = db.BuildStatement(
+        "SELECT npc, product(quest) FROM quests GROUP BY npc ORDER BY npc"
+    ).statement;
+    auto emptyProduct = db.BuildStatement(
+        "SELECT product(quest) FROM quests WHERE npc = 3"
+    ).statement;
+    auto movingTotals = db.BuildStatement(
+        "SELECT total(quest) OVER (ORDER BY rowid ROWS BETWEEN 1 PRECEDING AND CURRENT ROW) FROM quests"
+    ).statement;
+
+    // Assert
+    ASSERT_FALSE(products->Step().done);
+    EXPECT_EQ(1, (int)products->FetchColumn(0, Value::Type::Integer));
+    EXPECT_EQ(42 * 43, (int)products->FetchColumn(1, Value::Type::Integer));
+    ASSERT_FALSE(products->Step().done);
+    EXPECT_EQ(2, (int)products->FetchColumn(0, Value::Type::Integer));
+    EXPECT_EQ(43, (int)products->FetchColumn(1, Value::Type::Integer));
+    EXPECT_TRUE(products->Step().done);
+    ASSERT_FALSE(emptyProduct->Step().done);
+    EXPECT_EQ(1, (int)emptyProduct->FetchColumn(0, Value::Type::Integer));
+    std::vector< int > totals;
+    while (!movingTotals->Step().done) {
+        totals.push_back((int)movingTotals->FetchColumn(0, Value::Type::Integer));
+    }
+    EXPECT_EQ(std::vector< int >({42, 85, 86}), totals);
+}
+
+TEST_F(SQLiteDatabaseTests, Vector_Functions) {
+    // Arrange
+    (void)db.ExecuteStatement("CREATE TABLE items (id INT, embedding BLOB)");
+    (void)db.ExecuteStatement("INSERT INTO items VALUES (1, float32_blob('[1, 0, 0, 0, 0, 0, 0, 0, 1]'))");
+    (void)db.ExecuteStatement("INSERT INTO items VALUES (2, float32_blob('[1, 2, 3, 4, 5, 6, 7, 8, 9]'))");
+    (void)db.ExecuteStatement("INSERT INTO items VALUES (3, float32_blob('[0.5, 0, 0, 0, 0, 0, 0, 0, 0]'))");
+
+    // Act
+    auto nearest = db.BuildStatement(
+        "SELECT id, dot_product(embedding, float32_blob(?1)), l2_distance(embedding, float32_blob(?1))"
+        " FROM items ORDER BY l2_distance(embedding, float32_blob(?1))"
+    ).statement;
+    nearest->BindParameter(0, "[1, 1, 1, 1, 1, 1, 1, 1, 1]");
+    const auto mismatch = db.ExecuteStatement(
+        "SELECT dot_product(float32_blob('[1, 2]'), float32_blob('[1, 2, 3]'))"
+    );
+
+    // Assert
+    ASSERT_FALSE(nearest->Step().done);
+    EXPECT_EQ(1, (int)nearest->FetchColumn(0, Value::Type::Integer));
+    EXPECT_NEAR(2.0, (double)nearest->FetchColumn(1, Value::Type::Real), 1e-6);
+    EXPECT_NEAR(sqrt(7.0), (double)nearest->FetchColumn(2, Value::Type::Real), 1e-6);
+    ASSERT_FALSE(nearest->Step().done);
+    EXPECT_EQ(3, (int)nearest->FetchColumn(0, Value::Type::Integer));
+    EXPECT_NEAR(0.5, (double)nearest->FetchColumn(1, Value::Type::Real), 1e-6);
+    EXPECT_NEAR(sqrt(8.25), (double)nearest->FetchColumn(2, Value::Type::Real), 1e-6);
+    ASSERT_FALSE(nearest->Step().done);
+    EXPECT_EQ(2, (int)nearest->FetchColumn(0, Value::Type::Integer));
+    EXPECT_NEAR(45.0, (double)nearest->FetchColumn(1, Value::Type::Real), 1e-5);
+    EXPECT_NEAR(sqrt(204.0), (double)nearest->FetchColumn(2, Value::Type::Real), 1e-5);
+    EXPECT_TRUE(nearest->Step().done);
+    EXPECT_FALSE(mismatch.empty());
+}
+
+TEST_F(SQLiteDatabaseTests, VirtualTable_Join_Container_With_Key_Lookup) {
+    // Arrange
+    using Sessions = std::map< int, std::string >;
+    Sessions sessions{
+        {1, "alpha"},
+        {2, "beta"},
+    };
+    size_t lookups = 0;
+    std::vector< ContainerTable< Sessions >::Column > columns{
+        {
+            "entity",
+            Value::Type::Integer,
+            [](
+                const Sessions::value_type& row,
+                SQLiteDatabase::FunctionResult& result
+            ){
+                result.Set(row.first);
+            },
+            [&lookups](
+                const Sessions& container,
+                const Value& value
+            ){
+                ++lookups;
+                return container.equal_range((int)value);
+            }
+        },
+        {
+            "session",
+            Value::Type::Text,
+            [](
+                const Sessions::value_type& row,
+                SQLiteDatabase::FunctionResult& result
+            ){
+                result.Set(row.second);
+            },
+            nullptr
+        },
+    };
+    EXPECT_TRUE(
+        db.CreateVirtualTable(
+            "sessions",
+            std::make_shared< ContainerTable< Sessions > >(sessions, columns)
+        ).empty()
+    );
+
+    // Act
+    auto join = db.BuildStatement(
+        "SELECT npcs.name, sessions.session FROM npcs"
+        " CROSS JOIN sessions ON sessions.entity = npcs.entity"
+        " ORDER BY npcs.entity"
+    ).statement;
+    std::vector< std::string > rows;
+    while (!join->Step().done) {
+        const std::string name = join->FetchColumn(0, Value::Type::Text);
+        const std::string session = join->FetchColumn(1, Value::Type::Text);
+        rows.push_back(name + ":" + session);
+    }
+
+    // Assert
+    EXPECT_EQ(
+        std::vector< std::string >({"Alex:alpha", "Bob:beta"}),
+        rows
+    );
+    EXPECT_EQ(2, lookups);
+}
+
+TEST_F(SQLiteDatabaseTests, VirtualTable_Reads_Live_Data) {
+    // Arrange
+    std::vector< double > readings{1.5, 2.5};
+    db.EnableQueryCache(1024 * 1024);
+    EXPECT_TRUE(
+        db.CreateVirtualTable(
+            "readings",
+            std::make_shared< ContainerTable< std::vector< double > > >(
+                readings,
+                std::vector< ContainerTable< std::vector< double > >::Column >{
+                    {
+                        "reading",
+                        Value::Type::Real,
+                        [](
+                            const double& row,
+                            SQLiteDatabase::FunctionResult& result
+                        ){
+                            result.Set(row);
+                        },
+                        nullptr
+                    },
+                }
+            )
+        ).empty()
+    );
+    (void)db.InstallSnapshot(db.CreateSnapshot());
+    const auto sum = [this]{
+        auto statement = db.BuildStatement("SELECT SUM(reading) FROM readings").statement;
+        (void)statement->Step();
+        return (double)statement->FetchColumn(0, Value::Type::Real);
+    };
+    const auto firstSum = sum();
+
+    // Act
+    readings.push_back(4.0);
+    const auto secondSum = sum();
+
+    // Assert
+    EXPECT_EQ(4.0, firstSum);
+    EXPECT_EQ(8.0, secondSum);
+    EXPECT_EQ(0, db.GetQueryCacheStatistics().hits);
+}
+
+TEST_F(SQLiteDatabaseTests, Timeout_Interrupts_Runaway_Statement) {
+    // Arrange
+    const std::string runaway = (
+        "WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM c)"
+        " SELECT COUNT(*) FROM c"
+    );
+    db.SetTimeout(std::chrono::milliseconds(50));
+
+    // Act
+    const auto start = std::chrono::steady_clock::now();
+    const auto connectionTimeoutError = db.ExecuteStatement(runaway);
+    const auto callTimeoutError = db.ExecuteStatement(
+        runaway,
+        std::chrono::milliseconds(10)
+    );
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    db.SetTimeout(std::chrono::milliseconds(0));
+    const auto normalError = db.ExecuteStatement("INSERT INTO quests VALUES (3, 44, 0)");
+
+    // Assert
+    EXPECT_EQ(SQLiteDatabase::DEADLINE_EXCEEDED_ERROR, connectionTimeoutError);
+    EXPECT_EQ(SQLiteDatabase::DEADLINE_EXCEEDED_ERROR, callTimeoutError);
+    EXPECT_LT(elapsed, std::chrono::seconds(5));
+    EXPECT_TRUE(normalError.empty());
+}
+
+TEST_F(SQLiteDatabaseTests, Deadline_Interrupts_Step) {
+    // Arrange
+    auto statement = db.BuildStatement(
+        "WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM c WHERE x < ?)"
+        " SELECT COUNT(*) FROM c"
+    ).statement;
+    statement->BindParameter(0, (intmax_t)1000000000000);
+    db.SetDeadline(std::chrono::steady_clock::now() + std::chrono::milliseconds(50));
+
+    // Act
+    const auto interruptedStep = statement->Step();
+    db.ClearDeadline();
+    statement->Reset();
+    statement->BindParameter(0, 10);
+    const auto normalStep = statement->Step();
+
+    // Assert
+    EXPECT_TRUE(interruptedStep.done);
+    EXPECT_EQ(SQLiteDatabase::DEADLINE_EXCEEDED_ERROR, interruptedStep.error);
+    EXPECT_FALSE(normalStep.done);
+    EXPECT_TRUE(normalStep.error.empty());
+    EXPECT_EQ(10, (int)statement->FetchColumn(0, Value::Type::Integer));
+}
+
+TEST_F(SQLiteDatabaseTests, Cancel_From_Another_Thread) {
+    // Arrange
+    auto statement = db.BuildStatement(
+        "WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM c)"
+        " SELECT COUNT(*) FROM c"
+    ).statement;
+    std::thread canceler(
+        [this]{
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            db.Cancel();
+        }
+    );
+
+    // Act
+    const auto step = statement->Step();
+    canceler.join();
+
+    // Assert
+    EXPECT_TRUE(step.done);
+    EXPECT_EQ(SQLiteDatabase::CANCELED_ERROR, step.error);
+}
+
+TEST_F(SQLiteDatabaseTests, ReadView_Keeps_State_While_Writer_Commits) {
+    // Arrange
+    const auto countNpcs = [](const std::shared_ptr< SQLiteDatabase::ReadView >& view){
+        auto statement = view->BuildStatement("SELECT COUNT(*) FROM npcs").statement;
+        (void)statement->Step();
+        return (int)statement->FetchColumn(0, Value::Type::Integer);
+    };
+    const auto view = db.CreateReadView();
+    ASSERT_FALSE(view == nullptr);
+    const auto countBefore = countNpcs(view);
+
+    // Act
+    const auto insertError = db.ExecuteStatement("INSERT INTO npcs VALUES (3, 'Carol', 'Cook', 1.5)");
+    const auto countInView = countNpcs(view);
+    const auto newView = db.CreateReadView();
+    ASSERT_FALSE(newView == nullptr);
+    const auto countInNewView = countNpcs(newView);
+
+    // Assert
+    EXPECT_TRUE(insertError.empty());
+    EXPECT_EQ(2, countBefore);
+    EXPECT_EQ(2, countInView);
+    EXPECT_EQ(3, countInNewView);
+}
+
+TEST_F(SQLiteDatabaseTests, ReadView_Used_On_Another_Thread_With_Functions) {
+    // Arrange
+    EXPECT_TRUE(
+        db.CreateScalarFunction(
+            "shout",
+            1,
+            [](
+                const SQLiteDatabase::FunctionArguments& arguments,
+                SQLiteDatabase::FunctionResult& result
+            ){
+                result.Set((std::string)arguments.Get(0, Value::Type::Text) + "!");
+            }
+        ).empty()
+    );
+    auto view = db.CreateReadView();
+    ASSERT_FALSE(view == nullptr);
+    auto statement = view->BuildStatement("SELECT shout(name) FROM npcs ORDER BY entity").statement;
+    ASSERT_FALSE(statement == nullptr);
+    view = nullptr;
+    std::vector< std::string > names;
+
+    // Act
+    const auto updateError = db.ExecuteStatement("UPDATE npcs SET name = 'Zed'");
+    std::thread reader(
+        [&statement, &names]{
+            while (!statement->Step().done) {
+                names.push_back(statement->FetchColumn(0, Value::Type::Text));
+            }
+        }
+    );
+    reader.join();
+
+    // Assert
+    EXPECT_TRUE(updateError.empty());
+    EXPECT_EQ(
+        (std::vector< std::string >{"Alex!", "Bob!"}),
+        names
+    );
+}
+
+TEST_F(SQLiteDatabaseTests, Memory_Usage_Accounting) {
+    // Arrange
+    db.EnableQueryCache(1024 * 1024);
+    auto statement = db.BuildStatement("SELECT name FROM npcs ORDER BY entity").statement;
+    while (!statement->Step().done) {
+    }
+
+    // Act
+    const auto usage = db.GetMemoryUsage();
+    const auto snapshot = db.CreateSnapshot();
+    const auto usageAfterSnapshot = db.GetMemoryUsage();
+
+    // Assert
+    EXPECT_GT(usage.heapUsed, 0);
+    EXPECT_GE(usage.heapPeak, usage.heapUsed);
+    EXPECT_GT(usage.cacheUsed, 0);
+    EXPECT_GT(usage.statementsUsed, 0);
+    EXPECT_GT(usage.schemaUsed, 0);
+    EXPECT_GT(usage.queryCacheUsed, 0);
+    EXPECT_LE(usage.queryCacheUsed, usage.heapUsed);
+    EXPECT_EQ(0, usage.snapshotBytes);
+    EXPECT_EQ(SQLiteDatabase::MemoryPressure::None, usage.pressure);
+
+    // The snapshot was counted while it was being created, but
+    // now belongs to the application, so it's no longer counted.
+    EXPECT_EQ(0, usageAfterSnapshot.snapshotBytes);
+    EXPECT_GE(usageAfterSnapshot.snapshotPeak, snapshot.size());
+}
+
+TEST_F(SQLiteDatabaseTests, Memory_Pressure_Callbacks_And_Hard_Limit) {
+    // Arrange
+    std::vector< SQLiteDatabase::MemoryPressure > pressures;
+    const auto onPressure = [&pressures](
+        SQLiteDatabase::MemoryPressure pressure,
+        const SQLiteDatabase::MemoryUsage& usage
+    ){
+        pressures.push_back(pressure);
+        EXPECT_EQ(pressure, usage.pressure);
+    };
+    SQLiteDatabase::MemoryLimits limits;
+    limits.softHeapLimit = 1;
+    db.SetMemoryLimits(limits, onPressure);
+
+    // Act
+    const auto firstSoftError = db.ExecuteStatement("INSERT INTO quests VALUES (3, 44, 0)");
+    const auto secondSoftError = db.ExecuteStatement("INSERT INTO quests VALUES (3, 45, 0)");
+    limits.softHeapLimit = 0;
+    limits.hardHeapLimit = db.GetMemoryUsage().heapUsed / 100 * 101;
+    db.SetMemoryLimits(limits, onPressure);
+    const auto hardError = db.ExecuteStatement("SELECT randomblob(100000000)");
+    db.SetMemoryLimits(SQLiteDatabase::MemoryLimits());
+    const auto normalError = db.ExecuteStatement("SELECT randomblob(1000000)");
+
+    // Assert
+    EXPECT_TRUE(firstSoftError.empty());
+    EXPECT_TRUE(secondSoftError.empty());
+    EXPECT_FALSE(hardError.empty());
+    EXPECT_TRUE(normalError.empty());
+    EXPECT_EQ(
+        (std::vector< SQLiteDatabase::MemoryPressure >{
+            SQLiteDatabase::MemoryPressure::Soft,
+            SQLiteDatabase::MemoryPressure::Hard,
+        }),
+        pressures
+    );
+}
+
+TEST_F(SQLiteDatabaseTests, StepBatch_Fetches_Columns_Into_Arrays) {
+    // Arrange
+    auto statement = db.BuildStatement(
+        "SELECT entity, name, time, entity = 1 FROM npcs ORDER BY entity"
+    ).statement;
+    const std::vector< Value::Type > columnTypes{
+        Value::Type::Integer,
+        Value::Type::Text,
+        Value::Type::Real,
+        Value::Type::Boolean,
+    };
+    SQLiteDatabase::ColumnBatch batch;
+
+    // Act
+    const auto firstResults = SQLiteDatabase::StepBatch(*statement, columnTypes, 1, batch);
+    const auto firstRowCount = batch.rowCount;
+    const auto secondResults = SQLiteDatabase::StepBatch(*statement, columnTypes, 10, batch);
+
+    // Assert
+    EXPECT_FALSE(firstResults.done);
+    EXPECT_EQ(1, firstRowCount);
+    EXPECT_TRUE(secondResults.done);
+    EXPECT_TRUE(secondResults.error.empty());
+    ASSERT_EQ(1, batch.rowCount);
+    ASSERT_EQ(4, batch.columns.size());
+    EXPECT_EQ(std::vector< int64_t >{2}, batch.columns[0].integers);
+    EXPECT_EQ((std::vector< int32_t >{0, 3}), batch.columns[1].offsets);
+    EXPECT_EQ("Bob", std::string(batch.columns[1].bytes.begin(), batch.columns[1].bytes.end()));
+    EXPECT_EQ(1, batch.columns[2].nullCount);
+    EXPECT_EQ(std::vector< uint8_t >{0x00}, batch.columns[2].validity);
+    EXPECT_EQ(std::vector< double >{0.0}, batch.columns[2].reals);
+    EXPECT_EQ(std::vector< uint8_t >{0x01}, batch.columns[3].validity);
+    EXPECT_EQ(std::vector< uint8_t >{0x00}, batch.columns[3].booleans);
+}
+
+TEST_F(SQLiteDatabaseTests, StepBatch_Matches_Row_Fetch_With_Query_Cache) {
+    // Arrange
+    (void)db.ExecuteStatement(
+        "CREATE TABLE samples (value REAL);"
+        "WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM c WHERE x < 1000)"
+        " INSERT INTO samples SELECT CASE WHEN x % 10 = 0 THEN NULL ELSE x * 0.5 END FROM c"
+    );
+    db.EnableQueryCache(1024 * 1024);
+    auto statement = db.BuildStatement("SELECT value FROM samples").statement;
+    SQLiteDatabase::ColumnBatch batch;
+    const auto sumInBatches = [&statement, &batch]{
+        double sum = 0.0;
+        size_t rows = 0;
+        size_t nulls = 0;
+        statement->Reset();
+        for (;;) {
+            const auto results = SQLiteDatabase::StepBatch(*statement, {Value::Type::Real}, 256, batch);
+            for (const auto value: batch.columns[0].reals) {
+                sum += value;
+            }
+            rows += batch.rowCount;
+            nulls += batch.columns[0].nullCount;
+            if (results.done) {
+                break;
+            }
+        }
+        return std::make_tuple(sum, rows, nulls);
+    };
+
+    // Act
+    const auto uncached = sumInBatches();
+    const auto cached = sumInBatches();
+
+    // Assert
+    EXPECT_EQ(std::make_tuple(225000.0, (size_t)1000, (size_t)100), uncached);
+    EXPECT_EQ(uncached, cached);
+    EXPECT_EQ(1, db.GetQueryCacheStatistics().hits);
+}
+
+TEST_F(SQLiteDatabaseTests, AutoOptimize_Changes_Plan_On_Grown_Table) {
+    // Arrange
+    SQLiteDatabase::OptimizeOptions options;
+    options.rowChangeThreshold = 1000;
+    db.EnableAutoOptimize(options);
+    (void)db.ExecuteStatement(
+        "CREATE TABLE events (kind INT, flag INT, user INT);"
+        "CREATE INDEX events_by_kind_flag ON events (kind, flag);"
+        "CREATE INDEX events_by_user ON events (user)"
+    );
+    const auto getPlan = [this]{
+        auto statement = db.BuildStatement(
+            "EXPLAIN QUERY PLAN SELECT * FROM events"
+            " WHERE kind = 1 AND flag = 0 AND user BETWEEN 5 AND 10"
+        ).statement;
+        std::string plan;
+        while (!statement->Step().done) {
+            plan += (std::string)statement->FetchColumn(3, Value::Type::Text);
+        }
+        return plan;
+    };
+    const std::string insertEvents = (
+        "WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM c WHERE x < ?)"
+        " INSERT INTO events SELECT x % 2, x % 3, x FROM c"
+    );
+    const auto insertSomeEvents = [this, &insertEvents](int count){
+        auto statement = db.BuildStatement(insertEvents).statement;
+        statement->BindParameter(0, count);
+        return statement->Step().error;
+    };
+    const auto emptyTablePlan = getPlan();
+
+    // Act
+    const auto firstInsertError = insertSomeEvents(500);
+    const auto slightlyGrownTablePlan = getPlan();
+    const auto dueBeforeGrowth = db.IsOptimizeDue();
+    const auto secondInsertError = insertSomeEvents(5000);
+    const auto dueAfterGrowth = db.IsOptimizeDue();
+    const auto runsBeforeOptimize = db.GetOptimizeStatistics().runs;
+    db.Optimize();
+    const auto grownTablePlan = getPlan();
+
+    // Assert
+    EXPECT_TRUE(firstInsertError.empty());
+    EXPECT_TRUE(secondInsertError.empty());
+    EXPECT_NE(std::string::npos, emptyTablePlan.find("events_by_kind_flag")) << emptyTablePlan;
+    EXPECT_NE(std::string::npos, slightlyGrownTablePlan.find("events_by_kind_flag")) << slightlyGrownTablePlan;
+    EXPECT_FALSE(dueBeforeGrowth);
+    EXPECT_TRUE(dueAfterGrowth);
+    EXPECT_EQ(0, runsBeforeOptimize);
+    EXPECT_NE(std::string::npos, grownTablePlan.find("events_by_user")) << grownTablePlan;
+    EXPECT_FALSE(db.IsOptimizeDue());
+    EXPECT_EQ(1, db.GetOptimizeStatistics().runs);
+}
+
+TEST_F(SQLiteDatabaseTests, AutoOptimize_Ignores_Rolled_Back_Changes_And_Keeps_Analysis_Limit) {
+    // Arrange
+    SQLiteDatabase::OptimizeOptions options;
+    options.rowChangeThreshold = 100;
+    options.analysisLimit = 50;
+    db.EnableAutoOptimize(options);
+    (void)db.ExecuteStatement(
+        "CREATE TABLE events (kind INT);"
+        "CREATE INDEX events_by_kind ON events (kind);"
+        "PRAGMA analysis_limit = 7"
+    );
+    const std::string insertEvents = (
+        "WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM c WHERE x < 200)"
+        " INSERT INTO events SELECT x % 2 FROM c"
+    );
+
+    // Act
+    (void)db.ExecuteStatement("BEGIN");
+    (void)db.ExecuteStatement(insertEvents);
+    (void)db.ExecuteStatement("ROLLBACK");
+    const auto dueAfterRollback = db.IsOptimizeDue();
+    (void)db.ExecuteStatement(insertEvents);
+    const auto dueAfterCommit = db.IsOptimizeDue();
+    db.Optimize();
+    auto statement = db.BuildStatement("PRAGMA analysis_limit").statement;
+    (void)statement->Step();
+    const auto analysisLimit = (int)statement->FetchColumn(0, Value::Type::Integer);
+
+    // Assert
+    EXPECT_FALSE(dueAfterRollback);
+    EXPECT_TRUE(dueAfterCommit);
+    EXPECT_FALSE(db.IsOptimizeDue());
+    EXPECT_EQ(7, analysisLimit);
+}
+
+TEST_F(SQLiteDatabaseTests, AutoOptimize_After_Install_Snapshot) {
+    // Arrange
+    (void)db.ExecuteStatement(
+        "CREATE TABLE events (kind INT, flag INT, user INT);"
+        "CREATE INDEX events_by_kind_flag ON events (kind, flag);"
+        "CREATE INDEX events_by_user ON events (user);"
+        "WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM c WHERE x < 5000)"
+        " INSERT INTO events SELECT x % 2, x % 3, x FROM c"
+    );
+    const auto snapshot = db.CreateSnapshot();
+    SQLiteDatabase::OptimizeOptions options;
+    options.rowChangeThreshold = 0;
+    db.EnableAutoOptimize(options);
+
+    // Act
+    const auto installError = db.InstallSnapshot(snapshot);
+    auto statement = db.BuildStatement(
+        "SELECT COUNT(*) FROM sqlite_stat1 WHERE tbl = 'events'"
+    ).statement;
+    ASSERT_FALSE(statement == nullptr);
+    (void)statement->Step();
+    const auto statisticsRows = (int)statement->FetchColumn(0, Value::Type::Integer);
+
+    // Assert
+    EXPECT_TRUE(installError.empty());
+    EXPECT_EQ(2, statisticsRows);
+    EXPECT_EQ(1, db.GetOptimizeStatistics().runs);
+}
+
+TEST_F(SQLiteDatabaseTests, Cancel_Between_Calls_Cancels_Next_Call_Only) {
+    // Arrange
+    auto statement = db.BuildStatement("SELECT entity FROM npcs ORDER BY entity").statement;
+    const auto firstStep = statement->Step();
+
+    // Act
+    db.Cancel();
+    const auto canceledStep = statement->Step();
+    const auto resumedStep = statement->Step();
+    const auto resumedEntity = (int)statement->FetchColumn(0, Value::Type::Integer);
+    const auto nextCallError = db.ExecuteStatement("INSERT INTO quests VALUES (3, 44, 0)");
+
+    // Assert
+    EXPECT_FALSE(firstStep.done);
+    EXPECT_TRUE(canceledStep.done);
+    EXPECT_EQ(SQLiteDatabase::CANCELED_ERROR, canceledStep.error);
+    EXPECT_FALSE(resumedStep.done);
+    EXPECT_TRUE(resumedStep.error.empty());
+    EXPECT_EQ(2, resumedEntity);
+    EXPECT_TRUE(nextCallError.empty());
+}
+
+TEST_F(SQLiteDatabaseTests, InstallSnapshot_Refused_While_ReadView_In_Use) {
+    // Arrange
+    const auto snapshot = db.CreateSnapshot();
+    const auto countNpcs = [this]{
+        auto statement = db.BuildStatement("SELECT COUNT(*) FROM npcs").statement;
+        (void)statement->Step();
+        return (int)statement->FetchColumn(0, Value::Type::Integer);
+    };
+    auto view = db.CreateReadView();
+    ASSERT_FALSE(view == nullptr);
+    auto viewStatement = view->BuildStatement("SELECT COUNT(*) FROM npcs").statement;
+    ASSERT_FALSE(viewStatement == nullptr);
+    view = nullptr;
+    (void)db.ExecuteStatement("INSERT INTO npcs VALUES (3, 'Carol', 'Cook', 1.5)");
+
+    // Act
+    const auto refusedError = db.InstallSnapshot(snapshot);
+    const auto countAfterRefusal = countNpcs();
+    viewStatement = nullptr;
+    const auto installError = db.InstallSnapshot(snapshot);
+    const auto countAfterInstall = countNpcs();
+    (void)db.InstallSnapshot(db.CreateSnapshot());
+    const auto countAfterReopen = countNpcs();
+
+    // Assert
+    EXPECT_FALSE(refusedError.empty());
+    EXPECT_EQ(3, countAfterRefusal);
+    EXPECT_TRUE(installError.empty());
+    EXPECT_EQ(2, countAfterInstall);
+    EXPECT_EQ(2, countAfterReopen);
+}
+
+TEST_F(SQLiteDatabaseTests, ReadView_Statements_Follow_Deadline_And_Cancel) {
+    // Arrange
+    const auto view = db.CreateReadView();
+    ASSERT_FALSE(view == nullptr);
+    const std::string runaway = (
+        "WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM c)"
+        " SELECT COUNT(*) FROM c"
+    );
+    auto deadlineStatement = view->BuildStatement(runaway).statement;
+    auto cancelStatement = view->BuildStatement(runaway).statement;
+    std::thread canceler(
+        [this]{
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            db.Cancel();
+        }
+    );
+
+    // Act
+    const auto canceledStep = cancelStatement->Step();
+    canceler.join();
+    db.SetDeadline(std::chrono::steady_clock::now() + std::chrono::milliseconds(50));
+    const auto deadlineStep = deadlineStatement->Step();
+    db.ClearDeadline();
+
+    // Assert
+    EXPECT_EQ(SQLiteDatabase::CANCELED_ERROR, canceledStep.error);
+    EXPECT_EQ(SQLiteDatabase::DEADLINE_EXCEEDED_ERROR, deadlineStep.error);
+}
+
+TEST_F(SQLiteDatabaseTests, Statements_Outlive_Database) {
+    // Arrange
+    auto otherDb = std::unique_ptr< SQLiteDatabase >(new SQLiteDatabase());
+    ASSERT_TRUE(otherDb->Open(defaultDbFilePath));
+    otherDb->EnableQueryCache(1024 * 1024);
+    otherDb->EnableAutoOptimize(SQLiteDatabase::OptimizeOptions());
+    ASSERT_TRUE(otherDb->StartCheckpointScheduler(SQLiteDatabase::CheckpointOptions()));
+    auto insertStatement = otherDb->BuildStatement("INSERT INTO quests VALUES (3, 44, 0)").statement;
+    auto beginStatement = otherDb->BuildStatement("BEGIN").statement;
+    auto uncommittedStatement = otherDb->BuildStatement("INSERT INTO quests VALUES (3, 45, 0)").statement;
+
+    // Act
+    otherDb = nullptr;
+    const auto insertStep = insertStatement->Step();
+    const auto beginStep = beginStatement->Step();
+    const auto uncommittedStep = uncommittedStatement->Step();
+    insertStatement = nullptr;
+    beginStatement = nullptr;
+    uncommittedStatement = nullptr;
+
+    // Assert
+    EXPECT_TRUE(insertStep.error.empty());
+    EXPECT_TRUE(beginStep.error.empty());
+    EXPECT_TRUE(uncommittedStep.error.empty());
+    auto statement = db.BuildStatement("SELECT quest FROM quests WHERE npc = 3").statement;
+    EXPECT_FALSE(statement->Step().done);
+    EXPECT_EQ(44, (int)statement->FetchColumn(0, Value::Type::Integer));
+    EXPECT_TRUE(statement->Step().done);
+}
+
+TEST_F(SQLiteDatabaseTests, Cancel_And_Deadline_Apply_To_Cached_Queries) {
+    // Arrange
+    db.EnableQueryCache(1024 * 1024);
+    auto statement = db.BuildStatement("SELECT entity FROM npcs ORDER BY entity").statement;
+    while (!statement->Step().done) {
+    }
+    statement->Reset();
+
+    // Act
+    db.Cancel();
+    const auto canceledStep = statement->Step();
+    const auto resumedStep = statement->Step();
+    const auto resumedEntity = (int)statement->FetchColumn(0, Value::Type::Integer);
+    db.SetDeadline(std::chrono::steady_clock::now() - std::chrono::milliseconds(1));
+    const auto expiredStep = statement->Step();
+    db.ClearDeadline();
+    const auto nextCallError = db.ExecuteStatement("INSERT INTO quests VALUES (3, 44, 0)");
+
+    // Assert
+    EXPECT_TRUE(canceledStep.done);
+    EXPECT_EQ(SQLiteDatabase::CANCELED_ERROR, canceledStep.error);
+    EXPECT_FALSE(resumedStep.done);
+    EXPECT_TRUE(resumedStep.error.empty());
+    EXPECT_EQ(1, resumedEntity);
+    EXPECT_TRUE(expiredStep.done);
+    EXPECT_EQ(SQLiteDatabase::DEADLINE_EXCEEDED_ERROR, expiredStep.error);
+    EXPECT_TRUE(nextCallError.empty());
+    EXPECT_EQ(1, db.GetQueryCacheStatistics().hits);
+}
@@ -0,0 +1,218 @@
+/**
+ * @file ShardedDatabaseTests.cpp
+ *
+ * This module contains the unit tests of the
+ * ShardedDatabase class.
+ */
+
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <math.h>
+#include <SQLiteAbstractions/ShardedDatabase.hpp>
+#include <string>
+#include <SystemAbstractions/File.hpp>
+#include <vector>
+
+using namespace DatabaseAbstractions;
+
+/**
+ * This is the test fixture for these tests, providing common
+ * setup and teardown for each test.
+ */
+struct ShardedDatabaseTests
+    : public ::testing::Test
+{
+    // Properties
+
+    ShardedDatabase db;
+    std::vector< std::string > shardFilePaths;
+
+    // Methods
+
+    void InsertNpcs() {
+        for (int entity = 1; entity <= 30; ++entity) {
+            ASSERT_TRUE(
+                db.ExecuteForKey(
+                    entity,
+                    "INSERT INTO npcs VALUES (?, ?)",
+                    {entity, "npc" + std::to_string(entity)}
+                ).empty()
+            );
+        }
+    }
+
+    // ::testing::Test
+
+    virtual void SetUp() override {
+        for (size_t i = 0; i < 3; ++i) {
+            shardFilePaths.push_back(
+                SystemAbstractions::File::GetExeParentDirectory()
+                + "/shard" + std::to_string(i) + ".db"
+            );
+            SystemAbstractions::File(shardFilePaths.back()).Destroy();
+        }
+        ASSERT_TRUE(db.Open(shardFilePaths));
+        ASSERT_TRUE(db.ExecuteOnAllShards("CREATE TABLE npcs (entity INT PRIMARY KEY, name TEXT)").empty());
+    }
+
+    virtual void TearDown() override {
+        db.Close();
+        for (const auto& shardFilePath: shardFilePaths) {
+            SystemAbstractions::File(shardFilePath).Destroy();
+        }
+    }
+};
+
+TEST_F(ShardedDatabaseTests, Keyed_Statements_Routed_To_One_Shard) {
+    // Arrange
+    InsertNpcs();
+
+    // Act
+    const auto shard = db.GetShardForKey(17);
+    const auto results = db.QueryForKey(
+        17,
+        "SELECT name FROM npcs WHERE entity = ?",
+        {Value::Type::Text},
+        {17}
+    );
+    std::vector< int > counts(db.GetShardCount());
+    db.RunOnAllShards(
+        [&counts](size_t shard, SQLiteDatabase& database){
+            auto statement = database.BuildStatement("SELECT COUNT(*) FROM npcs WHERE entity = 17").statement;
+            (void)statement->Step();
+            counts[shard] = (int)statement->FetchColumn(0, Value::Type::Integer);
+        }
+    );
+
+    // Assert
+    EXPECT_EQ(3, db.GetShardCount());
+    EXPECT_EQ(shard, db.GetShardForKey(17.0));
+    EXPECT_TRUE(results.error.empty());
+    ASSERT_EQ(1, results.rows.size());
+    EXPECT_EQ(Value("npc17"), results.rows[0][0]);
+    for (size_t i = 0; i < counts.size(); ++i) {
+        EXPECT_EQ((i == shard) ? 1 : 0, counts[i]) << i;
+    }
+}
+
+TEST_F(ShardedDatabaseTests, Query_All_Shards_Merges_Results) {
+    // Arrange
+    InsertNpcs();
+
+    // Act
+    const auto results = db.QueryAllShards(
+        "SELECT entity, name FROM npcs WHERE entity > ? ORDER BY entity",
+        {Value::Type::Integer, Value::Type::Text},
+        {20},
+        [](const ShardedDatabase::Row& lhs, const ShardedDatabase::Row& rhs){
+            return (int)lhs[0] < (int)rhs[0];
+        }
+    );
+    const auto badResults = db.QueryAllShards("SELECT foo FROM bar", {Value::Type::Integer});
+
+    // Assert
+    EXPECT_TRUE(results.error.empty());
+    std::vector< int > entities;
+    for (const auto& row: results.rows) {
+        entities.push_back((int)row[0]);
+    }
+    EXPECT_EQ(
+        std::vector< int >({21, 22, 23, 24, 25, 26, 27, 28, 29, 30}),
+        entities
+    );
+    EXPECT_FALSE(badResults.error.empty());
+}
+
+TEST_F(ShardedDatabaseTests, Snapshots_Per_Shard) {
+    // Arrange
+    InsertNpcs();
+    const auto snapshots = db.CreateSnapshots();
+    ASSERT_TRUE(db.ExecuteOnAllShards("DELETE FROM npcs").empty());
+
+    // Act
+    const auto error = db.InstallSnapshots(snapshots);
+    const auto results = db.QueryAllShards(
+        "SELECT COUNT(*) FROM npcs",
+        {Value::Type::Integer}
+    );
+
+    // Assert
+    EXPECT_EQ(3, snapshots.size());
+    EXPECT_TRUE(error.empty());
+    ASSERT_EQ(3, results.rows.size());
+    int total = 0;
+    for (const auto& row: results.rows) {
+        EXPECT_GT((int)row[0], 0);
+        total += (int)row[0];
+    }
+    EXPECT_EQ(30, total);
+    EXPECT_FALSE(db.InstallSnapshots({snapshots[0]}).empty());
+}
+
+TEST_F(ShardedDatabaseTests, Real_Keys_Outside_Integer_Range) {
+    // Arrange
+    const double nan = NAN;
+    const double huge = 1e300;
+
+    // Act
+    const auto nanShard = db.GetShardForKey(nan);
+    const auto hugeShard = db.GetShardForKey(huge);
+    const auto negativeHugeShard = db.GetShardForKey(-huge);
+    const auto limitShard = db.GetShardForKey(9223372036854775808.0);
+
+    // Assert
+    EXPECT_EQ(db.GetShardForKey(nullptr), nanShard);
+    EXPECT_EQ(hugeShard, db.GetShardForKey(huge));
+    EXPECT_LT(hugeShard, db.GetShardCount());
+    EXPECT_LT(negativeHugeShard, db.GetShardCount());
+    EXPECT_LT(limitShard, db.GetShardCount());
+    EXPECT_EQ(db.GetShardForKey(2), db.GetShardForKey(2.0));
+    EXPECT_EQ(
+        db.GetShardForKey((intmax_t)INTMAX_MIN),
+        db.GetShardForKey((double)INTMAX_MIN)
+    );
+}
+
+TEST_F(ShardedDatabaseTests, Run_On_Shard_Out_Of_Range) {
+    // Arrange
+    bool ran = false;
+
+    // Act
+    const auto result = db.RunOnShard(
+        db.GetShardCount(),
+        [&ran](SQLiteDatabase&){ ran = true; }
+    );
+
+    // Assert
+    EXPECT_FALSE(result);
+    EXPECT_FALSE(ran);
+    EXPECT_TRUE(db.RunOnShard(0, [&ran](SQLiteDatabase&){ ran = true; }));
+    EXPECT_TRUE(ran);
+}
+
+TEST_F(ShardedDatabaseTests, Execute_On_All_Shards_Partial_Failure) {
+    // Arrange
+    (void)db.RunOnShard(
+        1,
+        [](SQLiteDatabase& database){
+            (void)database.ExecuteStatement("CREATE TABLE extra (a INT)");
+        }
+    );
+
+    // Act
+    const auto error = db.ExecuteOnAllShards("CREATE TABLE extra (a INT)");
+    std::vector< std::string > tableErrors(db.GetShardCount());
+    db.RunOnAllShards(
+        [&tableErrors](size_t shard, SQLiteDatabase& database){
+            tableErrors[shard] = database.ExecuteStatement("SELECT a FROM extra");
+        }
+    );
+
+    // Assert
+    EXPECT_EQ(0, error.find("shard 1: "));
+    EXPECT_EQ(std::string::npos, error.find("shard 0"));
+    EXPECT_EQ(std::string::npos, error.find("shard 2"));
+    for (size_t i = 0; i < tableErrors.size(); ++i) {
+        EXPECT_TRUE(tableErrors[i].empty()) << i;
+    }
+}